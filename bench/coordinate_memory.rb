@@ -0,0 +1,38 @@
+# frozen_string_literal: true
+
+# -----------------------------------------------------------------------------
+#
+# Resident memory of line strings built by a CAPI factory, for a given
+# number of vertices in lines of 1000 vertices. GEOS stores at least three
+# ordinates per coordinate, so 2D and 3D lines are expected to use the
+# same memory.
+#
+#   ruby -Ilib bench/coordinate_memory.rb [vertices] [2d|3d]
+#
+# -----------------------------------------------------------------------------
+
+require "rgeo"
+
+abort "GEOS CAPI support not available." unless RGeo::Geos.capi_supported?
+
+def rss_kb
+  Integer(`ps -o rss= -p #{Process.pid}`)
+end
+
+vertices = Integer(ARGV.fetch(0, 10_000_000))
+has_z = ARGV.fetch(1, "2d") == "3d"
+dims = has_z ? 3 : 2
+
+factory = RGeo::Geos.factory(has_z_coordinate: has_z)
+coords = Array.new(1000 * dims) { |i| i.to_f }.pack("d*")
+
+GC.start
+before = rss_kb
+lines = Array.new(vertices / 1000) do
+  factory.line_string_from_coords(coords, dims: dims)
+end
+GC.start
+after = rss_kb
+
+puts format("%d lines, %d vertices, %d dimensions", lines.size, lines.size * 1000, dims)
+puts format("rss: %.1f MiB, %.1f bytes per vertex", (after - before) / 1024.0, (after - before) * 1024.0 / (lines.size * 1000))
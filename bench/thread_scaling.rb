@@ -0,0 +1,52 @@
+# frozen_string_literal: true
+
+# -----------------------------------------------------------------------------
+#
+# Throughput of GEOS operations depending on the number of threads.
+#
+# Expensive GEOS operations are run without the GVL, each native thread
+# using its own GEOS context, so throughput should grow with the number of
+# threads up to the number of cores.
+#
+#   ruby -Ilib bench/thread_scaling.rb [operations] [max_threads]
+#
+# -----------------------------------------------------------------------------
+
+require "benchmark"
+require "etc"
+require "rgeo"
+
+abort "GEOS CAPI support not available." unless RGeo::Geos.capi_supported?
+
+operations = Integer(ARGV.fetch(0, 2_000))
+max_threads = Integer(ARGV.fetch(1, Etc.nprocessors))
+
+factory = RGeo::Geos.factory
+geometries = Array.new(64) do |i|
+  factory.point(i % 8, i / 8).buffer(0.75)
+end
+
+work = lambda do |count|
+  count.times do |i|
+    a = geometries[i % geometries.size]
+    b = geometries[(i * 7 + 3) % geometries.size]
+    a.union(b).buffer(0.1).simplify(0.01)
+  end
+end
+
+thread_counts = [1]
+thread_counts << (thread_counts.last * 2) while thread_counts.last * 2 <= max_threads
+thread_counts << max_threads unless thread_counts.include?(max_threads)
+
+work.call(operations / 10) # warm up
+
+baseline = nil
+puts format("%-8s %12s %14s %8s", "threads", "seconds", "operations/s", "speedup")
+thread_counts.each do |thread_count|
+  time = Benchmark.realtime do
+    Array.new(thread_count) { Thread.new { work.call(operations / thread_count) } }.each(&:join)
+  end
+  throughput = (operations / thread_count * thread_count) / time
+  baseline ||= throughput
+  puts format("%-8d %12.3f %14.1f %7.2fx", thread_count, time, throughput, throughput / baseline)
+end
@@ -0,0 +1,41 @@
+# frozen_string_literal: true
+
+# -----------------------------------------------------------------------------
+#
+# Size and speed of TWKB compared to WKB, for geometries marshaled by
+# CAPI factories.
+#
+#   ruby -Ilib bench/twkb.rb [iterations] [precision]
+#
+# -----------------------------------------------------------------------------
+
+require "benchmark"
+require "rgeo"
+
+abort "GEOS CAPI support not available." unless RGeo::Geos.capi_supported?
+
+iterations = Integer(ARGV.fetch(0, 200))
+precision = Integer(ARGV.fetch(1, 6))
+
+factory = RGeo::Geos.factory(srid: 4326, twkb_precision: precision)
+geometries = Array.new(100) do |i|
+  factory.point(-71 + i * 0.001, 42 + i * 0.001).buffer(0.01)
+end
+
+formats = {
+  "wkb" => [->(geom) { geom.as_binary }, ->(data) { factory.parse_wkb(data) }],
+  "twkb" => [->(geom) { geom.as_twkb }, ->(data) { factory.parse_twkb(data) }]
+}
+
+puts format("%-6s %10s %12s %12s", "format", "bytes", "encode/s", "decode/s")
+formats.each do |name, (encode, decode)|
+  encoded = geometries.map(&encode)
+  encode_time = Benchmark.realtime do
+    iterations.times { geometries.each(&encode) }
+  end
+  decode_time = Benchmark.realtime do
+    iterations.times { encoded.each(&decode) }
+  end
+  count = iterations * geometries.size
+  puts format("%-6s %10d %12.1f %12.1f", name, encoded.sum(&:bytesize), count / encode_time, count / decode_time)
+end
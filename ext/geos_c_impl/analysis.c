@@ -27,6 +27,7 @@ RGEO_BEGIN_C
 VALUE
 rgeo_geos_analysis_ccw_p(VALUE self, VALUE ring)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   const RGeo_GeometryData* ring_data;
   const GEOSCoordSequence* coord_seq;
   char is_ccw;
@@ -35,11 +36,11 @@ rgeo_geos_analysis_ccw_p(VALUE self, VALUE ring)
 
   ring_data = RGEO_GEOMETRY_DATA_PTR(ring);
 
-  coord_seq = GEOSGeom_getCoordSeq(ring_data->geom);
+  coord_seq = GEOSGeom_getCoordSeq_r(context, ring_data->geom);
   if (!coord_seq) {
     rb_raise(rb_eGeosError, "Could not retrieve CoordSeq from given ring.");
   }
-  if (!GEOSCoordSeq_isCCW(coord_seq, &is_ccw)) {
+  if (!GEOSCoordSeq_isCCW_r(context, coord_seq, &is_ccw)) {
     rb_raise(rb_eGeosError, "Could not determine if the CoordSeq is CCW.");
   }
 
@@ -1,30 +1,41 @@
+#include "preface.h"
+
 #include <geos_c.h>
 #include <ruby.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "errors.h"
+#include "factory.h"
+#include "globals.h"
 
 VALUE
 extract_points_from_coordinate_sequence(const GEOSCoordSequence* coord_sequence,
                                         int zCoordinate)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
   VALUE point;
   unsigned int count;
   unsigned int i;
+  unsigned int dims;
   double val;
 
-  if (GEOSCoordSeq_getSize(coord_sequence, &count)) {
+  dims = RGEO_FACTORY_DIMS(zCoordinate);
+  if (GEOSCoordSeq_getSize_r(context, coord_sequence, &count)) {
     result = rb_ary_new2(count);
     for (i = 0; i < count; ++i) {
-      if (zCoordinate) {
-        point = rb_ary_new2(3);
-      } else {
-        point = rb_ary_new2(2);
-      }
-      GEOSCoordSeq_getX(coord_sequence, i, &val);
+      point = rb_ary_new2(dims);
+      GEOSCoordSeq_getX_r(context, coord_sequence, i, &val);
       rb_ary_push(point, rb_float_new(val));
-      GEOSCoordSeq_getY(coord_sequence, i, &val);
+      GEOSCoordSeq_getY_r(context, coord_sequence, i, &val);
       rb_ary_push(point, rb_float_new(val));
-      if (zCoordinate) {
-        GEOSCoordSeq_getZ(coord_sequence, i, &val);
+      if (dims > 2) {
+        GEOSCoordSeq_getZ_r(context, coord_sequence, i, &val);
+        rb_ary_push(point, rb_float_new(val));
+      }
+      if (dims > 3) {
+        GEOSCoordSeq_getOrdinate_r(context, coord_sequence, i, 3, &val);
         rb_ary_push(point, rb_float_new(val));
       }
       rb_ary_push(result, point);
@@ -37,6 +48,7 @@ extract_points_from_coordinate_sequence(const GEOSCoordSequence* coord_sequence,
 VALUE
 extract_points_from_polygon(const GEOSGeometry* polygon, int zCoordinate)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
 
   const GEOSGeometry* ring;
@@ -45,11 +57,11 @@ extract_points_from_polygon(const GEOSGeometry* polygon, int zCoordinate)
   unsigned int i;
 
   if (polygon) {
-    ring = GEOSGetExteriorRing(polygon);
-    coord_sequence = GEOSGeom_getCoordSeq(ring);
+    ring = GEOSGetExteriorRing_r(context, polygon);
+    coord_sequence = GEOSGeom_getCoordSeq_r(context, ring);
 
     if (coord_sequence) {
-      interior_ring_count = GEOSGetNumInteriorRings(polygon);
+      interior_ring_count = GEOSGetNumInteriorRings_r(context, polygon);
       result = rb_ary_new2(interior_ring_count + 1); // exterior + inner rings
 
       rb_ary_push(
@@ -57,8 +69,8 @@ extract_points_from_polygon(const GEOSGeometry* polygon, int zCoordinate)
         extract_points_from_coordinate_sequence(coord_sequence, zCoordinate));
 
       for (i = 0; i < interior_ring_count; ++i) {
-        ring = GEOSGetInteriorRingN(polygon, i);
-        coord_sequence = GEOSGeom_getCoordSeq(ring);
+        ring = GEOSGetInteriorRingN_r(context, polygon, i);
+        coord_sequence = GEOSGeom_getCoordSeq_r(context, ring);
         if (coord_sequence) {
           rb_ary_push(result,
                       extract_points_from_coordinate_sequence(coord_sequence,
@@ -69,3 +81,127 @@ extract_points_from_polygon(const GEOSGeometry* polygon, int zCoordinate)
   }
   return result;
 }
+
+typedef struct
+{
+  VALUE data;
+  VALUE sequence_offsets;
+  VALUE part_offsets;
+  size_t dims;
+  size_t size;
+  size_t capacity;
+} RGeo_PackedCoordinates;
+
+static void
+pack_coordinate_sequence(RGeo_PackedCoordinates* packed,
+                         const GEOSCoordSequence* coord_sequence)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  unsigned int count;
+  unsigned int i;
+  double xyzm[4];
+  char* out;
+
+  rb_ary_push(packed->sequence_offsets, SIZET2NUM(packed->size));
+  if (!coord_sequence ||
+      !GEOSCoordSeq_getSize_r(context, coord_sequence, &count)) {
+    return;
+  }
+  if (packed->size + count > packed->capacity) {
+    rb_raise(rb_eGeosError, "Unexpected number of coordinates");
+  }
+  out =
+    RSTRING_PTR(packed->data) + packed->size * packed->dims * sizeof(double);
+#ifdef RGEO_GEOS_SUPPORTS_COORDSEQ_BUFFER
+  if ((uintptr_t)out % sizeof(double) == 0) {
+    GEOSCoordSeq_copyToBuffer_r(context,
+                                coord_sequence,
+                                (double*)out,
+                                packed->dims >= 3,
+                                packed->dims == 4);
+    packed->size += count;
+    return;
+  }
+#endif
+  for (i = 0; i < count; ++i) {
+    GEOSCoordSeq_getX_r(context, coord_sequence, i, &xyzm[0]);
+    GEOSCoordSeq_getY_r(context, coord_sequence, i, &xyzm[1]);
+    if (packed->dims >= 3) {
+      GEOSCoordSeq_getZ_r(context, coord_sequence, i, &xyzm[2]);
+    }
+    if (packed->dims == 4) {
+      GEOSCoordSeq_getOrdinate_r(context, coord_sequence, i, 3, &xyzm[3]);
+    }
+    memcpy(out + i * packed->dims * sizeof(double),
+           xyzm,
+           packed->dims * sizeof(double));
+  }
+  packed->size += count;
+}
+
+static void
+pack_geometry(RGeo_PackedCoordinates* packed, const GEOSGeometry* geom)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  int count;
+  int i;
+
+  switch (GEOSGeomTypeId_r(context, geom)) {
+    case GEOS_POINT:
+    case GEOS_LINESTRING:
+    case GEOS_LINEARRING:
+      rb_ary_push(packed->part_offsets,
+                  LONG2NUM(RARRAY_LEN(packed->sequence_offsets)));
+      pack_coordinate_sequence(packed, GEOSGeom_getCoordSeq_r(context, geom));
+      break;
+    case GEOS_POLYGON:
+      rb_ary_push(packed->part_offsets,
+                  LONG2NUM(RARRAY_LEN(packed->sequence_offsets)));
+      if (GEOSisEmpty_r(context, geom)) {
+        break;
+      }
+      pack_coordinate_sequence(
+        packed,
+        GEOSGeom_getCoordSeq_r(context, GEOSGetExteriorRing_r(context, geom)));
+      count = GEOSGetNumInteriorRings_r(context, geom);
+      for (i = 0; i < count; ++i) {
+        pack_coordinate_sequence(
+          packed,
+          GEOSGeom_getCoordSeq_r(context,
+                                 GEOSGetInteriorRingN_r(context, geom, i)));
+      }
+      break;
+    default:
+      count = GEOSGetNumGeometries_r(context, geom);
+      for (i = 0; i < count; ++i) {
+        pack_geometry(packed, GEOSGetGeometryN_r(context, geom, i));
+      }
+      break;
+  }
+}
+
+VALUE
+extract_packed_coordinates(const GEOSGeometry* geom, int zCoordinate)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_PackedCoordinates packed;
+  int count;
+
+  count = GEOSGetNumCoordinates_r(context, geom);
+  if (count < 0) {
+    return Qnil;
+  }
+  packed.dims = RGEO_FACTORY_DIMS(zCoordinate);
+  packed.size = 0;
+  packed.capacity = (size_t)count;
+  packed.data = rb_str_new(NULL, count * packed.dims * sizeof(double));
+  packed.sequence_offsets = rb_ary_new();
+  packed.part_offsets = rb_ary_new();
+  pack_geometry(&packed, geom);
+  rb_ary_push(packed.sequence_offsets, SIZET2NUM(packed.size));
+  rb_ary_push(packed.part_offsets,
+              LONG2NUM(RARRAY_LEN(packed.sequence_offsets) - 1));
+  rb_str_set_len(packed.data, packed.size * packed.dims * sizeof(double));
+  return rb_ary_new_from_args(
+    3, packed.data, packed.sequence_offsets, packed.part_offsets);
+}
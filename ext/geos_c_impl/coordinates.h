@@ -1,5 +1,22 @@
+/*
+  zCoordinate holds the Z and M flags of the factory, see
+  RGEO_FACTORY_DIMS: points get a third number, and a fourth one for M
+  on factories with both.
+*/
 VALUE
 extract_points_from_coordinate_sequence(const GEOSCoordSequence* coord_sequence,
                                         int zCoordinate);
 VALUE
 extract_points_from_polygon(const GEOSGeometry* polygon, int zCoordinate);
+
+/*
+  Returns [coordinates, sequence_offsets, part_offsets] for the given
+  geometry. coordinates is a binary string of native doubles, with x, y
+  and, if zCoordinate is set, z (and m with both Z and M) for each point.
+  sequence_offsets holds the index of the first point of each coordinate
+  sequence (point, line string or ring) and part_offsets the index of the
+  first sequence of each part (point, line string or polygon), both
+  followed by the total count.
+*/
+VALUE
+extract_packed_coordinates(const GEOSGeometry* geom, int zCoordinate);
@@ -2,7 +2,9 @@
 #ifndef RGEO_GEOS_ERROS_INCLUDED
 #define RGEO_GEOS_ERROS_INCLUDED
 
+#include <ctype.h>
 #include <ruby.h>
+#include <string.h>
 
 #include "preface.h"
 
@@ -18,6 +20,7 @@ VALUE rb_eRGeoInvalidGeometry;
 VALUE rb_eRGeoParseError;
 VALUE rb_eRGeoUnsupportedOperation;
 VALUE rb_eGeosError;
+VALUE rb_eGeosDeadlineExceeded;
 
 void
 rgeo_init_geos_errors()
@@ -35,6 +38,30 @@ rgeo_init_geos_errors()
     rb_define_class_under(error_module, "ParseError", rb_eRGeoError);
   rb_eGeosError =
     rb_define_class_under(error_module, "GeosError", rb_eRGeoError);
+  rb_eGeosDeadlineExceeded =
+    rb_define_class_under(error_module, "DeadlineExceeded", rb_eGeosError);
+}
+
+void
+rgeo_raise_geos_error(char* geos_full_error)
+{
+  // NOTE: strtok is destructive, geos_full_error is not to be used afterwards.
+  char* geos_error = strtok(geos_full_error, ":");
+  char* geos_message = strtok(NULL, ":");
+  while (geos_message && isspace(*geos_message))
+    geos_message++;
+
+  if (streq(geos_error, "UnsupportedOperationException")) {
+    rb_raise(rb_eRGeoUnsupportedOperation, "%s", geos_message);
+  } else if (streq(geos_error, "IllegalArgumentException")) {
+    rb_raise(rb_eRGeoInvalidGeometry, "%s", geos_message);
+  } else if (streq(geos_error, "ParseException")) {
+    rb_raise(rb_eRGeoParseError, "%s", geos_message);
+  } else if (geos_message) {
+    rb_raise(rb_eGeosError, "%s: %s", geos_error, geos_message);
+  } else {
+    rb_raise(rb_eGeosError, "%s", geos_error);
+  }
 }
 
 RGEO_END_C
@@ -18,10 +18,18 @@ extern VALUE rb_eRGeoParseError;
 extern VALUE rb_eRGeoUnsupportedOperation;
 // RGeo error specific to the GEOS implementation.
 extern VALUE rb_eGeosError;
+// RGeo::Error::DeadlineExceeded
+extern VALUE rb_eGeosDeadlineExceeded;
 
 void
 rgeo_init_geos_errors();
 
+/*
+  Raises the ruby error matching a GEOS error message, which is formatted
+  as "ExceptionName: message". The message buffer is modified.
+*/
+NORETURN(void rgeo_raise_geos_error(char* geos_full_error));
+
 RGEO_END_C
 
 #endif // RGEO_GEOS_SUPPORTED
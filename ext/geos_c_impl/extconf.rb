@@ -43,12 +43,21 @@ if have_header("geos_c.h")
   found_geos = true if have_func("GEOSSetSRID_r", "geos_c.h")
   have_func("GEOSPreparedContains_r", "geos_c.h")
   have_func("GEOSPreparedDisjoint_r", "geos_c.h")
+  have_func("GEOSPreparedContainsXY_r", "geos_c.h")
   have_func("GEOSUnaryUnion_r", "geos_c.h")
   have_func("GEOSCoordSeq_isCCW_r", "geos_c.h")
   have_func("GEOSDensify", "geos_c.h")
   have_func("GEOSPolygonHullSimplify", "geos_c.h")
+  have_func("GEOSSTRtree_build_r", "geos_c.h")
+  have_func("GEOSCoordSeq_copyFromBuffer_r", "geos_c.h")
+  have_func("GEOSWKBWriter_setFlavor_r", "geos_c.h")
+  have_func("GEOSGeoJSONReader_readGeometry_r", "geos_c.h")
+  have_func("GEOSHasM_r", "geos_c.h")
+  have_func("GEOSContext_setInterruptCallback_r", "geos_c.h")
   have_func("rb_memhash", "ruby.h")
   have_func("rb_gc_mark_movable", "ruby.h")
+  have_func("rb_nogvl", "ruby/thread.h")
+  have_header("pthread.h")
 end
 
 if found_geos
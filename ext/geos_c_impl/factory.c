@@ -7,7 +7,11 @@
 #ifdef RGEO_GEOS_SUPPORTED
 
 #include <geos_c.h>
+#include <limits.h>
+#include <math.h>
 #include <ruby.h>
+#include <ruby/encoding.h>
+#include <string.h>
 
 #include "errors.h"
 #include "factory.h"
@@ -15,12 +19,137 @@
 #include "geometry_collection.h"
 #include "globals.h"
 #include "line_string.h"
+#include "nogvl.h"
 #include "point.h"
 #include "polygon.h"
 #include "ruby_more.h"
+#include "twkb.h"
 
 RGEO_BEGIN_C
 
+/**** PREPARED GEOMETRIES ****/
+
+// Rough size of a prepared geometry, which GEOS does not report: mostly
+// the segment and point-in-area indexes built over its coordinates.
+#define RGEO_PREPARED_BASE_SIZE 256
+#define RGEO_PREPARED_COORDINATE_SIZE 96
+
+// Rough size of a GEOS geometry: an object per geometry and part, and
+// a double per ordinate of each coordinate. GEOS stores at least three
+// ordinates per coordinate, and four for XYZM factories.
+#define RGEO_GEOMETRY_BASE_SIZE 96
+#define RGEO_GEOMETRY_COORDINATE_SIZE(dims)                                    \
+  (((dims) > 3 ? (size_t)(dims) : 3) * sizeof(double))
+
+static size_t
+estimate_geometry_size(const RGeo_GeometryData* object_data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  int coordinates;
+  int parts;
+  int dims;
+
+  dims = NIL_P(object_data->factory)
+           ? 2
+           : RGEO_FACTORY_DIMS(
+               RGEO_FACTORY_DATA_PTR(object_data->factory)->flags);
+  coordinates = GEOSGetNumCoordinates_r(context, object_data->geom);
+  parts = GEOSGetNumGeometries_r(context, object_data->geom);
+  return (size_t)(parts < 0 ? 1 : parts + 1) * RGEO_GEOMETRY_BASE_SIZE +
+         (size_t)(coordinates < 0 ? 0 : coordinates) *
+           RGEO_GEOMETRY_COORDINATE_SIZE(dims);
+}
+
+static void
+link_prepared_geometry(RGeo_PreparePolicy* policy,
+                       RGeo_GeometryData* object_data)
+{
+  object_data->prep_policy = policy;
+  object_data->prep_prev = NULL;
+  object_data->prep_next = policy->head;
+  if (policy->head) {
+    policy->head->prep_prev = object_data;
+  } else {
+    policy->tail = object_data;
+  }
+  policy->head = object_data;
+  policy->bytes += object_data->prep_size;
+  ++policy->count;
+}
+
+static void
+unlink_prepared_geometry(RGeo_GeometryData* object_data)
+{
+  RGeo_PreparePolicy* policy;
+
+  policy = object_data->prep_policy;
+  if (!policy) {
+    return;
+  }
+  if (object_data->prep_prev) {
+    object_data->prep_prev->prep_next = object_data->prep_next;
+  } else {
+    policy->head = object_data->prep_next;
+  }
+  if (object_data->prep_next) {
+    object_data->prep_next->prep_prev = object_data->prep_prev;
+  } else {
+    policy->tail = object_data->prep_prev;
+  }
+  policy->bytes -= object_data->prep_size;
+  --policy->count;
+  object_data->prep_policy = NULL;
+  object_data->prep_prev = NULL;
+  object_data->prep_next = NULL;
+}
+
+// Called when a factory is freed. Its prepared geometries may be freed
+// later in the same GC run, so they must not reach the policy anymore.
+
+static void
+detach_prepared_geometries(RGeo_PreparePolicy* policy)
+{
+  RGeo_GeometryData* object_data;
+  RGeo_GeometryData* next;
+
+  for (object_data = policy->head; object_data; object_data = next) {
+    next = object_data->prep_next;
+    object_data->prep_policy = NULL;
+    object_data->prep_prev = NULL;
+    object_data->prep_next = NULL;
+  }
+  policy->head = NULL;
+  policy->tail = NULL;
+  policy->bytes = 0;
+  policy->count = 0;
+}
+
+// Drops a reference to the given output cache, freeing it with the last
+// one.
+
+static void
+release_output_cache(RGeo_OutputCache* cache)
+{
+  if (cache && --cache->refs == 0) {
+    FREE(cache);
+  }
+}
+
+static RGeo_OutputCache*
+create_output_cache(int flags)
+{
+  RGeo_OutputCache* cache;
+
+  if (!(flags & RGEO_FACTORYFLAGS_CACHE_OUTPUT)) {
+    return NULL;
+  }
+  cache = ALLOC(RGeo_OutputCache);
+  cache->strings = 0;
+  cache->bytes = 0;
+  cache->refs = 1;
+  return cache;
+}
+
 /**** RUBY AND GEOS CALLBACKS ****/
 
 // Destroy function for factory data. We destroy any serialization
@@ -30,54 +159,54 @@ RGEO_BEGIN_C
 static void
 destroy_factory_func(void* data)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   RGeo_FactoryData* factory_data;
 
   factory_data = (RGeo_FactoryData*)data;
   if (factory_data->wkt_reader) {
-    GEOSWKTReader_destroy(factory_data->wkt_reader);
+    GEOSWKTReader_destroy_r(context, factory_data->wkt_reader);
   }
   if (factory_data->wkb_reader) {
-    GEOSWKBReader_destroy(factory_data->wkb_reader);
+    GEOSWKBReader_destroy_r(context, factory_data->wkb_reader);
   }
   if (factory_data->wkt_writer) {
-    GEOSWKTWriter_destroy(factory_data->wkt_writer);
+    GEOSWKTWriter_destroy_r(context, factory_data->wkt_writer);
   }
   if (factory_data->wkb_writer) {
-    GEOSWKBWriter_destroy(factory_data->wkb_writer);
+    GEOSWKBWriter_destroy_r(context, factory_data->wkb_writer);
   }
   if (factory_data->psych_wkt_reader) {
-    GEOSWKTReader_destroy(factory_data->psych_wkt_reader);
+    GEOSWKTReader_destroy_r(context, factory_data->psych_wkt_reader);
   }
   if (factory_data->marshal_wkb_reader) {
-    GEOSWKBReader_destroy(factory_data->marshal_wkb_reader);
+    GEOSWKBReader_destroy_r(context, factory_data->marshal_wkb_reader);
   }
   if (factory_data->psych_wkt_writer) {
-    GEOSWKTWriter_destroy(factory_data->psych_wkt_writer);
+    GEOSWKTWriter_destroy_r(context, factory_data->psych_wkt_writer);
   }
   if (factory_data->marshal_wkb_writer) {
-    GEOSWKBWriter_destroy(factory_data->marshal_wkb_writer);
+    GEOSWKBWriter_destroy_r(context, factory_data->marshal_wkb_writer);
   }
+  detach_prepared_geometries(&factory_data->prepare);
+  release_output_cache(factory_data->output_cache);
   FREE(factory_data);
 }
 
-// Destroy function for geometry data. We destroy the internal
-// GEOS geometry (if present) before freeing the data itself.
+// Destroy function for geometry data. We destroy the prepared and the
+// internal GEOS geometries (if present) before freeing the data itself.
 
 static void
 destroy_geometry_func(void* data)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   RGeo_GeometryData* geometry_data;
-  const GEOSPreparedGeometry* prep;
 
   geometry_data = (RGeo_GeometryData*)data;
-  if (geometry_data->geom) {
-    GEOSGeom_destroy(geometry_data->geom);
-  }
-  prep = geometry_data->prep;
-  if (prep && prep != (const GEOSPreparedGeometry*)1 &&
-      prep != (const GEOSPreparedGeometry*)2 &&
-      prep != (const GEOSPreparedGeometry*)3) {
-    GEOSPreparedGeom_destroy(prep);
+  rgeo_release_prepared_geometry(geometry_data);
+  rgeo_untrack_geometry_memory(geometry_data);
+  rgeo_release_geometry_output(geometry_data);
+  if (geometry_data->geom && NIL_P(geometry_data->parent)) {
+    GEOSGeom_destroy_r(context, geometry_data->geom);
   }
   FREE(geometry_data);
 }
@@ -108,8 +237,9 @@ mark_factory_func(void* data)
   }
 }
 
-// Mark function for geometry data. This marks the factory and klasses
-// held by the geometry so those don't get collected.
+// Mark function for geometry data. This marks the factory, klasses,
+// parent, retired geometries, WKB and output strings held by the
+// geometry so those don't get collected.
 
 static void
 mark_geometry_func(void* data)
@@ -123,6 +253,21 @@ mark_geometry_func(void* data)
   if (!NIL_P(geometry_data->klasses)) {
     mark(geometry_data->klasses);
   }
+  if (!NIL_P(geometry_data->parent)) {
+    mark(geometry_data->parent);
+  }
+  if (!NIL_P(geometry_data->retired)) {
+    mark(geometry_data->retired);
+  }
+  if (!NIL_P(geometry_data->wkb)) {
+    mark(geometry_data->wkb);
+  }
+  if (!NIL_P(geometry_data->text)) {
+    mark(geometry_data->text);
+  }
+  if (!NIL_P(geometry_data->binary)) {
+    mark(geometry_data->binary);
+  }
 }
 
 #ifdef HAVE_RB_GC_MARK_MOVABLE
@@ -165,13 +310,48 @@ compact_geometry_func(void* data)
   if (!NIL_P(geometry_data->klasses)) {
     geometry_data->klasses = rb_gc_location(geometry_data->klasses);
   }
+  if (!NIL_P(geometry_data->parent)) {
+    geometry_data->parent = rb_gc_location(geometry_data->parent);
+  }
+  if (!NIL_P(geometry_data->retired)) {
+    geometry_data->retired = rb_gc_location(geometry_data->retired);
+  }
+  if (!NIL_P(geometry_data->wkb)) {
+    geometry_data->wkb = rb_gc_location(geometry_data->wkb);
+  }
+  if (!NIL_P(geometry_data->text)) {
+    geometry_data->text = rb_gc_location(geometry_data->text);
+  }
+  if (!NIL_P(geometry_data->binary)) {
+    geometry_data->binary = rb_gc_location(geometry_data->binary);
+  }
 }
 #endif
 
+static size_t
+factory_memsize(const void* data)
+{
+  return sizeof(RGeo_FactoryData);
+}
+
+// Views report only their own data, since the parent owns the GEOS
+// geometry.
+
+static size_t
+geometry_memsize(const void* data)
+{
+  const RGeo_GeometryData* geometry_data;
+
+  geometry_data = (const RGeo_GeometryData*)data;
+  return sizeof(RGeo_GeometryData) + geometry_data->geom_size +
+         geometry_data->prep_size;
+}
+
 const rb_data_type_t rgeo_factory_type = { .wrap_struct_name = "RGeo/Factory",
                                            .function = {
                                              .dmark = mark_factory_func,
                                              .dfree = destroy_factory_func,
+                                             .dsize = factory_memsize,
 #ifdef HAVE_RB_GC_MARK_MOVABLE
                                              .dcompact = compact_factory_func,
 #endif
@@ -181,6 +361,7 @@ const rb_data_type_t rgeo_geometry_type = { .wrap_struct_name = "RGeo/Geometry",
                                             .function = {
                                               .dmark = mark_geometry_func,
                                               .dfree = destroy_geometry_func,
+                                              .dsize = geometry_memsize,
 #ifdef HAVE_RB_GC_MARK_MOVABLE
                                               .dcompact = compact_geometry_func,
 #endif
@@ -239,114 +420,1418 @@ method_factory_prepare_heuristic_p(VALUE self)
            : Qfalse;
 }
 
+/**** SERIALIZATION WITHOUT THE GVL ****/
+
+// Readers and writers cached in the factory are checked out while in use:
+// the slot is left empty so that another thread, which can run while the
+// GVL is released, never uses the same object concurrently. It creates its
+// own instead, and the extra object is destroyed when checked in.
+
+typedef struct
+{
+  void* serializer;
+  const GEOSGeometry* geom;
+  const char* str;
+  size_t size;
+  char hex;
+} RGeo_SerializationArgs;
+
+static void*
+wkt_read_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs* args;
+
+  args = (RGeo_SerializationArgs*)data;
+  return GEOSWKTReader_read_r(
+    context, (GEOSWKTReader*)args->serializer, args->str);
+}
+
+static void*
+wkb_read_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs* args;
+
+  args = (RGeo_SerializationArgs*)data;
+  if (args->hex) {
+    return GEOSWKBReader_readHEX_r(context,
+                                   (GEOSWKBReader*)args->serializer,
+                                   (const unsigned char*)args->str,
+                                   args->size);
+  }
+  return GEOSWKBReader_read_r(context,
+                              (GEOSWKBReader*)args->serializer,
+                              (const unsigned char*)args->str,
+                              args->size);
+}
+
+static void*
+wkt_write_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs* args;
+
+  args = (RGeo_SerializationArgs*)data;
+  return GEOSWKTWriter_write_r(
+    context, (GEOSWKTWriter*)args->serializer, args->geom);
+}
+
+static void*
+wkb_write_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs* args;
+
+  args = (RGeo_SerializationArgs*)data;
+  return GEOSWKBWriter_write_r(
+    context, (GEOSWKBWriter*)args->serializer, args->geom, &args->size);
+}
+
+// Reads str, which must stay valid while the GVL is released.
+
 static VALUE
-method_factory_parse_wkt(VALUE self, VALUE str)
+read_wkt(VALUE factory, GEOSWKTReader** slot, const char* str)
 {
-  RGeo_FactoryData* self_data;
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs args;
   GEOSWKTReader* wkt_reader;
-  VALUE result;
   GEOSGeometry* geom;
+  int state = 0;
 
-  Check_Type(str, T_STRING);
-  self_data = RGEO_FACTORY_DATA_PTR(self);
-  wkt_reader = self_data->wkt_reader;
+  wkt_reader = *slot;
+  *slot = NULL;
   if (!wkt_reader) {
-    wkt_reader = GEOSWKTReader_create();
-    self_data->wkt_reader = wkt_reader;
+    wkt_reader = GEOSWKTReader_create_r(context);
   }
-  result = Qnil;
-  if (wkt_reader) {
-    geom = GEOSWKTReader_read(wkt_reader, RSTRING_PTR(str));
+  if (!wkt_reader) {
+    return Qnil;
+  }
+  args.serializer = wkt_reader;
+  args.str = str;
+  geom = (GEOSGeometry*)rgeo_without_gvl(wkt_read_nogvl, &args, &state);
+  if (*slot) {
+    GEOSWKTReader_destroy_r(context, wkt_reader);
+  } else {
+    *slot = wkt_reader;
+  }
+  if (state) {
     if (geom) {
-      result = rgeo_wrap_geos_geometry(self, geom, Qnil);
+      GEOSGeom_destroy_r(context, geom);
     }
+    rb_jump_tag(state);
   }
-  return result;
+  return geom ? rgeo_wrap_geos_geometry(factory, geom, Qnil) : Qnil;
 }
 
 static VALUE
-method_factory_parse_wkb(VALUE self, VALUE str)
+parse_wkt(VALUE factory, GEOSWKTReader** slot, VALUE str)
 {
-  RGeo_FactoryData* self_data;
-  GEOSWKBReader* wkb_reader;
   VALUE result;
-  GEOSGeometry* geom;
-  char* c_str;
 
   Check_Type(str, T_STRING);
-  self_data = RGEO_FACTORY_DATA_PTR(self);
-  wkb_reader = self_data->wkb_reader;
+  // Parse a frozen copy so the buffer cannot change while the GVL is
+  // released. This does not copy the bytes unless str is modified later.
+  str = rb_str_new_frozen(str);
+  result = read_wkt(factory, slot, RSTRING_PTR(str));
+  RB_GC_GUARD(str);
+  return result;
+}
+
+// Reads WKB, or hex WKB if hex is set, with the reader kept in slot.
+// str must stay valid while the GVL is released.
+
+static GEOSGeometry*
+read_wkb_geometry(GEOSWKBReader** slot,
+                  const char* str,
+                  size_t size,
+                  char hex)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs args;
+  GEOSWKBReader* wkb_reader;
+  GEOSGeometry* geom;
+  int state = 0;
+
+  wkb_reader = *slot;
+  *slot = NULL;
   if (!wkb_reader) {
-    wkb_reader = GEOSWKBReader_create();
-    self_data->wkb_reader = wkb_reader;
+    wkb_reader = GEOSWKBReader_create_r(context);
   }
-  result = Qnil;
-  if (wkb_reader) {
-    c_str = RSTRING_PTR(str);
-    if (c_str[0] == '\x00' || c_str[0] == '\x01')
-      geom = GEOSWKBReader_read(
-        wkb_reader, (unsigned char*)c_str, (size_t)RSTRING_LEN(str));
-    else
-      geom = GEOSWKBReader_readHEX(
-        wkb_reader, (unsigned char*)c_str, (size_t)RSTRING_LEN(str));
+  if (!wkb_reader) {
+    return NULL;
+  }
+  args.serializer = wkb_reader;
+  args.str = str;
+  args.size = size;
+  args.hex = hex;
+  geom = (GEOSGeometry*)rgeo_without_gvl(wkb_read_nogvl, &args, &state);
+  if (*slot) {
+    GEOSWKBReader_destroy_r(context, wkb_reader);
+  } else {
+    *slot = wkb_reader;
+  }
+  if (state) {
     if (geom) {
-      result = rgeo_wrap_geos_geometry(self, geom, Qnil);
+      GEOSGeom_destroy_r(context, geom);
     }
+    rb_jump_tag(state);
   }
-  return result;
+  return geom;
 }
 
+// Same as read_wkt for WKB, or hex WKB if hex is set.
+
 static VALUE
-method_factory_read_for_marshal(VALUE self, VALUE str)
+read_wkb(VALUE factory,
+         GEOSWKBReader** slot,
+         const char* str,
+         size_t size,
+         char hex)
 {
-  RGeo_FactoryData* self_data;
-  GEOSWKBReader* wkb_reader;
-  VALUE result;
   GEOSGeometry* geom;
 
+  geom = read_wkb_geometry(slot, str, size, hex);
+  return geom ? rgeo_wrap_geos_geometry(factory, geom, Qnil) : Qnil;
+}
+
+static VALUE
+parse_wkb(VALUE factory, GEOSWKBReader** slot, VALUE str, char allow_hex)
+{
+  const char* data;
+  VALUE result;
+
   Check_Type(str, T_STRING);
-  self_data = RGEO_FACTORY_DATA_PTR(self);
-  wkb_reader = self_data->marshal_wkb_reader;
-  if (!wkb_reader) {
-    wkb_reader = GEOSWKBReader_create();
-    self_data->marshal_wkb_reader = wkb_reader;
+  str = rb_str_new_frozen(str);
+  data = RSTRING_PTR(str);
+  result = read_wkb(factory,
+                    slot,
+                    data,
+                    (size_t)RSTRING_LEN(str),
+                    allow_hex && data[0] != '\x00' && data[0] != '\x01');
+  RB_GC_GUARD(str);
+  return result;
+}
+
+VALUE
+rgeo_write_wkt(VALUE factory,
+               GEOSWKTWriter** slot,
+               int output_dimension,
+               VALUE obj)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs args;
+  GEOSWKTWriter* wkt_writer;
+  char* str;
+  VALUE result;
+  int state = 0;
+
+  args.geom = rgeo_get_geos_geometry_safe(obj);
+  if (!args.geom) {
+    return Qnil;
+  }
+  wkt_writer = *slot;
+  *slot = NULL;
+  if (!wkt_writer) {
+    wkt_writer = GEOSWKTWriter_create_r(context);
+    if (!wkt_writer) {
+      return Qnil;
+    }
+    GEOSWKTWriter_setOutputDimension_r(context, wkt_writer, output_dimension);
+    GEOSWKTWriter_setTrim_r(context, wkt_writer, 1);
+  }
+  args.serializer = wkt_writer;
+  str = (char*)rgeo_without_gvl(wkt_write_nogvl, &args, &state);
+  RB_GC_GUARD(obj);
+  RB_GC_GUARD(factory);
+  if (*slot) {
+    GEOSWKTWriter_destroy_r(context, wkt_writer);
+  } else {
+    *slot = wkt_writer;
   }
   result = Qnil;
-  if (wkb_reader) {
-    geom = GEOSWKBReader_read(
-      wkb_reader, (unsigned char*)RSTRING_PTR(str), (size_t)RSTRING_LEN(str));
-    if (geom) {
-      result = rgeo_wrap_geos_geometry(self, geom, Qnil);
+  if (str) {
+    if (!state) {
+      result = rb_str_new2(str);
     }
+    GEOSFree_r(context, str);
+  }
+  if (state) {
+    rb_jump_tag(state);
   }
   return result;
 }
 
+// Lower case, as in the output of WKRep::WKBGenerator.
+
+static void
+hex_encode_to(char* out, const unsigned char* data, size_t size)
+{
+  static const char digits[] = "0123456789abcdef";
+  size_t i;
+
+  for (i = 0; i < size; ++i) {
+    out[i * 2] = digits[data[i] >> 4];
+    out[i * 2 + 1] = digits[data[i] & 0xf];
+  }
+}
+
 static VALUE
-method_factory_read_for_psych(VALUE self, VALUE str)
+hex_encode(const unsigned char* data, size_t size)
 {
-  RGeo_FactoryData* self_data;
-  GEOSWKTReader* wkt_reader;
   VALUE result;
-  GEOSGeometry* geom;
 
-  Check_Type(str, T_STRING);
-  self_data = RGEO_FACTORY_DATA_PTR(self);
-  wkt_reader = self_data->psych_wkt_reader;
-  if (!wkt_reader) {
-    wkt_reader = GEOSWKTReader_create();
-    self_data->psych_wkt_reader = wkt_reader;
+  result = rb_usascii_str_new(NULL, size * 2);
+  hex_encode_to(RSTRING_PTR(result), data, size);
+  return result;
+}
+
+static int
+hex_digit(char c)
+{
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Returns nil for input that is not plain hex, which WKRep::WKBParser
+// would decode differently.
+
+static VALUE
+hex_decode(const char* str, long len)
+{
+  VALUE result;
+  char* out;
+  long i;
+  int high;
+  int low;
+
+  if (len % 2) {
+    return Qnil;
+  }
+  result = rb_str_new(NULL, len / 2);
+  out = RSTRING_PTR(result);
+  for (i = 0; i < len / 2; ++i) {
+    high = hex_digit(str[i * 2]);
+    low = hex_digit(str[i * 2 + 1]);
+    if (high < 0 || low < 0) {
+      return Qnil;
+    }
+    out[i] = (char)(high << 4 | low);
+  }
+  return result;
+}
+
+static GEOSWKBWriter*
+create_wkb_writer(int output_dimension, int options)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSWKBWriter* wkb_writer;
+
+  wkb_writer = GEOSWKBWriter_create_r(context);
+  if (!wkb_writer) {
+    return NULL;
+  }
+  GEOSWKBWriter_setOutputDimension_r(context, wkb_writer, output_dimension);
+  if (options & RGEO_WKB_BIG_ENDIAN) {
+    GEOSWKBWriter_setByteOrder_r(context, wkb_writer, GEOS_WKB_XDR);
+  } else if (options & RGEO_WKB_LITTLE_ENDIAN) {
+    GEOSWKBWriter_setByteOrder_r(context, wkb_writer, GEOS_WKB_NDR);
+  }
+  if (options & RGEO_WKB_INCLUDE_SRID) {
+    GEOSWKBWriter_setIncludeSRID_r(context, wkb_writer, 1);
+  }
+#ifdef RGEO_GEOS_SUPPORTS_WKB_FLAVOR
+  if (options & RGEO_WKB_ISO) {
+    GEOSWKBWriter_setFlavor_r(context, wkb_writer, GEOS_WKB_ISO);
+  }
+#endif
+  return wkb_writer;
+}
+
+// Writes geom with the writer kept in slot, and with the given SRID if
+// the options include it. The returned buffer, if any, must be freed with
+// GEOSFree_r, even when state is set.
+
+static char*
+write_wkb(GEOSWKBWriter** slot,
+          int output_dimension,
+          int options,
+          const GEOSGeometry* geom,
+          int srid,
+          size_t* size,
+          int* state)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_SerializationArgs args;
+  GEOSWKBWriter* wkb_writer;
+  GEOSGeometry* srid_geom;
+  char* str;
+
+  // A GEOS geometry shared by copies keeps the SRID of its first factory.
+  srid_geom = NULL;
+  if ((options & RGEO_WKB_INCLUDE_SRID) &&
+      GEOSGetSRID_r(context, geom) != srid) {
+    srid_geom = GEOSGeom_clone_r(context, geom);
+    if (!srid_geom) {
+      return NULL;
+    }
+    GEOSSetSRID_r(context, srid_geom, srid);
+    geom = srid_geom;
+  }
+  wkb_writer = *slot;
+  *slot = NULL;
+  if (!wkb_writer) {
+    wkb_writer = create_wkb_writer(output_dimension, options);
+    if (!wkb_writer) {
+      if (srid_geom) {
+        GEOSGeom_destroy_r(context, srid_geom);
+      }
+      return NULL;
+    }
+  }
+  args.serializer = wkb_writer;
+  args.geom = geom;
+  args.size = 0;
+  str = (char*)rgeo_without_gvl(wkb_write_nogvl, &args, state);
+  if (*slot) {
+    GEOSWKBWriter_destroy_r(context, wkb_writer);
+  } else {
+    *slot = wkb_writer;
   }
+  if (srid_geom) {
+    GEOSGeom_destroy_r(context, srid_geom);
+  }
+  *size = args.size;
+  return str;
+}
+
+VALUE
+rgeo_write_wkb(VALUE factory,
+               GEOSWKBWriter** slot,
+               int output_dimension,
+               int options,
+               VALUE obj)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  const GEOSGeometry* geom;
+  char* str;
+  size_t size;
+  VALUE result;
+  int state = 0;
+
+  geom = rgeo_get_geos_geometry_safe(obj);
+  if (!geom) {
+    return Qnil;
+  }
+  str = write_wkb(slot,
+                  output_dimension,
+                  options,
+                  geom,
+                  RGEO_FACTORY_DATA_PTR(factory)->srid,
+                  &size,
+                  &state);
+  RB_GC_GUARD(obj);
+  RB_GC_GUARD(factory);
   result = Qnil;
-  if (wkt_reader) {
-    geom = GEOSWKTReader_read(wkt_reader, RSTRING_PTR(str));
-    if (geom) {
-      result = rgeo_wrap_geos_geometry(self, geom, Qnil);
+  if (str) {
+    if (!state) {
+      result = options & RGEO_WKB_HEX
+                 ? hex_encode((const unsigned char*)str, size)
+                 : rb_str_new(str, size);
     }
+    GEOSFree_r(context, str);
+  }
+  if (state) {
+    rb_jump_tag(state);
+  }
+  return result;
+}
+
+/**** LAZY GEOMETRIES ****/
+
+static char
+host_big_endian()
+{
+  unsigned int one = 1;
+
+  return *(unsigned char*)&one == 0;
+}
+
+// Tells whether the WKB a lazy geometry was parsed from is what the WKB
+// writer of the given factory writes for it. The hex encoding is not
+// compared if ignore_hex is set.
+
+static char
+lazy_wkb_written(const RGeo_GeometryData* object_data,
+                 const RGeo_FactoryData* factory_data,
+                 char ignore_hex)
+{
+  int format;
+  int options;
+  int output_dimension;
+
+  format = object_data->wkb_format;
+  if (NIL_P(object_data->wkb) || format < 0) {
+    return 0;
+  }
+  if (factory_data->wkb_options & RGEO_WKB_NATIVE) {
+    options = factory_data->wkb_options;
+    output_dimension = factory_data->wkb_output_dimension;
+  } else if (NIL_P(factory_data->wkrep_wkb_generator)) {
+    options = 0;
+    output_dimension = 2;
+  } else {
+    return 0;
+  }
+  if (!ignore_hex && !(options & RGEO_WKB_HEX) != !object_data->wkb_hex) {
+    return 0;
+  }
+  if (!(options & (RGEO_WKB_BIG_ENDIAN | RGEO_WKB_LITTLE_ENDIAN)) &&
+      host_big_endian()) {
+    options |= RGEO_WKB_BIG_ENDIAN;
+  }
+  if ((format & RGEO_WKB_BIG_ENDIAN) != (options & RGEO_WKB_BIG_ENDIAN)) {
+    return 0;
+  }
+  // Lazy geometries are only made for data with the SRID of the factory,
+  // which is the one GEOS writes, but not for a 0 SRID that GEOS may
+  // leave out.
+  if ((format & RGEO_WKB_INCLUDE_SRID) != (options & RGEO_WKB_INCLUDE_SRID) ||
+      ((options & RGEO_WKB_INCLUDE_SRID) && !factory_data->srid)) {
+    return 0;
   }
+  // Z coordinates are written with the type code flags of EWKB, or the
+  // type codes of ISO WKB. 2D data has neither, whatever the options.
+  if (format & RGEO_WKB_ISO) {
+    return output_dimension == 3 && (options & RGEO_WKB_ISO);
+  }
+  if (format & RGEO_WKB_EWKB) {
+    return output_dimension == 3 && !(options & RGEO_WKB_ISO);
+  }
+  return 1;
+}
+
+VALUE
+rgeo_lazy_wkb_as_binary(const RGeo_GeometryData* object_data)
+{
+  VALUE result;
+
+  if (NIL_P(object_data->wkb) ||
+      !lazy_wkb_written(
+        object_data, RGEO_FACTORY_DATA_PTR(object_data->factory), 0)) {
+    return Qnil;
+  }
+  // The copy shares the bytes of the frozen string.
+  result = rb_str_dup(object_data->wkb);
+  rb_enc_associate_index(result,
+                         object_data->wkb_hex ? rb_usascii_encindex()
+                                              : rb_ascii8bit_encindex());
   return result;
 }
 
+// Record formats of factory.write_wkb.
+#define RGEO_WKB_STREAM_BINARY 0
+#define RGEO_WKB_STREAM_HEX 1
+#define RGEO_WKB_STREAM_LENGTH_PREFIXED 2
+
+/*
+  State of factory.write_wkb. Records are appended to buffer, which is
+  written to io and emptied once it holds flush_size bytes. format is one
+  of the RGEO_WKB_STREAM_ values.
+*/
+typedef struct
+{
+  VALUE factory;
+  VALUE io;
+  VALUE buffer;
+  long flush_size;
+  long count;
+  int format;
+} RGeo_WKBStream;
+
+static void
+append_wkb_record(RGeo_WKBStream* stream, const char* data, size_t size)
+{
+  unsigned char prefix[4];
+  char* out;
+  long len;
+
+  if (stream->format == RGEO_WKB_STREAM_HEX) {
+    // One record per line, as read by each_wkb.
+    len = RSTRING_LEN(stream->buffer);
+    rb_str_modify_expand(stream->buffer, (long)(size * 2 + 1));
+    out = RSTRING_PTR(stream->buffer) + len;
+    hex_encode_to(out, (const unsigned char*)data, size);
+    out[size * 2] = '\n';
+    rb_str_set_len(stream->buffer, len + (long)(size * 2 + 1));
+    return;
+  }
+  if (stream->format == RGEO_WKB_STREAM_LENGTH_PREFIXED) {
+    if (size > 0xffffffffUL) {
+      rb_raise(rb_eRangeError, "WKB record of %zu bytes is too long", size);
+    }
+    prefix[0] = (unsigned char)(size >> 24);
+    prefix[1] = (unsigned char)(size >> 16);
+    prefix[2] = (unsigned char)(size >> 8);
+    prefix[3] = (unsigned char)size;
+    rb_str_cat(stream->buffer, (const char*)prefix, 4);
+  }
+  rb_str_cat(stream->buffer, data, (long)size);
+}
+
+static void
+flush_wkb_stream(RGeo_WKBStream* stream)
+{
+  if (RSTRING_LEN(stream->buffer) > 0) {
+    rb_funcall(stream->io, rb_intern("write"), 1, stream->buffer);
+    // The IO may keep a reference to the buffer, which rb_str_resize
+    // makes independent again, unlike rb_str_set_len.
+    rb_str_resize(stream->buffer, 0);
+  }
+}
+
+static VALUE
+write_wkb_record(RB_BLOCK_CALL_FUNC_ARGLIST(geom, data))
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_WKBStream* stream = (RGeo_WKBStream*)data;
+  RGeo_FactoryData* factory_data;
+  RGeo_GeometryData* object_data;
+  VALUE object;
+  VALUE str;
+  char* wkb;
+  size_t size;
+  int state = 0;
+
+  factory_data = RGEO_FACTORY_DATA_PTR(stream->factory);
+  object = rgeo_convert_to_geos_object(stream->factory, geom, Qnil, &state);
+  if (state) {
+    rb_jump_tag(state);
+  }
+  object_data = RGEO_GEOMETRY_LAZY_DATA_PTR(object);
+  if (!object_data->wkb_hex &&
+      lazy_wkb_written(object_data, factory_data, 1)) {
+    // The bytes a lazy geometry was parsed from, without reading them.
+    str = object_data->wkb;
+    append_wkb_record(stream, RSTRING_PTR(str), (size_t)RSTRING_LEN(str));
+  } else if (!(factory_data->wkb_options & RGEO_WKB_NATIVE) &&
+             !NIL_P(factory_data->wkrep_wkb_generator)) {
+    // Same bytes as as_binary, without its hex encoding if any.
+    str = rb_funcall(
+      factory_data->wkrep_wkb_generator, rb_intern("generate"), 1, object);
+    StringValue(str);
+    if (RSTRING_LEN(str) > 0 && RSTRING_PTR(str)[0] != '\x00' &&
+        RSTRING_PTR(str)[0] != '\x01') {
+      str = hex_decode(RSTRING_PTR(str), RSTRING_LEN(str));
+      if (NIL_P(str)) {
+        rb_raise(rb_eRGeoError, "Cannot decode the WKB of the generator");
+      }
+    }
+    append_wkb_record(stream, RSTRING_PTR(str), (size_t)RSTRING_LEN(str));
+  } else {
+    if (factory_data->wkb_options & RGEO_WKB_NATIVE) {
+      wkb = write_wkb(&factory_data->wkb_writer,
+                      factory_data->wkb_output_dimension,
+                      factory_data->wkb_options,
+                      RGEO_GEOMETRY_DATA_PTR(object)->geom,
+                      factory_data->srid,
+                      &size,
+                      &state);
+    } else {
+      wkb = write_wkb(&factory_data->wkb_writer,
+                      2,
+                      0,
+                      RGEO_GEOMETRY_DATA_PTR(object)->geom,
+                      factory_data->srid,
+                      &size,
+                      &state);
+    }
+    RB_GC_GUARD(object);
+    if (wkb && !state) {
+      append_wkb_record(stream, wkb, size);
+    }
+    if (wkb) {
+      GEOSFree_r(context, wkb);
+    }
+    if (state) {
+      rb_jump_tag(state);
+    }
+  }
+  ++stream->count;
+  if (RSTRING_LEN(stream->buffer) >= stream->flush_size) {
+    flush_wkb_stream(stream);
+  }
+  return Qnil;
+}
+
+static VALUE
+method_factory_write_wkb(VALUE self,
+                         VALUE io,
+                         VALUE geometries,
+                         VALUE format,
+                         VALUE flush_size)
+{
+  RGeo_WKBStream stream;
+  ID format_id;
+
+  format_id = rb_sym2id(format);
+  if (format_id == rb_intern("binary")) {
+    stream.format = RGEO_WKB_STREAM_BINARY;
+  } else if (format_id == rb_intern("hex")) {
+    stream.format = RGEO_WKB_STREAM_HEX;
+  } else if (format_id == rb_intern("length_prefixed")) {
+    stream.format = RGEO_WKB_STREAM_LENGTH_PREFIXED;
+  } else {
+    rb_raise(rb_eArgError, "Unknown WKB format: %" PRIsVALUE, format);
+  }
+  stream.factory = self;
+  stream.io = io;
+  stream.flush_size = NUM2LONG(flush_size);
+  stream.count = 0;
+  stream.buffer = rb_str_buf_new(stream.flush_size);
+  rb_block_call(
+    geometries, rb_intern("each"), 0, NULL, write_wkb_record, (VALUE)&stream);
+  flush_wkb_stream(&stream);
+  RB_GC_GUARD(stream.buffer);
+  RB_GC_GUARD(stream.io);
+  return LONG2NUM(stream.count);
+}
+
+// Size of the WKB that GEOS read geom from, without the SRID of the
+// top level header. Returns 0 for what WKB cannot hold.
+
+static size_t
+wkb_size(GEOSContextHandle_t context,
+         const GEOSGeometry* geom,
+         size_t coord_size)
+{
+  const GEOSCoordSequence* coord_seq;
+  unsigned int size;
+  size_t result;
+  int count;
+  int i;
+
+  switch (GEOSGeomTypeId_r(context, geom)) {
+    case GEOS_POINT:
+      return 5 + coord_size;
+    case GEOS_LINESTRING:
+    case GEOS_LINEARRING:
+      coord_seq = GEOSGeom_getCoordSeq_r(context, geom);
+      if (!coord_seq || !GEOSCoordSeq_getSize_r(context, coord_seq, &size)) {
+        return 0;
+      }
+      return 9 + size * coord_size;
+    case GEOS_POLYGON:
+      if (GEOSisEmpty_r(context, geom)) {
+        return 9;
+      }
+      // Rings are written without their own header.
+      result = 4 + wkb_size(context, GEOSGetExteriorRing_r(context, geom),
+                            coord_size);
+      count = GEOSGetNumInteriorRings_r(context, geom);
+      for (i = 0; i < count; ++i) {
+        result += wkb_size(
+                    context, GEOSGetInteriorRingN_r(context, geom, i),
+                    coord_size) -
+                  5;
+      }
+      return result;
+    case GEOS_MULTIPOINT:
+    case GEOS_MULTILINESTRING:
+    case GEOS_MULTIPOLYGON:
+    case GEOS_GEOMETRYCOLLECTION:
+      result = 9;
+      count = GEOSGetNumGeometries_r(context, geom);
+      for (i = 0; i < count; ++i) {
+        result +=
+          wkb_size(context, GEOSGetGeometryN_r(context, geom, i), coord_size);
+      }
+      return result;
+    default:
+      return 0;
+  }
+}
+
+typedef struct
+{
+  VALUE factory;
+  VALUE str;
+} RGeo_NativeParseArgs;
+
+static VALUE
+native_wkb_read(VALUE data)
+{
+  RGeo_NativeParseArgs* args = (RGeo_NativeParseArgs*)data;
+
+  return parse_wkb(args->factory,
+                   &RGEO_FACTORY_DATA_PTR(args->factory)->wkb_reader,
+                   args->str,
+                   0);
+}
+
+static VALUE
+native_wkt_read(VALUE data)
+{
+  RGeo_NativeParseArgs* args = (RGeo_NativeParseArgs*)data;
+
+  return parse_wkt(args->factory,
+                   &RGEO_FACTORY_DATA_PTR(args->factory)->wkt_reader,
+                   args->str);
+}
+
+// Reads str with GEOS, returning nil instead of raising parse errors so
+// that the WKRep parser can report them in its own words.
+
+static VALUE
+native_read(VALUE (*read)(VALUE), VALUE factory, VALUE str)
+{
+  RGeo_NativeParseArgs args;
+  VALUE result;
+  int state = 0;
+
+  args.factory = factory;
+  args.str = str;
+  result = rb_protect(read, (VALUE)&args, &state);
+  if (state) {
+    if (!rb_obj_is_kind_of(rb_errinfo(), rb_eRGeoParseError)) {
+      rb_jump_tag(state);
+    }
+    rb_set_errinfo(Qnil);
+    return Qnil;
+  }
+  return result;
+}
+
+static VALUE
+method_factory_parse_wkb_native(VALUE self, VALUE str)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_FactoryData* factory_data;
+  const unsigned char* data;
+  long len;
+  unsigned int type_code;
+  size_t srid_size;
+  char has_z;
+  char has_m;
+  int options;
+  int flags;
+  VALUE result;
+
+  Check_Type(str, T_STRING);
+  factory_data = RGEO_FACTORY_DATA_PTR(self);
+  options = factory_data->wkb_parser_options;
+  flags = factory_data->flags;
+  if (!(options & RGEO_WKB_NATIVE)) {
+    return Qnil;
+  }
+  if (RSTRING_LEN(str) > 0 && hex_digit(RSTRING_PTR(str)[0]) >= 0) {
+    str = hex_decode(RSTRING_PTR(str), RSTRING_LEN(str));
+    if (NIL_P(str)) {
+      return Qnil;
+    }
+  }
+  data = (const unsigned char*)RSTRING_PTR(str);
+  len = RSTRING_LEN(str);
+  if (len < 5 || data[0] > 1) {
+    return Qnil;
+  }
+  if (data[0]) {
+    type_code = (unsigned int)data[1] | (unsigned int)data[2] << 8 |
+                (unsigned int)data[3] << 16 | (unsigned int)data[4] << 24;
+  } else {
+    type_code = (unsigned int)data[4] | (unsigned int)data[3] << 8 |
+                (unsigned int)data[2] << 16 | (unsigned int)data[1] << 24;
+  }
+
+  // Same type code rules as WKRep::WKBParser. Whatever GEOS could read
+  // differently, M coordinates in particular, is left to the parser.
+  has_z = 0;
+  has_m = 0;
+  srid_size = 0;
+  if (options & RGEO_WKB_EWKB) {
+    has_z = (type_code & 0x80000000) != 0;
+    has_m = (type_code & 0x40000000) != 0;
+    srid_size = (type_code & 0x20000000) ? 4 : 0;
+    type_code &= 0x0fffffff;
+  }
+  if (options & RGEO_WKB_ISO) {
+#ifndef RGEO_GEOS_SUPPORTS_WKB_FLAVOR
+    if (type_code >= 1000) {
+      return Qnil;
+    }
+#endif
+    has_z |= ((type_code / 1000) & 1) != 0;
+    has_m |= ((type_code / 1000) & 2) != 0;
+    type_code %= 1000;
+  }
+  if (type_code < 1 || type_code > 7 || has_m) {
+    return Qnil;
+  }
+  if (has_z ? !(flags & RGEO_FACTORYFLAGS_SUPPORTS_Z)
+            : (flags & RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M)) {
+    return Qnil;
+  }
+
+  result = native_read(native_wkb_read, self, str);
+  if (NIL_P(result)) {
+    return Qnil;
+  }
+  // Enclosed SRIDs, or mismatched enclosed dimensions, make the sizes
+  // differ too. The parser then accepts or rejects those.
+  if (!(options & RGEO_WKB_IGNORE_EXTRA_BYTES) &&
+      wkb_size(context,
+               rgeo_get_geos_geometry_safe(result),
+               has_z ? 3 * sizeof(double) : 2 * sizeof(double)) +
+          srid_size !=
+        (size_t)len) {
+    return Qnil;
+  }
+  RB_GC_GUARD(str);
+  return result;
+}
+
+/*
+  State of scan_wkb. allowed holds the RGEO_WKB_EWKB and RGEO_WKB_ISO
+  type codes that may be found. format gets the byte order, SRID and
+  type code options of the outer geometry, and mixed is set if inner
+  geometries differ from it.
+*/
+typedef struct
+{
+  const unsigned char* data;
+  size_t size;
+  size_t pos;
+  int allowed;
+  int format;
+  char mixed;
+  char has_z;
+  char has_m;
+  int srid;
+  unsigned int type;
+  char has_bounds;
+  double bounds[4];
+} RGeo_WKBScan;
+
+// Nesting depth up to which collections are scanned.
+#define RGEO_WKB_SCAN_MAX_DEPTH 64
+
+static char
+scan_wkb_uint32(RGeo_WKBScan* scan, char big_endian, unsigned int* value)
+{
+  const unsigned char* data;
+
+  if (scan->size - scan->pos < 4) {
+    return 0;
+  }
+  data = scan->data + scan->pos;
+  if (big_endian) {
+    *value = (unsigned int)data[3] | (unsigned int)data[2] << 8 |
+             (unsigned int)data[1] << 16 | (unsigned int)data[0] << 24;
+  } else {
+    *value = (unsigned int)data[0] | (unsigned int)data[1] << 8 |
+             (unsigned int)data[2] << 16 | (unsigned int)data[3] << 24;
+  }
+  scan->pos += 4;
+  return 1;
+}
+
+// Skips count coordinates, extending the bounds with their X and Y.
+// non_empty gets the number of coordinates that are not NaN.
+
+static char
+scan_wkb_coordinates(RGeo_WKBScan* scan,
+                     char big_endian,
+                     unsigned int count,
+                     unsigned int* non_empty)
+{
+  size_t coord_size;
+  unsigned char bytes[16];
+  double xy[2];
+  char swap;
+  unsigned int i;
+  int k;
+
+  coord_size = (2 + (size_t)scan->has_z + (size_t)scan->has_m) * 8;
+  if ((scan->size - scan->pos) / coord_size < count) {
+    return 0;
+  }
+  swap = big_endian != host_big_endian();
+  *non_empty = 0;
+  for (i = 0; i < count; ++i) {
+    for (k = 0; k < 16; ++k) {
+      bytes[k] = scan->data[scan->pos + (swap ? (k & 8) + 7 - (k & 7) : k)];
+    }
+    memcpy(xy, bytes, 16);
+    scan->pos += coord_size;
+    if (isnan(xy[0]) || isnan(xy[1])) {
+      continue;
+    }
+    ++*non_empty;
+    if (!scan->has_bounds) {
+      scan->bounds[0] = scan->bounds[2] = xy[0];
+      scan->bounds[1] = scan->bounds[3] = xy[1];
+      scan->has_bounds = 1;
+      continue;
+    }
+    if (xy[0] < scan->bounds[0]) {
+      scan->bounds[0] = xy[0];
+    } else if (xy[0] > scan->bounds[2]) {
+      scan->bounds[2] = xy[0];
+    }
+    if (xy[1] < scan->bounds[1]) {
+      scan->bounds[1] = xy[1];
+    } else if (xy[1] > scan->bounds[3]) {
+      scan->bounds[3] = xy[1];
+    }
+  }
+  return 1;
+}
+
+// Checks the structure of the WKB geometry at the position of scan, and
+// moves past it. Inner geometries of multi geometries must have the type
+// of their parts, given as part_type. Returns the type code of the
+// geometry, or 0 if it is not WKB that GEOS reads the same way.
+
+static unsigned int
+scan_wkb_geometry(RGeo_WKBScan* scan, unsigned int part_type, int depth)
+{
+  unsigned int type_code;
+  unsigned int count;
+  unsigned int size;
+  unsigned int non_empty;
+  unsigned int i;
+  unsigned int srid;
+  char big_endian;
+  char has_z;
+  char has_m;
+  int format;
+
+  if (depth > RGEO_WKB_SCAN_MAX_DEPTH || scan->pos >= scan->size ||
+      scan->data[scan->pos] > 1) {
+    return 0;
+  }
+  big_endian = scan->data[scan->pos] == 0;
+  ++scan->pos;
+  if (!scan_wkb_uint32(scan, big_endian, &type_code)) {
+    return 0;
+  }
+  format = big_endian ? RGEO_WKB_BIG_ENDIAN : RGEO_WKB_LITTLE_ENDIAN;
+  has_z = (type_code & 0x80000000) != 0;
+  has_m = (type_code & 0x40000000) != 0;
+  if (type_code & 0xe0000000) {
+    if (!(scan->allowed & RGEO_WKB_EWKB)) {
+      return 0;
+    }
+    if (has_z) {
+      format |= RGEO_WKB_EWKB;
+    }
+    // Only the outer geometry of EWKB has a SRID.
+    if (type_code & 0x20000000) {
+      if (depth || !scan_wkb_uint32(scan, big_endian, &srid)) {
+        return 0;
+      }
+      scan->srid = (int)srid;
+      format |= RGEO_WKB_INCLUDE_SRID;
+    }
+    type_code &= 0x0fffffff;
+  } else if (type_code >= 1000) {
+    if (!(scan->allowed & RGEO_WKB_ISO)) {
+      return 0;
+    }
+    has_z = ((type_code / 1000) & 1) != 0;
+    has_m = ((type_code / 1000) & 2) != 0;
+    if (has_z) {
+      format |= RGEO_WKB_ISO;
+    }
+    type_code %= 1000;
+  }
+  if (type_code < 1 || type_code > 7 || (part_type && type_code != part_type)) {
+    return 0;
+  }
+  if (depth) {
+    if (has_z != scan->has_z || has_m != scan->has_m) {
+      return 0;
+    }
+    if (format != (scan->format & ~RGEO_WKB_INCLUDE_SRID)) {
+      scan->mixed = 1;
+    }
+  } else {
+    scan->has_z = has_z;
+    scan->has_m = has_m;
+    scan->format = format;
+    scan->type = type_code;
+  }
+
+  switch (type_code) {
+    case 1:
+      // Empty points are made collections when they are not parts.
+      return scan_wkb_coordinates(scan, big_endian, 1, &non_empty) &&
+                 (depth || non_empty)
+               ? type_code
+               : 0;
+    case 2:
+      return scan_wkb_uint32(scan, big_endian, &size) &&
+                 scan_wkb_coordinates(scan, big_endian, size, &non_empty)
+               ? type_code
+               : 0;
+    case 3:
+      if (!scan_wkb_uint32(scan, big_endian, &count) ||
+          (scan->size - scan->pos) / 4 < count) {
+        return 0;
+      }
+      for (i = 0; i < count; ++i) {
+        if (!scan_wkb_uint32(scan, big_endian, &size) ||
+            !scan_wkb_coordinates(scan, big_endian, size, &non_empty)) {
+          return 0;
+        }
+      }
+      return type_code;
+    default:
+      if (!scan_wkb_uint32(scan, big_endian, &count) ||
+          (scan->size - scan->pos) / 5 < count) {
+        return 0;
+      }
+      for (i = 0; i < count; ++i) {
+        if (!scan_wkb_geometry(
+              scan, type_code < 7 ? type_code - 3 : 0, depth + 1)) {
+          return 0;
+        }
+      }
+      return type_code;
+  }
+}
+
+static VALUE
+method_factory_parse_wkb_lazy(VALUE self, VALUE str)
+{
+  RGeo_FactoryData* factory_data;
+  RGeo_GeometryData* data;
+  RGeo_WKBScan scan;
+  VALUE bytes;
+  VALUE klass;
+  VALUE result;
+  const char* ptr;
+  long len;
+  long i;
+  char hex;
+  char lower;
+
+  Check_Type(str, T_STRING);
+  factory_data = RGEO_FACTORY_DATA_PTR(self);
+  ptr = RSTRING_PTR(str);
+  len = RSTRING_LEN(str);
+  if (len == 0 || (factory_data->flags & RGEO_FACTORYFLAGS_SUPPORTS_M)) {
+    return Qnil;
+  }
+  // Same inputs as parse_wkb reads with GEOS, with or without a parser.
+  if (!NIL_P(factory_data->wkrep_wkb_parser)) {
+    if (!(factory_data->wkb_parser_options & RGEO_WKB_NATIVE)) {
+      return Qnil;
+    }
+    scan.allowed =
+      factory_data->wkb_parser_options & (RGEO_WKB_EWKB | RGEO_WKB_ISO);
+    hex = hex_digit(ptr[0]) >= 0;
+  } else {
+    scan.allowed = RGEO_WKB_EWKB | RGEO_WKB_ISO;
+    hex = ptr[0] != '\x00' && ptr[0] != '\x01';
+  }
+#ifndef RGEO_GEOS_SUPPORTS_WKB_FLAVOR
+  scan.allowed &= ~RGEO_WKB_ISO;
+#endif
+
+  str = rb_str_new_frozen(str);
+  bytes = str;
+  lower = 1;
+  if (hex) {
+    bytes = hex_decode(RSTRING_PTR(str), RSTRING_LEN(str));
+    if (NIL_P(bytes)) {
+      return Qnil;
+    }
+    for (i = 0; i < len && lower; ++i) {
+      lower = RSTRING_PTR(str)[i] < 'A' || RSTRING_PTR(str)[i] > 'F';
+    }
+  }
+  scan.data = (const unsigned char*)RSTRING_PTR(bytes);
+  scan.size = (size_t)RSTRING_LEN(bytes);
+  scan.pos = 0;
+  scan.mixed = 0;
+  scan.srid = 0;
+  scan.has_bounds = 0;
+  if (!scan_wkb_geometry(&scan, 0, 0) || scan.pos != scan.size ||
+      scan.has_m ||
+      scan.has_z != !!(factory_data->flags & RGEO_FACTORYFLAGS_SUPPORTS_Z)) {
+    return Qnil;
+  }
+  RB_GC_GUARD(bytes);
+
+  switch (scan.type) {
+    case 1:
+      klass = rgeo_geos_point_class;
+      break;
+    case 2:
+      klass = rgeo_geos_line_string_class;
+      break;
+    case 3:
+      klass = rgeo_geos_polygon_class;
+      break;
+    case 4:
+      klass = rgeo_geos_multi_point_class;
+      break;
+    case 5:
+      klass = rgeo_geos_multi_line_string_class;
+      break;
+    case 6:
+      klass = rgeo_geos_multi_polygon_class;
+      break;
+    default:
+      klass = rgeo_geos_geometry_collection_class;
+  }
+  result = rgeo_wrap_geos_geometry(self, NULL, klass);
+  data = RGEO_GEOMETRY_LAZY_DATA_PTR(result);
+  data->wkb = str;
+  data->wkb_hex = hex;
+  data->wkb_format = scan.format | (hex ? RGEO_WKB_HEX : 0);
+  if (scan.mixed || !lower ||
+      ((scan.format & RGEO_WKB_INCLUDE_SRID) &&
+       scan.srid != factory_data->srid)) {
+    data->wkb_format = -1;
+  }
+  if (scan.has_bounds) {
+    memcpy(data->bounds, scan.bounds, sizeof(data->bounds));
+    data->bounds_state = RGEO_BOUNDS_KNOWN;
+  } else {
+    data->bounds_state = RGEO_BOUNDS_EMPTY;
+  }
+  return result;
+}
+
+// Type tags GEOS reads as WKRep::WKTParser does. Empty points are
+// turned into multi points by the parser, so EMPTY is left to it.
+
+static const char* wkt_type_tags[] = { "point",
+                                       "linestring",
+                                       "polygon",
+                                       "multipoint",
+                                       "multilinestring",
+                                       "multipolygon",
+                                       "geometrycollection",
+                                       NULL };
+
+static char
+wkt_tag_supported(const char* str, long len, int options)
+{
+  const char** tag;
+
+  if (len == 1 && (options & RGEO_WKT_WKT12) && (str[0] | 0x20) == 'z') {
+    return 1;
+  }
+  for (tag = wkt_type_tags; *tag; ++tag) {
+    if ((long)strlen(*tag) == len && !STRNCASECMP(str, *tag, len)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static VALUE
+method_factory_parse_wkt_native(VALUE self, VALUE str)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  const GEOSGeometry* geom;
+  const char* ptr;
+  long len;
+  long start;
+  long i;
+  int options;
+  int flags;
+  VALUE result;
+
+  Check_Type(str, T_STRING);
+  options = RGEO_FACTORY_DATA_PTR(self)->wkt_parser_options;
+  flags = RGEO_FACTORY_DATA_PTR(self)->flags;
+  if (!(options & RGEO_WKT_NATIVE)) {
+    return Qnil;
+  }
+  ptr = RSTRING_PTR(str);
+  len = RSTRING_LEN(str);
+
+  // The SRID of EWKT only selects a factory, which the parser already has.
+  start = 0;
+  if ((options & RGEO_WKT_EWKT) && len > 5 && !STRNCASECMP(ptr, "srid=", 5)) {
+    for (i = 5; i < len && ptr[i] >= '0' && ptr[i] <= '9'; ++i)
+      ;
+    if (i > 5 && i < len && ptr[i] == ';') {
+      start = i + 1;
+    }
+  }
+  for (i = start; i < len; ++i) {
+    if (ISALPHA(ptr[i])) {
+      long word = i;
+      while (i < len && ISALPHA(ptr[i])) {
+        ++i;
+      }
+      if (!wkt_tag_supported(ptr + word, i - word, options)) {
+        return Qnil;
+      }
+    }
+  }
+
+  if (start) {
+    str = rb_str_subseq(str, start, len - start);
+  }
+  result = native_read(native_wkt_read, self, str);
+  if (NIL_P(result)) {
+    return Qnil;
+  }
+  // The parser gives 2D data Z or M values of 0 on such factories, and
+  // rejects more coordinates than the factory has.
+  geom = rgeo_get_geos_geometry_safe(result);
+  if (GEOSGeom_getCoordinateDimension_r(context, geom) !=
+      RGEO_FACTORY_DIMS(flags)) {
+    return Qnil;
+  }
+  return result;
+}
+
+typedef struct
+{
+  VALUE factory;
+  char* str;
+  size_t size;
+  char wkt;
+} RGeo_RecordArgs;
+
+// Parses a record as parse_wkt or parse_wkb would. Without a WKRep
+// parser the record is read in place, so no string is created for it.
+
+static VALUE
+read_record(VALUE data)
+{
+  RGeo_RecordArgs* args = (RGeo_RecordArgs*)data;
+  RGeo_FactoryData* factory_data;
+
+  factory_data = RGEO_FACTORY_DATA_PTR(args->factory);
+  if (args->wkt) {
+    if (!NIL_P(factory_data->wkrep_wkt_parser)) {
+      return rb_funcall(args->factory,
+                        rb_intern("parse_wkt"),
+                        1,
+                        rb_str_new(args->str, (long)args->size));
+    }
+    return read_wkt(args->factory, &factory_data->wkt_reader, args->str);
+  }
+  if (!NIL_P(factory_data->wkrep_wkb_parser)) {
+    return rb_funcall(args->factory,
+                      rb_intern("parse_wkb"),
+                      1,
+                      rb_str_new(args->str, (long)args->size));
+  }
+  return read_wkb(
+    args->factory, &factory_data->wkb_reader, args->str, args->size, 1);
+}
+
+static VALUE
+method_factory_read_records(VALUE self,
+                            VALUE buffer,
+                            VALUE wkt,
+                            VALUE on_error)
+{
+  RGeo_RecordArgs args;
+  char* ptr;
+  char* newline;
+  long pos;
+  long len;
+  long size;
+  VALUE result;
+  VALUE error;
+  int state;
+
+  Check_Type(buffer, T_STRING);
+  rb_str_modify(buffer);
+  args.factory = self;
+  args.wkt = RTEST(wkt);
+  pos = 0;
+  for (;;) {
+    // The block may run the GC, so the buffer is looked up again.
+    ptr = RSTRING_PTR(buffer);
+    len = RSTRING_LEN(buffer);
+    newline = (char*)memchr(ptr + pos, '\n', (size_t)(len - pos));
+    if (!newline) {
+      break;
+    }
+    while (pos < newline - ptr && ISSPACE(ptr[pos])) {
+      ++pos;
+    }
+    size = newline - ptr - pos;
+    while (size > 0 && ISSPACE(ptr[pos + size - 1])) {
+      --size;
+    }
+    if (size > 0) {
+      // WKT readers need a terminated string.
+      ptr[pos + size] = '\0';
+      args.str = ptr + pos;
+      args.size = (size_t)size;
+      state = 0;
+      result = rb_protect(read_record, (VALUE)&args, &state);
+      if (!state) {
+        rb_yield(result);
+      } else {
+        // A deadline stops the whole read, not only the current record.
+        error = rb_errinfo();
+        if (NIL_P(on_error) || !rb_obj_is_kind_of(error, rb_eRGeoError) ||
+            rb_obj_is_kind_of(error, rb_eGeosDeadlineExceeded)) {
+          rb_jump_tag(state);
+        }
+        rb_set_errinfo(Qnil);
+        rb_funcall(on_error,
+                   rb_intern("call"),
+                   2,
+                   error,
+                   rb_str_new(RSTRING_PTR(buffer) + pos, size));
+      }
+    }
+    pos = newline - ptr + 1;
+  }
+  RB_GC_GUARD(buffer);
+  return LONG2NUM(pos);
+}
+
+static VALUE
+method_factory_parse_wkt(VALUE self, VALUE str)
+{
+  return parse_wkt(self, &RGEO_FACTORY_DATA_PTR(self)->wkt_reader, str);
+}
+
+static VALUE
+method_factory_parse_wkb(VALUE self, VALUE str)
+{
+  return parse_wkb(self, &RGEO_FACTORY_DATA_PTR(self)->wkb_reader, str, 1);
+}
+
+static VALUE
+method_factory_read_for_marshal(VALUE self, VALUE str)
+{
+  if (RGEO_FACTORY_DATA_PTR(self)->marshal_twkb) {
+    return rgeo_read_twkb(self, str);
+  }
+  return parse_wkb(
+    self, &RGEO_FACTORY_DATA_PTR(self)->marshal_wkb_reader, str, 0);
+}
+
+static VALUE
+method_factory_read_for_psych(VALUE self, VALUE str)
+{
+  return parse_wkt(self, &RGEO_FACTORY_DATA_PTR(self)->psych_wkt_reader, str);
+}
+
 #ifndef RGEO_GEOS_SUPPORTS_SETOUTPUTDIMENSION
 static VALUE marshal_wkb_generator;
 #endif
@@ -355,17 +1840,28 @@ static VALUE
 method_factory_write_for_marshal(VALUE self, VALUE obj)
 {
   RGeo_FactoryData* self_data;
-  GEOSWKBWriter* wkb_writer;
   const GEOSGeometry* geom;
   VALUE result;
-  char* str;
-  size_t size;
-  char has_3d;
+  int dims;
 
   self_data = RGEO_FACTORY_DATA_PTR(self);
-  has_3d = self_data->flags & RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M;
+  if (self_data->marshal_twkb) {
+    geom = rgeo_get_geos_geometry_safe(obj);
+    if (!geom) {
+      return Qnil;
+    }
+    result = rgeo_write_twkb(geom,
+                             self_data->flags,
+                             self_data->twkb_precision,
+                             self_data->twkb_precision < 0
+                               ? 0
+                               : self_data->twkb_precision);
+    RB_GC_GUARD(obj);
+    return result;
+  }
+  dims = RGEO_FACTORY_DIMS(self_data->flags);
 #ifndef RGEO_GEOS_SUPPORTS_SETOUTPUTDIMENSION
-  if (has_3d) {
+  if (dims > 2) {
     if (NIL_P(marshal_wkb_generator)) {
       marshal_wkb_generator =
         rb_funcall(rb_const_get_at(rgeo_geos_module, rb_intern("Utils")),
@@ -375,27 +1871,7 @@ method_factory_write_for_marshal(VALUE self, VALUE obj)
     return rb_funcall(marshal_wkb_generator, rb_intern("generate"), 1, obj);
   }
 #endif
-  wkb_writer = self_data->marshal_wkb_writer;
-  if (!wkb_writer) {
-    wkb_writer = GEOSWKBWriter_create();
-    GEOSWKBWriter_setOutputDimension(wkb_writer, 2);
-    if (has_3d) {
-      GEOSWKBWriter_setOutputDimension(wkb_writer, 3);
-    }
-    self_data->marshal_wkb_writer = wkb_writer;
-  }
-  result = Qnil;
-  if (wkb_writer) {
-    geom = rgeo_get_geos_geometry_safe(obj);
-    if (geom) {
-      str = (char*)GEOSWKBWriter_write(wkb_writer, geom, &size);
-      if (str) {
-        result = rb_str_new(str, size);
-        GEOSFree(str);
-      }
-    }
-  }
-  return result;
+  return rgeo_write_wkb(self, &self_data->marshal_wkb_writer, dims, 0, obj);
 }
 
 #ifndef RGEO_GEOS_SUPPORTS_SETOUTPUTDIMENSION
@@ -406,16 +1882,12 @@ static VALUE
 method_factory_write_for_psych(VALUE self, VALUE obj)
 {
   RGeo_FactoryData* self_data;
-  GEOSWKTWriter* wkt_writer;
-  const GEOSGeometry* geom;
-  VALUE result;
-  char* str;
-  char has_3d;
+  int dims;
 
   self_data = RGEO_FACTORY_DATA_PTR(self);
-  has_3d = self_data->flags & RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M;
+  dims = RGEO_FACTORY_DIMS(self_data->flags);
 #ifndef RGEO_GEOS_SUPPORTS_SETOUTPUTDIMENSION
-  if (has_3d) {
+  if (dims > 2) {
     if (NIL_P(psych_wkt_generator)) {
       psych_wkt_generator =
         rb_funcall(rb_const_get_at(rgeo_geos_module, rb_intern("Utils")),
@@ -425,28 +1897,7 @@ method_factory_write_for_psych(VALUE self, VALUE obj)
     return rb_funcall(psych_wkt_generator, rb_intern("generate"), 1, obj);
   }
 #endif
-  wkt_writer = self_data->psych_wkt_writer;
-  if (!wkt_writer) {
-    wkt_writer = GEOSWKTWriter_create();
-    GEOSWKTWriter_setOutputDimension(wkt_writer, 2);
-    GEOSWKTWriter_setTrim(wkt_writer, 1);
-    if (has_3d) {
-      GEOSWKTWriter_setOutputDimension(wkt_writer, 3);
-    }
-    self_data->psych_wkt_writer = wkt_writer;
-  }
-  result = Qnil;
-  if (wkt_writer) {
-    geom = rgeo_get_geos_geometry_safe(obj);
-    if (geom) {
-      str = GEOSWKTWriter_write(wkt_writer, geom);
-      if (str) {
-        result = rb_str_new2(str);
-        GEOSFree(str);
-      }
-    }
-  }
-  return result;
+  return rgeo_write_wkt(self, &self_data->psych_wkt_writer, dims, obj);
 }
 
 static VALUE
@@ -465,6 +1916,80 @@ cmethod_factory_supports_unary_union(VALUE klass)
 #endif
 }
 
+static VALUE
+cmethod_factory_supports_xyzm(VALUE klass)
+{
+#ifdef RGEO_GEOS_SUPPORTS_XYZM
+  return Qtrue;
+#else
+  return Qfalse;
+#endif
+}
+
+// Returns the RGEO_WKB_ options that make GEOS write what the given WKB
+// generator would, or 0 if it cannot. Only plain WKRep::WKBGenerator
+// instances are recognized. GEOS cannot write M coordinates, ISO type
+// codes before 3.10, or a zero SRID.
+
+static int
+wkb_generator_options(VALUE generator,
+                      int flags,
+                      int srid,
+                      int* output_dimension)
+{
+  VALUE generator_class;
+  ID type_format;
+  int options;
+  char has_z;
+
+  if (NIL_P(generator)) {
+    return 0;
+  }
+  generator_class = rb_const_get_at(
+    rb_const_get_at(rgeo_module, rb_intern("WKRep")),
+    rb_intern("WKBGenerator"));
+  if (rb_obj_class(generator) != generator_class) {
+    return 0;
+  }
+
+  options = RGEO_WKB_NATIVE;
+  type_format = SYM2ID(rb_funcall(generator, rb_intern("type_format"), 0));
+  has_z = (flags & RGEO_FACTORYFLAGS_SUPPORTS_Z) != 0;
+  if (type_format == rb_intern("wkb11")) {
+    has_z = 0;
+  } else if (type_format == rb_intern("ewkb") ||
+             type_format == rb_intern("wkb12")) {
+    if (flags & RGEO_FACTORYFLAGS_SUPPORTS_M) {
+      return 0;
+    }
+    if (type_format == rb_intern("wkb12") && has_z) {
+#ifdef RGEO_GEOS_SUPPORTS_WKB_FLAVOR
+      options |= RGEO_WKB_ISO;
+#else
+      return 0;
+#endif
+    }
+  } else {
+    return 0;
+  }
+  if (RTEST(rb_funcall(generator, rb_intern("emit_ewkb_srid?"), 0))) {
+    if (srid == 0) {
+      return 0;
+    }
+    options |= RGEO_WKB_INCLUDE_SRID;
+  }
+  if (RTEST(rb_funcall(generator, rb_intern("hex_format?"), 0))) {
+    options |= RGEO_WKB_HEX;
+  }
+  if (RTEST(rb_funcall(generator, rb_intern("little_endian?"), 0))) {
+    options |= RGEO_WKB_LITTLE_ENDIAN;
+  } else {
+    options |= RGEO_WKB_BIG_ENDIAN;
+  }
+  *output_dimension = has_z ? 3 : 2;
+  return options;
+}
+
 static VALUE
 cmethod_factory_create(VALUE klass,
                        VALUE flags,
@@ -476,8 +2001,15 @@ cmethod_factory_create(VALUE klass,
 {
   VALUE result;
   RGeo_FactoryData* data;
+  int wkb_options;
+  int wkb_output_dimension;
 
   result = Qnil;
+  wkb_output_dimension = 2;
+  wkb_options = wkb_generator_options(wkb_generator,
+                                      RB_NUM2INT(flags),
+                                      RB_NUM2INT(srid),
+                                      &wkb_output_dimension);
   data = ALLOC(RGeo_FactoryData);
   if (data) {
     data->flags = RB_NUM2INT(flags);
@@ -496,6 +2028,16 @@ cmethod_factory_create(VALUE klass,
     data->wkrep_wkt_parser = Qnil;
     data->wkrep_wkb_parser = Qnil;
     data->coord_sys_obj = coord_sys_obj;
+    memset(&data->prepare, 0, sizeof(RGeo_PreparePolicy));
+    data->prepare.after = 2;
+    data->has_hash = 0;
+    data->wkb_options = wkb_options;
+    data->wkb_output_dimension = wkb_output_dimension;
+    data->wkb_parser_options = 0;
+    data->wkt_parser_options = 0;
+    data->twkb_precision = RGEO_TWKB_DEFAULT_PRECISION;
+    data->marshal_twkb = 0;
+    data->output_cache = create_output_cache(data->flags);
     result = TypedData_Wrap_Struct(klass, &rgeo_factory_type, data);
   }
   return result;
@@ -511,48 +2053,55 @@ alloc_factory(VALUE klass)
 static VALUE
 method_factory_initialize_copy(VALUE self, VALUE orig)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   RGeo_FactoryData* self_data;
   RGeo_FactoryData* orig_data;
 
   // Clear out existing data
   self_data = RGEO_FACTORY_DATA_PTR(self);
   if (self_data->wkt_reader) {
-    GEOSWKTReader_destroy(self_data->wkt_reader);
+    GEOSWKTReader_destroy_r(context, self_data->wkt_reader);
     self_data->wkt_reader = NULL;
   }
   if (self_data->wkb_reader) {
-    GEOSWKBReader_destroy(self_data->wkb_reader);
+    GEOSWKBReader_destroy_r(context, self_data->wkb_reader);
     self_data->wkb_reader = NULL;
   }
   if (self_data->wkt_writer) {
-    GEOSWKTWriter_destroy(self_data->wkt_writer);
+    GEOSWKTWriter_destroy_r(context, self_data->wkt_writer);
     self_data->wkt_writer = NULL;
   }
   if (self_data->wkb_writer) {
-    GEOSWKBWriter_destroy(self_data->wkb_writer);
+    GEOSWKBWriter_destroy_r(context, self_data->wkb_writer);
     self_data->wkb_writer = NULL;
   }
   if (self_data->psych_wkt_reader) {
-    GEOSWKTReader_destroy(self_data->psych_wkt_reader);
+    GEOSWKTReader_destroy_r(context, self_data->psych_wkt_reader);
     self_data->psych_wkt_reader = NULL;
   }
   if (self_data->marshal_wkb_reader) {
-    GEOSWKBReader_destroy(self_data->marshal_wkb_reader);
+    GEOSWKBReader_destroy_r(context, self_data->marshal_wkb_reader);
     self_data->marshal_wkb_reader = NULL;
   }
   if (self_data->psych_wkt_writer) {
-    GEOSWKTWriter_destroy(self_data->psych_wkt_writer);
+    GEOSWKTWriter_destroy_r(context, self_data->psych_wkt_writer);
     self_data->psych_wkt_writer = NULL;
   }
   if (self_data->marshal_wkb_writer) {
-    GEOSWKBWriter_destroy(self_data->marshal_wkb_writer);
+    GEOSWKBWriter_destroy_r(context, self_data->marshal_wkb_writer);
     self_data->marshal_wkb_writer = NULL;
   }
   self_data->wkrep_wkt_generator = Qnil;
   self_data->wkrep_wkb_generator = Qnil;
   self_data->wkrep_wkt_parser = Qnil;
   self_data->wkrep_wkb_parser = Qnil;
+  self_data->wkb_parser_options = 0;
+  self_data->wkt_parser_options = 0;
   self_data->coord_sys_obj = Qnil;
+  self_data->has_hash = 0;
+  detach_prepared_geometries(&self_data->prepare);
+  release_output_cache(self_data->output_cache);
+  self_data->output_cache = NULL;
 
   // Copy new data from original object
   if (RGEO_FACTORY_TYPEDDATA_P(orig)) {
@@ -565,10 +2114,182 @@ method_factory_initialize_copy(VALUE self, VALUE orig)
     self_data->wkrep_wkt_parser = orig_data->wkrep_wkt_parser;
     self_data->wkrep_wkb_parser = orig_data->wkrep_wkb_parser;
     self_data->coord_sys_obj = orig_data->coord_sys_obj;
+    self_data->prepare.after = orig_data->prepare.after;
+    self_data->prepare.min_coordinates = orig_data->prepare.min_coordinates;
+    self_data->prepare.budget = orig_data->prepare.budget;
+    self_data->wkb_options = orig_data->wkb_options;
+    self_data->wkb_output_dimension = orig_data->wkb_output_dimension;
+    self_data->wkb_parser_options = orig_data->wkb_parser_options;
+    self_data->wkt_parser_options = orig_data->wkt_parser_options;
+    self_data->twkb_precision = orig_data->twkb_precision;
+    self_data->marshal_twkb = orig_data->marshal_twkb;
+    self_data->output_cache = create_output_cache(orig_data->flags);
   }
   return self;
 }
 
+static VALUE
+method_set_prepare_policy(VALUE self,
+                          VALUE after,
+                          VALUE min_coordinates,
+                          VALUE budget)
+{
+  RGeo_FactoryData* self_data;
+
+  self_data = RGEO_FACTORY_DATA_PTR(self);
+  if (NUM2UINT(after) < 1) {
+    rb_raise(rb_eArgError, "prepare_after must be at least 1");
+  }
+  self_data->prepare.after = NUM2UINT(after);
+  self_data->prepare.min_coordinates = NUM2UINT(min_coordinates);
+  self_data->prepare.budget = NUM2SIZET(budget);
+  return Qnil;
+}
+
+static VALUE
+method_set_marshal_format(VALUE self, VALUE format, VALUE twkb_precision)
+{
+  RGeo_FactoryData* self_data;
+  ID format_id;
+  int precision;
+
+  format_id = rb_sym2id(format);
+  if (format_id != rb_intern("wkb") && format_id != rb_intern("twkb")) {
+    rb_raise(rb_eArgError, "Unknown marshal format: %" PRIsVALUE, format);
+  }
+  precision = NUM2INT(twkb_precision);
+  if (precision < -8 || precision > 7) {
+    rb_raise(rb_eArgError, "TWKB precision must be between -8 and 7");
+  }
+  self_data = RGEO_FACTORY_DATA_PTR(self);
+  self_data->marshal_twkb = format_id == rb_intern("twkb");
+  self_data->twkb_precision = precision;
+  return Qnil;
+}
+
+static VALUE
+method_get_marshal_format(VALUE self)
+{
+  RGeo_FactoryData* self_data;
+
+  self_data = RGEO_FACTORY_DATA_PTR(self);
+  return rb_ary_new_from_args(
+    2,
+    ID2SYM(rb_intern(self_data->marshal_twkb ? "twkb" : "wkb")),
+    INT2NUM(self_data->twkb_precision));
+}
+
+static VALUE
+method_get_prepare_policy(VALUE self)
+{
+  RGeo_PreparePolicy* policy;
+
+  policy = &RGEO_FACTORY_DATA_PTR(self)->prepare;
+  return rb_ary_new_from_args(3,
+                              UINT2NUM(policy->after),
+                              UINT2NUM(policy->min_coordinates),
+                              SIZET2NUM(policy->budget));
+}
+
+static VALUE
+method_get_output_cache_stats(VALUE self)
+{
+  RGeo_OutputCache* cache;
+  VALUE result;
+
+  cache = RGEO_FACTORY_DATA_PTR(self)->output_cache;
+  if (!cache) {
+    return Qnil;
+  }
+  result = rb_hash_new();
+  rb_hash_aset(
+    result, ID2SYM(rb_intern("strings")), SIZET2NUM(cache->strings));
+  rb_hash_aset(result, ID2SYM(rb_intern("bytes")), SIZET2NUM(cache->bytes));
+  return result;
+}
+
+static VALUE
+method_get_prepare_stats(VALUE self)
+{
+  RGeo_PreparePolicy* policy;
+  VALUE result;
+
+  policy = &RGEO_FACTORY_DATA_PTR(self)->prepare;
+  result = rb_hash_new();
+  rb_hash_aset(result, ID2SYM(rb_intern("hits")), SIZET2NUM(policy->hits));
+  rb_hash_aset(
+    result, ID2SYM(rb_intern("misses")), SIZET2NUM(policy->misses));
+  rb_hash_aset(
+    result, ID2SYM(rb_intern("evictions")), SIZET2NUM(policy->evictions));
+  rb_hash_aset(
+    result, ID2SYM(rb_intern("prepared")), SIZET2NUM(policy->count));
+  rb_hash_aset(result, ID2SYM(rb_intern("bytes")), SIZET2NUM(policy->bytes));
+  return result;
+}
+
+// Returns the RGEO_WKB_ options of native parsing for the given WKB
+// parser, or 0 if only the parser itself can read for this factory.
+
+static int
+wkb_parser_options(VALUE parser, VALUE factory)
+{
+  VALUE parser_class;
+  int options;
+
+  if (NIL_P(parser)) {
+    return 0;
+  }
+  parser_class = rb_const_get_at(
+    rb_const_get_at(rgeo_module, rb_intern("WKRep")), rb_intern("WKBParser"));
+  if (rb_obj_class(parser) != parser_class ||
+      rb_funcall(parser, rb_intern("exact_factory"), 0) != factory) {
+    return 0;
+  }
+  options = RGEO_WKB_NATIVE;
+  if (RTEST(rb_funcall(parser, rb_intern("support_ewkb?"), 0))) {
+    options |= RGEO_WKB_EWKB;
+  }
+  if (RTEST(rb_funcall(parser, rb_intern("support_wkb12?"), 0))) {
+    options |= RGEO_WKB_ISO;
+  }
+  if (RTEST(rb_funcall(parser, rb_intern("ignore_extra_bytes?"), 0))) {
+    options |= RGEO_WKB_IGNORE_EXTRA_BYTES;
+  }
+  return options;
+}
+
+// Same as wkb_parser_options for WKT parsers. Strict SFS 1.1 parsing and
+// extra tokens are left to the parser.
+
+static int
+wkt_parser_options(VALUE parser, VALUE factory)
+{
+  VALUE parser_class;
+  int options;
+
+  if (NIL_P(parser)) {
+    return 0;
+  }
+  parser_class = rb_const_get_at(
+    rb_const_get_at(rgeo_module, rb_intern("WKRep")), rb_intern("WKTParser"));
+  if (rb_obj_class(parser) != parser_class ||
+      rb_funcall(parser, rb_intern("exact_factory"), 0) != factory ||
+      RTEST(rb_funcall(parser, rb_intern("strict_wkt11?"), 0)) ||
+      RTEST(rb_funcall(parser, rb_intern("ignore_extra_tokens?"), 0))) {
+    return 0;
+  }
+  options = RGEO_WKT_NATIVE;
+  if (RTEST(rb_funcall(parser, rb_intern("support_ewkt?"), 0))) {
+    options |= RGEO_WKT_EWKT;
+  }
+  // A Z tag is only accepted on factories with Z coordinates.
+  if (RTEST(rb_funcall(parser, rb_intern("support_wkt12?"), 0)) &&
+      (RGEO_FACTORY_DATA_PTR(factory)->flags & RGEO_FACTORYFLAGS_SUPPORTS_Z)) {
+    options |= RGEO_WKT_WKT12;
+  }
+  return options;
+}
+
 static VALUE
 method_set_wkrep_parsers(VALUE self, VALUE wkt_parser, VALUE wkb_parser)
 {
@@ -577,6 +2298,8 @@ method_set_wkrep_parsers(VALUE self, VALUE wkt_parser, VALUE wkb_parser)
   self_data = RGEO_FACTORY_DATA_PTR(self);
   self_data->wkrep_wkt_parser = wkt_parser;
   self_data->wkrep_wkb_parser = wkb_parser;
+  self_data->wkt_parser_options = wkt_parser_options(wkt_parser, self);
+  self_data->wkb_parser_options = wkb_parser_options(wkb_parser, self);
 
   return self;
 }
@@ -649,6 +2372,9 @@ rgeo_init_geos_factory()
   rb_define_const(geos_factory_class,
                   "FLAG_PREPARE_HEURISTIC",
                   INT2FIX(RGEO_FACTORYFLAGS_PREPARE_HEURISTIC));
+  rb_define_const(geos_factory_class,
+                  "FLAG_CACHE_OUTPUT",
+                  INT2FIX(RGEO_FACTORYFLAGS_CACHE_OUTPUT));
   // Add C methods to the factory.
   rb_define_method(
     geos_factory_class, "initialize_copy", method_factory_initialize_copy, 1);
@@ -656,6 +2382,22 @@ rgeo_init_geos_factory()
     geos_factory_class, "_parse_wkt_impl", method_factory_parse_wkt, 1);
   rb_define_method(
     geos_factory_class, "_parse_wkb_impl", method_factory_parse_wkb, 1);
+  rb_define_method(
+    geos_factory_class, "_read_records", method_factory_read_records, 3);
+  rb_define_method(
+    geos_factory_class, "_write_wkb", method_factory_write_wkb, 4);
+  rb_define_method(geos_factory_class,
+                   "_parse_wkt_native",
+                   method_factory_parse_wkt_native,
+                   1);
+  rb_define_method(geos_factory_class,
+                   "_parse_wkb_native",
+                   method_factory_parse_wkb_native,
+                   1);
+  rb_define_method(geos_factory_class,
+                   "_parse_wkb_lazy",
+                   method_factory_parse_wkb_lazy,
+                   1);
   rb_define_method(geos_factory_class, "_srid", method_factory_srid, 0);
   rb_define_method(geos_factory_class,
                    "_buffer_resolution",
@@ -676,6 +2418,22 @@ rgeo_init_geos_factory()
                    0);
   rb_define_method(
     geos_factory_class, "_set_wkrep_parsers", method_set_wkrep_parsers, 2);
+  rb_define_method(geos_factory_class,
+                   "_set_prepare_policy",
+                   method_set_prepare_policy,
+                   3);
+  rb_define_method(
+    geos_factory_class, "_prepare_policy", method_get_prepare_policy, 0);
+  rb_define_method(
+    geos_factory_class, "_set_marshal_format", method_set_marshal_format, 2);
+  rb_define_method(
+    geos_factory_class, "_marshal_format", method_get_marshal_format, 0);
+  rb_define_method(
+    geos_factory_class, "_prepare_stats", method_get_prepare_stats, 0);
+  rb_define_method(geos_factory_class,
+                   "_output_cache_stats",
+                   method_get_output_cache_stats,
+                   0);
   rb_define_method(geos_factory_class, "_coord_sys", method_get_coord_sys, 0);
   rb_define_method(
     geos_factory_class, "_wkt_generator", method_get_wkt_generator, 0);
@@ -701,6 +2459,10 @@ rgeo_init_geos_factory()
                             "_supports_unary_union?",
                             cmethod_factory_supports_unary_union,
                             0);
+  rb_define_module_function(geos_factory_class,
+                            "_supports_xyzm?",
+                            cmethod_factory_supports_xyzm,
+                            0);
 
   // Define allocation methods for global class types
   rb_define_alloc_func(rgeo_geos_geometry_class, alloc_geometry);
@@ -717,9 +2479,270 @@ rgeo_init_geos_factory()
 
 /**** OTHER PUBLIC FUNCTIONS ****/
 
+const GEOSPreparedGeometry*
+rgeo_request_prepared_geometry(RGeo_GeometryData* object_data, char force)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_FactoryData* factory_data;
+  RGeo_PreparePolicy* policy;
+  RGeo_GeometryData* victim;
+  const GEOSPreparedGeometry* prep;
+  GEOSGeometry* prep_geom;
+  int coordinates;
+
+  if (!object_data->geom || NIL_P(object_data->factory)) {
+    return NULL;
+  }
+  // Copies share the prepared geometry of their owner, under the policy
+  // of their own factory.
+  factory_data = RGEO_FACTORY_DATA_PTR(object_data->factory);
+  policy = &factory_data->prepare;
+  object_data = rgeo_prepared_geometry_holder(object_data);
+  if (object_data->prep) {
+    ++policy->hits;
+    if (policy->head != object_data) {
+      unlink_prepared_geometry(object_data);
+      link_prepared_geometry(policy, object_data);
+    }
+    return object_data->prep;
+  }
+
+  ++policy->misses;
+  if (object_data->prep_failed) {
+    return NULL;
+  }
+  coordinates = -1;
+  if (!force) {
+    if (!(factory_data->flags & RGEO_FACTORYFLAGS_PREPARE_HEURISTIC)) {
+      return NULL;
+    }
+    if (object_data->prep_requests < UINT_MAX) {
+      ++object_data->prep_requests;
+    }
+    if (object_data->prep_requests < policy->after) {
+      if (!policy->min_coordinates) {
+        return NULL;
+      }
+      coordinates = GEOSGetNumCoordinates_r(context, object_data->geom);
+      if (coordinates < 0 ||
+          (unsigned int)coordinates < policy->min_coordinates) {
+        return NULL;
+      }
+    }
+  }
+
+  // The GEOS geometry of a view belongs to its owner, which the GC may
+  // free first when both are collected together, so a view prepares a
+  // copy it owns.
+  prep_geom = NULL;
+  if (!NIL_P(object_data->parent)) {
+    prep_geom = GEOSGeom_clone_r(context, object_data->geom);
+    if (!prep_geom) {
+      object_data->prep_failed = 1;
+      return NULL;
+    }
+  }
+  prep = GEOSPrepare_r(context, prep_geom ? prep_geom : object_data->geom);
+  if (!prep) {
+    if (prep_geom) {
+      GEOSGeom_destroy_r(context, prep_geom);
+    }
+    object_data->prep_failed = 1;
+    return NULL;
+  }
+  if (coordinates < 0) {
+    coordinates = GEOSGetNumCoordinates_r(context, object_data->geom);
+  }
+  object_data->prep = prep;
+  object_data->prep_geom = prep_geom;
+  object_data->prep_size = RGEO_PREPARED_BASE_SIZE +
+                           (size_t)(coordinates < 0 ? 0 : coordinates) *
+                             RGEO_PREPARED_COORDINATE_SIZE;
+  if (prep_geom) {
+    object_data->prep_size += estimate_geometry_size(object_data);
+  }
+  rb_gc_adjust_memory_usage((ssize_t)object_data->prep_size);
+  link_prepared_geometry(policy, object_data);
+
+  // Release the least recently used geometries, but never the new one.
+  while (policy->budget && policy->bytes > policy->budget &&
+         policy->tail != object_data) {
+    victim = policy->tail;
+    rgeo_release_prepared_geometry(victim);
+    victim->prep_requests = 0;
+    ++policy->evictions;
+  }
+  return prep;
+}
+
+void
+rgeo_release_prepared_geometry(RGeo_GeometryData* object_data)
+{
+  GEOSContextHandle_t context;
+
+  if (object_data->prep) {
+    context = rgeo_geos_context();
+    unlink_prepared_geometry(object_data);
+    GEOSPreparedGeom_destroy_r(context, object_data->prep);
+    if (object_data->prep_geom) {
+      GEOSGeom_destroy_r(context, object_data->prep_geom);
+    }
+    rb_gc_adjust_memory_usage(-(ssize_t)object_data->prep_size);
+    object_data->prep = NULL;
+    object_data->prep_geom = NULL;
+    object_data->prep_size = 0;
+  }
+}
+
+RGeo_GeometryData*
+rgeo_prepared_geometry_holder(RGeo_GeometryData* object_data)
+{
+  RGeo_GeometryData* owner_data;
+
+  if (!NIL_P(object_data->parent) && object_data->geom) {
+    owner_data = RGEO_GEOMETRY_LAZY_DATA_PTR(object_data->parent);
+    if (owner_data->geom == object_data->geom) {
+      return owner_data;
+    }
+  }
+  return object_data;
+}
+
+char
+rgeo_geos_geometry_bounds(const GEOSGeometry* geom, double* bounds)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+
+  return geom && !GEOSisEmpty_r(context, geom) &&
+         GEOSGeom_getXMin_r(context, geom, &bounds[0]) &&
+         GEOSGeom_getYMin_r(context, geom, &bounds[1]) &&
+         GEOSGeom_getXMax_r(context, geom, &bounds[2]) &&
+         GEOSGeom_getYMax_r(context, geom, &bounds[3]);
+}
+
+const double*
+rgeo_geometry_bounds(RGeo_GeometryData* object_data)
+{
+  if (object_data->bounds_state == RGEO_BOUNDS_UNKNOWN) {
+    object_data->bounds_state =
+      rgeo_geos_geometry_bounds(object_data->geom, object_data->bounds)
+        ? RGEO_BOUNDS_KNOWN
+        : RGEO_BOUNDS_EMPTY;
+  }
+  return object_data->bounds_state == RGEO_BOUNDS_KNOWN ? object_data->bounds
+                                                        : NULL;
+}
+
+RGeo_GeometryData*
+rgeo_read_lazy_geometry(RGeo_GeometryData* object_data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSGeometry* geom;
+  VALUE factory;
+  VALUE wkb;
+
+  factory = object_data->factory;
+  wkb = object_data->wkb;
+  geom = read_wkb_geometry(&RGEO_FACTORY_DATA_PTR(factory)->wkb_reader,
+                           RSTRING_PTR(wkb),
+                           (size_t)RSTRING_LEN(wkb),
+                           object_data->wkb_hex);
+  RB_GC_GUARD(factory);
+  RB_GC_GUARD(wkb);
+  if (!geom) {
+    rb_raise(rb_eRGeoParseError, "Cannot read the WKB of a lazy geometry");
+  }
+  // Another thread may have read it while the GVL was released.
+  if (object_data->geom || object_data->wkb != wkb) {
+    GEOSGeom_destroy_r(context, geom);
+    return object_data;
+  }
+  GEOSSetSRID_r(context, geom, RGEO_FACTORY_DATA_PTR(factory)->srid);
+  object_data->geom = geom;
+  rgeo_track_geometry_memory(object_data);
+  return object_data;
+}
+
 VALUE
-rgeo_wrap_geos_geometry(VALUE factory, GEOSGeometry* geom, VALUE klass)
+rgeo_cache_geometry_output(RGeo_GeometryData* object_data,
+                           char binary,
+                           VALUE str)
 {
+  RGeo_OutputCache* cache;
+  VALUE* slot;
+
+  if (NIL_P(str) || NIL_P(object_data->factory)) {
+    return str;
+  }
+  cache = RGEO_FACTORY_DATA_PTR(object_data->factory)->output_cache;
+  if (!cache) {
+    return str;
+  }
+  // Another thread may have kept one while the GVL was released.
+  slot = binary ? &object_data->binary : &object_data->text;
+  if (!NIL_P(*slot)) {
+    return *slot;
+  }
+  StringValue(str);
+  if (!binary && !OBJ_FROZEN(str)) {
+    rb_enc_associate_index(str, rb_usascii_encindex());
+  }
+  rb_obj_freeze(str);
+  if (!object_data->output_cache) {
+    object_data->output_cache = cache;
+    ++cache->refs;
+  }
+  *slot = str;
+  object_data->output_size += (size_t)RSTRING_LEN(str);
+  cache->bytes += (size_t)RSTRING_LEN(str);
+  ++cache->strings;
+  return str;
+}
+
+void
+rgeo_release_geometry_output(RGeo_GeometryData* object_data)
+{
+  RGeo_OutputCache* cache;
+
+  cache = object_data->output_cache;
+  if (!cache) {
+    return;
+  }
+  // The strings may be freed already during GC, so they are not read.
+  cache->strings -= (size_t)!NIL_P(object_data->text) +
+                    (size_t)!NIL_P(object_data->binary);
+  cache->bytes -= object_data->output_size;
+  release_output_cache(cache);
+  object_data->text = Qnil;
+  object_data->binary = Qnil;
+  object_data->output_size = 0;
+  object_data->output_cache = NULL;
+}
+
+void
+rgeo_track_geometry_memory(RGeo_GeometryData* object_data)
+{
+  object_data->geom_size = 0;
+  if (!object_data->geom || !NIL_P(object_data->parent)) {
+    return;
+  }
+  object_data->geom_size = estimate_geometry_size(object_data);
+  rb_gc_adjust_memory_usage((ssize_t)object_data->geom_size);
+}
+
+void
+rgeo_untrack_geometry_memory(RGeo_GeometryData* object_data)
+{
+  if (object_data->geom_size) {
+    rb_gc_adjust_memory_usage(-(ssize_t)object_data->geom_size);
+    object_data->geom_size = 0;
+  }
+}
+
+static VALUE
+wrap_geos_geometry(VALUE factory, GEOSGeometry* geom, VALUE klass, VALUE parent)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_FactoryData* factory_data;
   VALUE klasses;
@@ -734,10 +2757,11 @@ rgeo_wrap_geos_geometry(VALUE factory, GEOSGeometry* geom, VALUE klass)
     // We don't allow "empty" points, so replace such objects with
     // an empty collection.
     if (geom && factory) {
-      if (GEOSGeomTypeId(geom) == GEOS_POINT &&
-          GEOSGetNumCoordinates(geom) == 0) {
-        GEOSGeom_destroy(geom);
-        geom = GEOSGeom_createCollection(GEOS_GEOMETRYCOLLECTION, NULL, 0);
+      if (GEOSGeomTypeId_r(context, geom) == GEOS_POINT &&
+          GEOSGetNumCoordinates_r(context, geom) == 0) {
+        GEOSGeom_destroy_r(context, geom);
+        geom = GEOSGeom_createCollection_r(
+          context, GEOS_GEOMETRYCOLLECTION, NULL, 0);
         klass = rgeo_geos_geometry_collection_class;
       }
     }
@@ -746,7 +2770,7 @@ rgeo_wrap_geos_geometry(VALUE factory, GEOSGeometry* geom, VALUE klass)
     if (TYPE(klass) != T_CLASS) {
       inferred_klass = Qnil;
       is_collection = 0;
-      switch (GEOSGeomTypeId(geom)) {
+      switch (GEOSGeomTypeId_r(context, geom)) {
         case GEOS_POINT:
           inferred_klass = rgeo_geos_point_class;
           break;
@@ -787,33 +2811,57 @@ rgeo_wrap_geos_geometry(VALUE factory, GEOSGeometry* geom, VALUE klass)
     data = ALLOC(RGeo_GeometryData);
     if (data) {
       if (geom) {
-        GEOSSetSRID(geom, factory_data->srid);
+        GEOSSetSRID_r(context, geom, factory_data->srid);
       }
       data->geom = geom;
-      data->prep =
-        factory_data &&
-            ((factory_data->flags & RGEO_FACTORYFLAGS_PREPARE_HEURISTIC) != 0)
-          ? (GEOSPreparedGeometry*)1
-          : NULL;
+      data->prep = NULL;
+      data->prep_geom = NULL;
       data->factory = factory;
       data->klasses = klasses;
+      data->parent = parent;
+      data->retired = Qnil;
+      data->has_views = 0;
+      data->bounds_state = RGEO_BOUNDS_UNKNOWN;
+      data->has_hash = 0;
+      data->prep_failed = 0;
+      data->prep_requests = 0;
+      data->geom_size = 0;
+      data->prep_size = 0;
+      data->prep_policy = NULL;
+      data->prep_prev = NULL;
+      data->prep_next = NULL;
+      data->wkb = Qnil;
+      data->wkb_hex = 0;
+      data->wkb_format = -1;
+      data->text = Qnil;
+      data->binary = Qnil;
+      data->output_size = 0;
+      data->output_cache = NULL;
       result = TypedData_Wrap_Struct(klass, &rgeo_geometry_type, data);
+      rgeo_track_geometry_memory(data);
     }
   }
   return result;
 }
 
+VALUE
+rgeo_wrap_geos_geometry(VALUE factory, GEOSGeometry* geom, VALUE klass)
+{
+  return wrap_geos_geometry(factory, geom, klass, Qnil);
+}
+
 VALUE
 rgeo_wrap_geos_geometry_clone(VALUE factory,
                               const GEOSGeometry* geom,
                               VALUE klass)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   GEOSGeometry* clone_geom;
 
   result = Qnil;
   if (geom) {
-    clone_geom = GEOSGeom_clone(geom);
+    clone_geom = GEOSGeom_clone_r(context, geom);
     if (clone_geom) {
       result = rgeo_wrap_geos_geometry(factory, clone_geom, klass);
     }
@@ -821,8 +2869,80 @@ rgeo_wrap_geos_geometry_clone(VALUE factory,
   return result;
 }
 
-const GEOSGeometry*
-rgeo_convert_to_geos_geometry(VALUE factory, VALUE obj, VALUE type, int* state)
+VALUE
+rgeo_wrap_geos_geometry_view(VALUE parent,
+                             const GEOSGeometry* geom,
+                             VALUE klass)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_GeometryData* parent_data;
+  VALUE owner;
+  VALUE result;
+
+  if (!geom) {
+    return Qnil;
+  }
+  parent_data = RGEO_GEOMETRY_DATA_PTR(parent);
+  // Empty points are replaced with collections, which needs a copy.
+  if (GEOSGeomTypeId_r(context, geom) == GEOS_POINT &&
+      GEOSisEmpty_r(context, geom)) {
+    return rgeo_wrap_geos_geometry_clone(parent_data->factory, geom, klass);
+  }
+  owner = NIL_P(parent_data->parent) ? parent : parent_data->parent;
+  result = wrap_geos_geometry(
+    parent_data->factory, (GEOSGeometry*)geom, klass, owner);
+  if (!NIL_P(result)) {
+    RGEO_GEOMETRY_DATA_PTR(owner)->has_views = 1;
+  }
+  return result;
+}
+
+void
+rgeo_retire_geometry(RGeo_GeometryData* object_data)
+{
+  VALUE holder;
+  RGeo_GeometryData* holder_data;
+
+  rgeo_release_prepared_geometry(object_data);
+  if (!object_data->has_views) {
+    return;
+  }
+  // Only owners have views, so geom is not shared with a parent here.
+  if (object_data->geom && NIL_P(object_data->parent)) {
+    holder = alloc_geometry(rgeo_geos_geometry_class);
+    holder_data = RGEO_GEOMETRY_LAZY_DATA_PTR(holder);
+    holder_data->geom = object_data->geom;
+    holder_data->geom_size = object_data->geom_size;
+    holder_data->retired = object_data->retired;
+    object_data->geom = NULL;
+    object_data->geom_size = 0;
+    object_data->retired = holder;
+  }
+  object_data->has_views = 0;
+}
+
+VALUE
+rgeo_wrap_geos_geometry_nogvl(VALUE factory,
+                              void* (*func)(void*),
+                              void* data,
+                              VALUE klass)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSGeometry* geom;
+  int state = 0;
+
+  geom = (GEOSGeometry*)rgeo_without_gvl(func, data, &state);
+  if (state) {
+    if (geom) {
+      GEOSGeom_destroy_r(context, geom);
+    }
+    rb_jump_tag(state);
+  }
+  return rgeo_wrap_geos_geometry(factory, geom, klass);
+}
+
+VALUE
+rgeo_convert_to_geos_object(VALUE factory, VALUE obj, VALUE type, int* state)
 {
   VALUE object;
 
@@ -842,7 +2962,7 @@ rgeo_convert_to_geos_geometry(VALUE factory, VALUE obj, VALUE type, int* state)
   }
 
   if (*state) {
-    return NULL;
+    return Qnil;
   }
 
   if (!rgeo_is_geos_object(object)) {
@@ -852,9 +2972,21 @@ rgeo_convert_to_geos_geometry(VALUE factory, VALUE obj, VALUE type, int* state)
   }
 
   if (*state) {
-    return NULL;
+    return Qnil;
   }
 
+  return object;
+}
+
+const GEOSGeometry*
+rgeo_convert_to_geos_geometry(VALUE factory, VALUE obj, VALUE type, int* state)
+{
+  VALUE object;
+
+  object = rgeo_convert_to_geos_object(factory, obj, type, state);
+  if (*state) {
+    return NULL;
+  }
   return RGEO_GEOMETRY_DATA_PTR(object)->geom;
 }
 
@@ -865,10 +2997,10 @@ rgeo_convert_to_detached_geos_geometry(VALUE obj,
                                        VALUE* klasses,
                                        int* state)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE object;
   GEOSGeometry* geom;
   RGeo_GeometryData* object_data;
-  const GEOSPreparedGeometry* prep;
 
   if (klasses) {
     *klasses = Qnil;
@@ -912,15 +3044,21 @@ rgeo_convert_to_detached_geos_geometry(VALUE obj,
       *klasses = CLASS_OF(object);
     }
   }
-  prep = object_data->prep;
-  if (prep && prep != (GEOSPreparedGeometry*)1 &&
-      prep != (GEOSPreparedGeometry*)2) {
-    GEOSPreparedGeom_destroy(prep);
+  if (!NIL_P(object_data->parent) || object_data->has_views) {
+    // The GEOS geometry is shared with views, so it stays with its owner.
+    return GEOSGeom_clone_r(context, geom);
   }
+  rgeo_release_prepared_geometry(object_data);
+  rgeo_untrack_geometry_memory(object_data);
+  rgeo_release_geometry_output(object_data);
   object_data->geom = NULL;
-  object_data->prep = NULL;
+  object_data->bounds_state = RGEO_BOUNDS_UNKNOWN;
+  object_data->has_hash = 0;
   object_data->factory = Qnil;
   object_data->klasses = Qnil;
+  object_data->wkb = Qnil;
+  object_data->wkb_hex = 0;
+  object_data->wkb_format = -1;
 
   return geom;
 }
@@ -952,6 +3090,7 @@ rgeo_geos_coordseqs_eql(const GEOSGeometry* geom1,
                         const GEOSGeometry* geom2,
                         char check_z)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   const GEOSCoordSequence* cs1;
   const GEOSCoordSequence* cs2;
@@ -962,30 +3101,30 @@ rgeo_geos_coordseqs_eql(const GEOSGeometry* geom1,
 
   result = Qnil;
   if (geom1 && geom2) {
-    cs1 = GEOSGeom_getCoordSeq(geom1);
-    cs2 = GEOSGeom_getCoordSeq(geom2);
+    cs1 = GEOSGeom_getCoordSeq_r(context, geom1);
+    cs2 = GEOSGeom_getCoordSeq_r(context, geom2);
     if (cs1 && cs2) {
       len1 = 0;
       len2 = 0;
-      if (GEOSCoordSeq_getSize(cs1, &len1) &&
-          GEOSCoordSeq_getSize(cs2, &len2)) {
+      if (GEOSCoordSeq_getSize_r(context, cs1, &len1) &&
+          GEOSCoordSeq_getSize_r(context, cs2, &len2)) {
         if (len1 == len2) {
           result = Qtrue;
           for (i = 0; i < len1; ++i) {
-            if (GEOSCoordSeq_getX(cs1, i, &val1) &&
-                GEOSCoordSeq_getX(cs2, i, &val2)) {
+            if (GEOSCoordSeq_getX_r(context, cs1, i, &val1) &&
+                GEOSCoordSeq_getX_r(context, cs2, i, &val2)) {
               if (val1 == val2) {
-                if (GEOSCoordSeq_getY(cs1, i, &val1) &&
-                    GEOSCoordSeq_getY(cs2, i, &val2)) {
+                if (GEOSCoordSeq_getY_r(context, cs1, i, &val1) &&
+                    GEOSCoordSeq_getY_r(context, cs2, i, &val2)) {
                   if (val1 == val2) {
                     if (check_z) {
                       val1 = 0;
-                      if (!GEOSCoordSeq_getZ(cs1, i, &val1)) {
+                      if (!GEOSCoordSeq_getZ_r(context, cs1, i, &val1)) {
                         result = Qnil;
                         break;
                       }
                       val2 = 0;
-                      if (!GEOSCoordSeq_getZ(cs2, i, &val2)) {
+                      if (!GEOSCoordSeq_getZ_r(context, cs2, i, &val2)) {
                         result = Qnil;
                         break;
                       }
@@ -1038,41 +3177,78 @@ rgeo_geos_klasses_and_factories_eql(VALUE obj1, VALUE obj2)
   return result;
 }
 
-typedef struct
-{
-  st_index_t seed_hash;
-  double x;
-  double y;
-  double z;
-} RGeo_Coordseq_Hash_Struct;
+// Sequences up to this size are hashed from a buffer on the stack.
+#define RGEO_HASH_STACK_COORDINATES 32
 
 st_index_t
 rgeo_geos_coordseq_hash(const GEOSGeometry* geom, st_index_t hash)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   const GEOSCoordSequence* cs;
   unsigned int len;
+  double stack_buffer[RGEO_HASH_STACK_COORDINATES * 3];
+  double* buffer;
+  VALUE buffer_holder;
+#ifndef RGEO_GEOS_SUPPORTS_COORDSEQ_BUFFER
   unsigned int i;
-  RGeo_Coordseq_Hash_Struct hash_struct;
+#endif
 
-  if (geom) {
-    cs = GEOSGeom_getCoordSeq(geom);
-    if (cs) {
-      if (GEOSCoordSeq_getSize(cs, &len)) {
-        for (i = 0; i < len; ++i) {
-          if (GEOSCoordSeq_getX(cs, i, &hash_struct.x)) {
-            if (GEOSCoordSeq_getY(cs, i, &hash_struct.y)) {
-              if (!GEOSCoordSeq_getZ(cs, i, &hash_struct.z)) {
-                hash_struct.z = 0;
-              }
-              hash_struct.seed_hash = hash;
-              hash =
-                rb_memhash(&hash_struct, sizeof(RGeo_Coordseq_Hash_Struct));
-            }
-          }
-        }
-      }
+  if (!geom) {
+    return hash;
+  }
+  cs = GEOSGeom_getCoordSeq_r(context, geom);
+  if (!cs || !GEOSCoordSeq_getSize_r(context, cs, &len) || len == 0) {
+    return hash;
+  }
+
+  // The coordinates are copied as x, y, z triples (z is NaN when the
+  // sequence has none) and hashed in one call.
+  buffer_holder = 0;
+  buffer = len <= RGEO_HASH_STACK_COORDINATES
+             ? stack_buffer
+             : ALLOCV_N(double, buffer_holder, (size_t)len * 3);
+#ifdef RGEO_GEOS_SUPPORTS_COORDSEQ_BUFFER
+  GEOSCoordSeq_copyToBuffer_r(context, cs, buffer, 1, 0);
+#else
+  for (i = 0; i < len; ++i) {
+    GEOSCoordSeq_getX_r(context, cs, i, &buffer[i * 3]);
+    GEOSCoordSeq_getY_r(context, cs, i, &buffer[i * 3 + 1]);
+    if (!GEOSCoordSeq_getZ_r(context, cs, i, &buffer[i * 3 + 2])) {
+      buffer[i * 3 + 2] = 0;
+    }
+  }
+#endif
+  hash =
+    rb_hash_uint(hash, rb_memhash(buffer, (size_t)len * 3 * sizeof(double)));
+  if (buffer_holder) {
+    ALLOCV_END(buffer_holder);
+  }
+  return hash;
+}
+
+// The hashes of the feature type modules are kept here after their first
+// use. Those modules are pinned by rgeo_init_geos_globals.
+#define RGEO_HASHED_MODULES 16
+
+static VALUE hashed_modules[RGEO_HASHED_MODULES];
+static st_index_t module_hashes[RGEO_HASHED_MODULES];
+
+static st_index_t
+module_hash(VALUE type_module)
+{
+  int i;
+  st_index_t hash;
+
+  for (i = 0; i < RGEO_HASHED_MODULES && hashed_modules[i]; ++i) {
+    if (hashed_modules[i] == type_module) {
+      return module_hashes[i];
     }
   }
+  hash = FIX2LONG(rb_funcall(type_module, rb_intern("hash"), 0));
+  if (i < RGEO_HASHED_MODULES) {
+    hashed_modules[i] = type_module;
+    module_hashes[i] = hash;
+  }
   return hash;
 }
 
@@ -1086,16 +3262,44 @@ typedef struct
 st_index_t
 rgeo_geos_objbase_hash(VALUE factory, VALUE type_module, st_index_t hash)
 {
-  ID hash_method;
+  RGeo_FactoryData* factory_data;
   RGeo_Objbase_Hash_Struct hash_struct;
 
-  hash_method = rb_intern("hash");
   hash_struct.seed_hash = hash;
-  hash_struct.h1 = FIX2LONG(rb_funcall(factory, hash_method, 0));
-  hash_struct.h2 = FIX2LONG(rb_funcall(type_module, hash_method, 0));
+  if (RGEO_FACTORY_TYPEDDATA_P(factory)) {
+    factory_data = RGEO_FACTORY_DATA_PTR(factory);
+    if (!factory_data->has_hash) {
+      factory_data->hash =
+        FIX2LONG(rb_funcall(factory, rb_intern("hash"), 0));
+      factory_data->has_hash = 1;
+    }
+    hash_struct.h1 = factory_data->hash;
+  } else {
+    hash_struct.h1 = FIX2LONG(rb_funcall(factory, rb_intern("hash"), 0));
+  }
+  hash_struct.h2 = module_hash(type_module);
   return rb_memhash(&hash_struct, sizeof(RGeo_Objbase_Hash_Struct));
 }
 
+VALUE
+rgeo_geometry_hash(VALUE self,
+                   VALUE type_module,
+                   st_index_t (*geom_hash)(const GEOSGeometry*, st_index_t))
+{
+  RGeo_GeometryData* self_data;
+  st_index_t hash;
+
+  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  if (!self_data->has_hash) {
+    hash = rb_hash_start(0);
+    hash = rgeo_geos_objbase_hash(self_data->factory, type_module, hash);
+    hash = geom_hash(self_data->geom, hash);
+    self_data->hash = rb_hash_end(hash);
+    self_data->has_hash = 1;
+  }
+  return LONG2FIX(self_data->hash);
+}
+
 RGEO_END_C
 
 #endif
@@ -10,11 +10,57 @@
 
 RGEO_BEGIN_C
 
+typedef struct RGeo_GeometryData RGeo_GeometryData;
+
+/*
+  Preparation policy of a factory, and the state shared by its prepared
+  geometries. A geometry is automatically prepared on its after-th
+  predicate call, or on the first one if it has at least min_coordinates
+  coordinates (when not 0). Prepared geometries form a list from the most
+  to the least recently used, and the least recently used ones are
+  released once the estimated size of all prepared geometries exceeds
+  budget bytes (when not 0).
+*/
+typedef struct
+{
+  unsigned int after;
+  unsigned int min_coordinates;
+  size_t budget;
+  size_t bytes;
+  size_t count;
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+  RGeo_GeometryData* head;
+  RGeo_GeometryData* tail;
+} RGeo_PreparePolicy;
+
+/*
+  Counts the as_text and as_binary strings kept by the geometries of a
+  factory that caches them, and their bytes. It is shared by the factory
+  and those geometries, and freed by the last of them to be freed, since
+  the factory may be freed first in a GC run.
+*/
+typedef struct
+{
+  size_t strings;
+  size_t bytes;
+  size_t refs;
+} RGeo_OutputCache;
+
 /*
   Wrapped structure for Factory objects.
   A factory encapsulates GEOS serializer settings.
   It also stores the SRID for all geometries created by this factory,
   and the resolution for buffers created for this factory's geometries.
+  hash memoizes the ruby hash of the factory once has_hash is set.
+  wkb_options and wkb_output_dimension configure wkb_writer so that it
+  matches wkrep_wkb_generator, when RGEO_WKB_NATIVE is set.
+  wkb_parser_options and wkt_parser_options tell which inputs of
+  wkrep_wkb_parser and wkrep_wkt_parser GEOS can read by itself.
+  Geometries are marshaled as TWKB rounded to twkb_precision decimal
+  digits when marshal_twkb is set, and as WKB otherwise.
+  output_cache is set when the RGEO_FACTORYFLAGS_CACHE_OUTPUT flag is.
 */
 typedef struct
 {
@@ -31,6 +77,16 @@ typedef struct
   GEOSWKTWriter* psych_wkt_writer;
   GEOSWKBWriter* marshal_wkb_writer;
   VALUE coord_sys_obj;
+  RGeo_PreparePolicy prepare;
+  st_index_t hash;
+  char has_hash;
+  int wkb_options;
+  int wkb_output_dimension;
+  int wkb_parser_options;
+  int wkt_parser_options;
+  int twkb_precision;
+  char marshal_twkb;
+  RGeo_OutputCache* output_cache;
   int flags;
   int srid;
   int buffer_resolution;
@@ -46,6 +102,39 @@ typedef struct
 #define RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M                                      \
   (RGEO_FACTORYFLAGS_SUPPORTS_Z | RGEO_FACTORYFLAGS_SUPPORTS_M)
 #define RGEO_FACTORYFLAGS_PREPARE_HEURISTIC 0b1000
+#define RGEO_FACTORYFLAGS_CACHE_OUTPUT 0b10000
+
+/*
+  Number of ordinates in the coordinate sequences of a factory with the
+  given flags: 2, 3 with Z or M (M values are stored as Z), or 4 with
+  both, which needs the XYZM sequences of GEOS 3.12.
+*/
+#define RGEO_FACTORY_DIMS(flags)                                               \
+  (((flags) & RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M) ==                            \
+       RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M                                       \
+     ? 4                                                                       \
+     : ((flags) & RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M) ? 3 : 2)
+
+/*
+  Options of GEOS WKB writers, see rgeo_write_wkb. Without a byte order
+  the native one is used.
+*/
+#define RGEO_WKB_BIG_ENDIAN 0x01
+#define RGEO_WKB_LITTLE_ENDIAN 0x02
+#define RGEO_WKB_INCLUDE_SRID 0x04
+#define RGEO_WKB_ISO 0x08
+#define RGEO_WKB_HEX 0x10
+#define RGEO_WKB_NATIVE 0x20
+
+/*
+  Options of native WKB and WKT parsing. RGEO_WKB_ISO also stands for
+  the SFS 1.2 type codes accepted by WKRep::WKBParser.
+*/
+#define RGEO_WKB_EWKB 0x40
+#define RGEO_WKB_IGNORE_EXTRA_BYTES 0x80
+#define RGEO_WKT_NATIVE 0x01
+#define RGEO_WKT_EWKT 0x02
+#define RGEO_WKT_WKT12 0x04
 
 /* call-seq:
  *   RGeo::Geos::CAPIFactory.supports_z? -> true or false
@@ -84,14 +173,74 @@ method_factory_prepare_heuristic_p(VALUE self);
   in Line objects, which have no GEOS type). Any array element, or the
   array itself, could be Qnil, indicating fall back to the default
   inferred from the GEOS type.
+
+  A geometry whose parent is not Qnil is a view: its GEOS geometry is a
+  part of the GEOS geometry of parent, which owns it and is kept alive by
+  the view. has_views is set on geometries that lent parts to views.
+  Copies made with dup or clone are views of the whole GEOS geometry, so
+  it is only copied when one of them is replaced. A replaced geometry
+  with views keeps its former GEOS geometry alive in retired, a chain of
+  hidden geometries that own it.
+
+  bounds caches min x, min y, max x and max y of the geometry once
+  bounds_state is RGEO_BOUNDS_KNOWN, and hash caches its ruby hash once
+  has_hash is set. Both are reset when geom changes.
+
+  geom_size is the estimated size of the GEOS geometry, reported to the
+  Ruby GC while the geometry is owned (it is 0 for views). prep_size is
+  the estimated size of the prepared geometry and of prep_geom.
+
+  prep is the prepared geometry, or NULL. Views, which do not own geom,
+  prepare a copy of it kept in prep_geom until prep is released, since
+  their owner may be freed first. The prep_ fields track the predicate
+  calls of the geometry and, while it is prepared, its place in the list
+  of prepared geometries of the policy it is linked to. That link is
+  cleared if the factory is freed first.
+
+  wkb is the frozen WKB string a lazy geometry was parsed from, or Qnil.
+  geom stays NULL until the geometry is first used, see
+  RGEO_GEOMETRY_DATA_PTR, and wkb is kept afterwards so that as_binary
+  can return it. wkb_hex is set if the string is hex, and wkb_format
+  holds the RGEO_WKB_ options the string was written with, or -1 if no
+  writer would produce it.
+
+  text and binary keep the frozen as_text and as_binary strings when the
+  factory caches them, or Qnil. They are counted in output_cache, with
+  output_size bytes, while any is set.
 */
-typedef struct
+struct RGeo_GeometryData
 {
   GEOSGeometry* geom;
   const GEOSPreparedGeometry* prep;
+  GEOSGeometry* prep_geom;
   VALUE factory;
   VALUE klasses;
-} RGeo_GeometryData;
+  VALUE parent;
+  VALUE retired;
+  char has_views;
+  char bounds_state;
+  char has_hash;
+  double bounds[4];
+  st_index_t hash;
+  char prep_failed;
+  unsigned int prep_requests;
+  size_t geom_size;
+  size_t prep_size;
+  RGeo_PreparePolicy* prep_policy;
+  RGeo_GeometryData* prep_prev;
+  RGeo_GeometryData* prep_next;
+  VALUE wkb;
+  char wkb_hex;
+  int wkb_format;
+  VALUE text;
+  VALUE binary;
+  size_t output_size;
+  RGeo_OutputCache* output_cache;
+};
+
+#define RGEO_BOUNDS_UNKNOWN 0
+#define RGEO_BOUNDS_KNOWN 1
+#define RGEO_BOUNDS_EMPTY 2
 
 // Data types which indicate how RGeo types should be managed by Ruby.
 extern const rb_data_type_t rgeo_factory_type;
@@ -112,10 +261,36 @@ extern const rb_data_type_t rgeo_geometry_type;
 #define RGEO_FACTORY_DATA_PTR(factory)                                         \
   ((RGeo_FactoryData*)RTYPEDDATA_DATA(factory))
 
-// Returns the RGeo_GeometryData* given a ruby Geometry object
+// Returns the RGeo_GeometryData* given a ruby Geometry object, reading
+// the WKB of a lazy geometry first so that geom is set
 #define RGEO_GEOMETRY_DATA_PTR(geometry)                                       \
+  (rgeo_geometry_data(RGEO_GEOMETRY_LAZY_DATA_PTR(geometry)))
+
+// Same as RGEO_GEOMETRY_DATA_PTR, except that geom is still NULL for a
+// lazy geometry that was not used yet
+#define RGEO_GEOMETRY_LAZY_DATA_PTR(geometry)                                  \
   ((RGeo_GeometryData*)RTYPEDDATA_DATA(geometry))
 
+// Tells whether the geometry data holds a geometry, read or not
+#define RGEO_GEOMETRY_INITIALIZED_P(data)                                      \
+  ((data)->geom || !NIL_P((data)->wkb))
+
+/*
+  Reads the WKB of a lazy geometry into its GEOS geometry. Raises
+  RGeo::Error::ParseError if GEOS cannot read it. Returns object_data.
+*/
+RGeo_GeometryData*
+rgeo_read_lazy_geometry(RGeo_GeometryData* object_data);
+
+static inline RGeo_GeometryData*
+rgeo_geometry_data(RGeo_GeometryData* object_data)
+{
+  if (!object_data->geom && !NIL_P(object_data->wkb)) {
+    return rgeo_read_lazy_geometry(object_data);
+  }
+  return object_data;
+}
+
 /*
   Initializes the factory module. This should be called first in the
   initialization process.
@@ -147,6 +322,126 @@ rgeo_wrap_geos_geometry_clone(VALUE factory,
                               const GEOSGeometry* geom,
                               VALUE klass);
 
+/*
+  Returns the prepared geometry for the given geometry data. If it is not
+  prepared yet, it is prepared if force is set or if the preparation
+  policy of its factory allows it. Updates the statistics of the policy,
+  and may release the least recently used prepared geometries of the
+  factory. Returns NULL if the geometry is not prepared.
+*/
+const GEOSPreparedGeometry*
+rgeo_request_prepared_geometry(RGeo_GeometryData* object_data, char force);
+
+/*
+  Destroys the prepared geometry of the given geometry data, if any.
+*/
+void
+rgeo_release_prepared_geometry(RGeo_GeometryData* object_data);
+
+/*
+  Returns the geometry data that holds the prepared geometry of the given
+  one: the data of its owner if it is a view of the whole GEOS geometry
+  of the owner, as copies are, or the given data otherwise.
+*/
+RGeo_GeometryData*
+rgeo_prepared_geometry_holder(RGeo_GeometryData* object_data);
+
+/*
+  Stores the bounds (min x, min y, max x, max y) of the given GEOS
+  geometry in bounds. Returns 0 if the geometry is NULL or empty.
+*/
+char
+rgeo_geos_geometry_bounds(const GEOSGeometry* geom, double* bounds);
+
+/*
+  Returns the bounds (min x, min y, max x, max y) of the given geometry
+  data, computing and caching them on first use. Returns NULL if the
+  geometry is empty or uninitialized.
+*/
+const double*
+rgeo_geometry_bounds(RGeo_GeometryData* object_data);
+
+/*
+  Estimates the size of the GEOS geometry owned by the given geometry
+  data and reports it to the Ruby GC. Does nothing for views.
+*/
+void
+rgeo_track_geometry_memory(RGeo_GeometryData* object_data);
+
+/*
+  Withdraws the size reported by rgeo_track_geometry_memory. Call it
+  before the GEOS geometry is destroyed or handed over.
+*/
+void
+rgeo_untrack_geometry_memory(RGeo_GeometryData* object_data);
+
+/*
+  Returns a copy of the WKB a lazy geometry was parsed from, sharing its
+  bytes, if that is what as_binary would return for the geometry.
+  Returns Qnil otherwise.
+*/
+VALUE
+rgeo_lazy_wkb_as_binary(const RGeo_GeometryData* object_data);
+
+/*
+  Returns str. If the factory of the geometry caches serializations, str
+  is frozen and kept as the as_binary string of the geometry if binary
+  is set, or as its as_text string otherwise. If the geometry already
+  keeps one, that one is returned instead.
+*/
+VALUE
+rgeo_cache_geometry_output(RGeo_GeometryData* object_data,
+                           char binary,
+                           VALUE str);
+
+/*
+  Drops the as_text and as_binary strings kept by the geometry. Call it
+  whenever the geometry or its factory changes.
+*/
+void
+rgeo_release_geometry_output(RGeo_GeometryData* object_data);
+
+/*
+  Wraps a part of the GEOS geometry of the given ruby Geometry object, as
+  returned by GEOSGetGeometryN, GEOSGetExteriorRing or
+  GEOSGetInteriorRingN, in a read-only view instead of a clone. The view
+  uses the factory of parent, and keeps the GEOS geometry owner alive.
+*/
+VALUE
+rgeo_wrap_geos_geometry_view(VALUE parent,
+                             const GEOSGeometry* geom,
+                             VALUE klass);
+
+/*
+  Called before the GEOS geometry of the given geometry data is replaced.
+  If views use it, it is moved to a hidden geometry kept in retired
+  instead of being destroyed, and geom is set to NULL. The prepared
+  geometry is released in any case.
+*/
+void
+rgeo_retire_geometry(RGeo_GeometryData* object_data);
+
+/*
+  Calls func with data while the GVL is released, see rgeo_without_gvl,
+  and wraps the GEOS geometry it returns as rgeo_wrap_geos_geometry does.
+  Errors reported by GEOS during the call are raised.
+*/
+VALUE
+rgeo_wrap_geos_geometry_nogvl(VALUE factory,
+                              void* (*func)(void*),
+                              void* data,
+                              VALUE klass);
+
+/*
+  Same as rgeo_convert_to_geos_geometry except that it returns the ruby
+  Geometry object holding the GEOS geometry, or Qnil if state is set.
+  Use this when the GEOS geometry is used while the GVL is released: the
+  returned object may be a new one that must be kept alive, for instance
+  with RB_GC_GUARD, until the GEOS call returns.
+*/
+VALUE
+rgeo_convert_to_geos_object(VALUE factory, VALUE obj, VALUE type, int* state);
+
 /*
   Gets the GEOS geometry for a given ruby Geometry object. If the given
   ruby object is not a GEOS geometry implementation, it is converted to a
@@ -199,6 +494,26 @@ rgeo_convert_to_detached_geos_geometry(VALUE obj,
                                        VALUE* klasses,
                                        int* state);
 
+/*
+  Serializes the given ruby Geometry object to WKT or WKB with the GEOS
+  writer cached in the given slot of the factory data, creating it with
+  the given output dimension (and RGEO_WKB_ options for WKB) if needed.
+  The GVL is released while GEOS writes. Returns Qnil if obj is not a
+  GEOS Geometry implementation.
+*/
+VALUE
+rgeo_write_wkt(VALUE factory,
+               GEOSWKTWriter** slot,
+               int output_dimension,
+               VALUE obj);
+
+VALUE
+rgeo_write_wkb(VALUE factory,
+               GEOSWKBWriter** slot,
+               int output_dimension,
+               int options,
+               VALUE obj);
+
 /*
   Returns 1 if the given ruby object is a GEOS Geometry implementation,
   or 0 if not.
@@ -247,6 +562,16 @@ rgeo_geos_coordseq_hash(const GEOSGeometry* geom, st_index_t hash);
 st_index_t
 rgeo_geos_objbase_hash(VALUE factory, VALUE type_module, st_index_t hash);
 
+/*
+  Returns the ruby hash of the given ruby Geometry object, computed from
+  its factory, the given feature type module and geom_hash the first
+  time, and cached in the geometry data after that.
+*/
+VALUE
+rgeo_geometry_hash(VALUE self,
+                   VALUE type_module,
+                   st_index_t (*geom_hash)(const GEOSGeometry*, st_index_t));
+
 RGEO_END_C
 
 #endif
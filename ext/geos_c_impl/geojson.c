@@ -0,0 +1,441 @@
+/*
+  GeoJSON serialization for GEOS wrapper
+
+  GeoJSON is written directly from the GEOS coordinate sequences, so that
+  coordinates can be rounded, and read with the GEOS GeoJSON reader when
+  available (GEOS 3.10).
+*/
+
+#include "preface.h"
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+#include <geos_c.h>
+#include <math.h>
+#include <ruby.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+#include "factory.h"
+#include "geojson.h"
+#include "globals.h"
+#include "nogvl.h"
+
+RGEO_BEGIN_C
+
+#define RGEO_GEOJSON_MAX_PRECISION 17
+
+/*
+  The writer runs without the GVL, so it uses malloc rather than ruby
+  allocation functions, and reports its own errors in the error field.
+*/
+typedef struct
+{
+  const GEOSGeometry* geom;
+  char* data;
+  size_t size;
+  size_t capacity;
+  int precision;
+  char has_z;
+  const char* error;
+} RGeo_GeoJSONWriter;
+
+/**** WRITER ****/
+
+static int
+geojson_put(RGeo_GeoJSONWriter* writer, const char* str, size_t len)
+{
+  char* data;
+  size_t capacity;
+
+  if (writer->size + len > writer->capacity) {
+    capacity = writer->capacity ? writer->capacity * 2 : 256;
+    while (capacity < writer->size + len) {
+      capacity *= 2;
+    }
+    data = (char*)realloc(writer->data, capacity);
+    if (!data) {
+      writer->error = "Out of memory";
+      return 0;
+    }
+    writer->data = data;
+    writer->capacity = capacity;
+  }
+  memcpy(writer->data + writer->size, str, len);
+  writer->size += len;
+  return 1;
+}
+
+static int
+geojson_put_str(RGeo_GeoJSONWriter* writer, const char* str)
+{
+  return geojson_put(writer, str, strlen(str));
+}
+
+// Writes value with the precision of the writer, without trailing zeros,
+// or with as few digits as needed to read the same value back.
+
+static int
+geojson_put_number(RGeo_GeoJSONWriter* writer, double value)
+{
+  // Enough for the 309 integer digits of the largest doubles.
+  char buffer[350];
+  int len;
+
+  if (!isfinite(value)) {
+    writer->error = "GeoJSON cannot hold non finite coordinates";
+    return 0;
+  }
+  if (writer->precision >= 0) {
+    len = snprintf(buffer, sizeof(buffer), "%.*f", writer->precision, value);
+    if (!memchr(buffer, '.', (size_t)len)) {
+      buffer[len++] = '.';
+      buffer[len++] = '0';
+    } else {
+      while (buffer[len - 1] == '0') {
+        --len;
+      }
+      if (buffer[len - 1] == '.') {
+        ++len;
+      }
+    }
+  } else {
+    len = snprintf(buffer, sizeof(buffer), "%.15g", value);
+    if (strtod(buffer, NULL) != value) {
+      len = snprintf(buffer, sizeof(buffer), "%.17g", value);
+    }
+    // Same as ruby, and GEOS, for integral values.
+    if (!strpbrk(buffer, ".e")) {
+      buffer[len++] = '.';
+      buffer[len++] = '0';
+    }
+  }
+  return geojson_put(writer, buffer, (size_t)len);
+}
+
+static int
+geojson_put_coordinate(RGeo_GeoJSONWriter* writer,
+                       const GEOSCoordSequence* coord_seq,
+                       unsigned int index)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  double x;
+  double y;
+  double z;
+
+  if (!GEOSCoordSeq_getOrdinate_r(context, coord_seq, index, 0, &x) ||
+      !GEOSCoordSeq_getOrdinate_r(context, coord_seq, index, 1, &y) ||
+      !geojson_put(writer, "[", 1) || !geojson_put_number(writer, x) ||
+      !geojson_put(writer, ",", 1) || !geojson_put_number(writer, y)) {
+    return 0;
+  }
+  // 2D geometries of a 3D factory have no Z values.
+  if (writer->has_z &&
+      GEOSCoordSeq_getOrdinate_r(context, coord_seq, index, 2, &z) &&
+      !isnan(z)) {
+    if (!geojson_put(writer, ",", 1) || !geojson_put_number(writer, z)) {
+      return 0;
+    }
+  }
+  return geojson_put(writer, "]", 1);
+}
+
+// Writes the coordinates of a point, or the array of coordinates of a
+// line string or ring.
+
+static int
+geojson_put_coordinates(RGeo_GeoJSONWriter* writer,
+                        const GEOSGeometry* geom,
+                        char point)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  const GEOSCoordSequence* coord_seq;
+  unsigned int size;
+  unsigned int i;
+
+  coord_seq = GEOSGeom_getCoordSeq_r(context, geom);
+  if (!coord_seq || !GEOSCoordSeq_getSize_r(context, coord_seq, &size)) {
+    return 0;
+  }
+  if (point) {
+    return size ? geojson_put_coordinate(writer, coord_seq, 0)
+                : geojson_put(writer, "[]", 2);
+  }
+  if (!geojson_put(writer, "[", 1)) {
+    return 0;
+  }
+  for (i = 0; i < size; ++i) {
+    if ((i && !geojson_put(writer, ",", 1)) ||
+        !geojson_put_coordinate(writer, coord_seq, i)) {
+      return 0;
+    }
+  }
+  return geojson_put(writer, "]", 1);
+}
+
+static int
+geojson_put_polygon(RGeo_GeoJSONWriter* writer, const GEOSGeometry* geom)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  const GEOSGeometry* ring;
+  int count;
+  int i;
+
+  if (GEOSisEmpty_r(context, geom)) {
+    return geojson_put(writer, "[]", 2);
+  }
+  count = GEOSGetNumInteriorRings_r(context, geom);
+  ring = GEOSGetExteriorRing_r(context, geom);
+  if (count < 0 || !ring || !geojson_put(writer, "[", 1) ||
+      !geojson_put_coordinates(writer, ring, 0)) {
+    return 0;
+  }
+  for (i = 0; i < count; ++i) {
+    ring = GEOSGetInteriorRingN_r(context, geom, i);
+    if (!ring || !geojson_put(writer, ",", 1) ||
+        !geojson_put_coordinates(writer, ring, 0)) {
+      return 0;
+    }
+  }
+  return geojson_put(writer, "]", 1);
+}
+
+static int
+geojson_put_geometry(RGeo_GeoJSONWriter* writer, const GEOSGeometry* geom)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  const GEOSGeometry* part;
+  const char* type;
+  int type_id;
+  int count;
+  int i;
+
+  type_id = GEOSGeomTypeId_r(context, geom);
+  switch (type_id) {
+    case GEOS_POINT:
+      type = "{\"type\":\"Point\",\"coordinates\":";
+      break;
+    case GEOS_LINESTRING:
+    case GEOS_LINEARRING:
+      type = "{\"type\":\"LineString\",\"coordinates\":";
+      break;
+    case GEOS_POLYGON:
+      type = "{\"type\":\"Polygon\",\"coordinates\":";
+      break;
+    case GEOS_MULTIPOINT:
+      type = "{\"type\":\"MultiPoint\",\"coordinates\":[";
+      break;
+    case GEOS_MULTILINESTRING:
+      type = "{\"type\":\"MultiLineString\",\"coordinates\":[";
+      break;
+    case GEOS_MULTIPOLYGON:
+      type = "{\"type\":\"MultiPolygon\",\"coordinates\":[";
+      break;
+    case GEOS_GEOMETRYCOLLECTION:
+      type = "{\"type\":\"GeometryCollection\",\"geometries\":[";
+      break;
+    default:
+      return 0;
+  }
+  if (!geojson_put_str(writer, type)) {
+    return 0;
+  }
+
+  switch (type_id) {
+    case GEOS_POINT:
+      return geojson_put_coordinates(writer, geom, 1) &&
+             geojson_put(writer, "}", 1);
+    case GEOS_LINESTRING:
+    case GEOS_LINEARRING:
+      return geojson_put_coordinates(writer, geom, 0) &&
+             geojson_put(writer, "}", 1);
+    case GEOS_POLYGON:
+      return geojson_put_polygon(writer, geom) && geojson_put(writer, "}", 1);
+  }
+
+  count = GEOSGetNumGeometries_r(context, geom);
+  if (count < 0) {
+    return 0;
+  }
+  for (i = 0; i < count; ++i) {
+    part = GEOSGetGeometryN_r(context, geom, i);
+    if (!part || (i && !geojson_put(writer, ",", 1))) {
+      return 0;
+    }
+    switch (type_id) {
+      case GEOS_MULTIPOINT:
+        if (!geojson_put_coordinates(writer, part, 1)) {
+          return 0;
+        }
+        break;
+      case GEOS_MULTILINESTRING:
+        if (!geojson_put_coordinates(writer, part, 0)) {
+          return 0;
+        }
+        break;
+      case GEOS_MULTIPOLYGON:
+        if (!geojson_put_polygon(writer, part)) {
+          return 0;
+        }
+        break;
+      default:
+        if (!geojson_put_geometry(writer, part)) {
+          return 0;
+        }
+    }
+  }
+  return geojson_put(writer, "]}", 2);
+}
+
+static void*
+write_geojson_nogvl(void* data)
+{
+  RGeo_GeoJSONWriter* writer = (RGeo_GeoJSONWriter*)data;
+
+  return geojson_put_geometry(writer, writer->geom) ? writer : NULL;
+}
+
+VALUE
+rgeo_write_geojson(const GEOSGeometry* geom, int flags, int precision)
+{
+  RGeo_GeoJSONWriter writer;
+  void* written;
+  VALUE result;
+  int state = 0;
+
+  if (precision > RGEO_GEOJSON_MAX_PRECISION) {
+    rb_raise(rb_eArgError,
+             "GeoJSON precision must be between 0 and %d",
+             RGEO_GEOJSON_MAX_PRECISION);
+  }
+  memset(&writer, 0, sizeof(RGeo_GeoJSONWriter));
+  writer.geom = geom;
+  writer.precision = precision;
+  writer.has_z = (flags & RGEO_FACTORYFLAGS_SUPPORTS_Z) != 0;
+
+  written = rgeo_without_gvl(write_geojson_nogvl, &writer, &state);
+  result = Qnil;
+  if (written && !state) {
+    result = rb_usascii_str_new(writer.data, (long)writer.size);
+  }
+  free(writer.data);
+  if (state) {
+    rb_jump_tag(state);
+  }
+  if (!written) {
+    rb_raise(rb_eRGeoUnsupportedOperation,
+             "%s",
+             writer.error ? writer.error : "Cannot write GeoJSON");
+  }
+  return result;
+}
+
+/**** READER ****/
+
+#ifdef RGEO_GEOS_SUPPORTS_GEOJSON
+
+static void*
+read_geojson_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSGeoJSONReader* reader;
+  GEOSGeometry* geom;
+
+  reader = GEOSGeoJSONReader_create_r(context);
+  if (!reader) {
+    return NULL;
+  }
+  geom = GEOSGeoJSONReader_readGeometry_r(context, reader, (const char*)data);
+  GEOSGeoJSONReader_destroy_r(context, reader);
+  return geom;
+}
+
+#endif
+
+/**** RUBY METHOD DEFINITIONS ****/
+
+static VALUE
+method_geometry_as_geojson(VALUE self, VALUE precision)
+{
+  RGeo_GeometryData* self_data;
+  VALUE result;
+
+  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  if (!self_data->geom) {
+    return Qnil;
+  }
+  if (!NIL_P(precision) && NUM2INT(precision) < 0) {
+    rb_raise(rb_eArgError,
+             "GeoJSON precision must be between 0 and %d",
+             RGEO_GEOJSON_MAX_PRECISION);
+  }
+  result = rgeo_write_geojson(self_data->geom,
+                              RGEO_FACTORY_DATA_PTR(self_data->factory)->flags,
+                              NIL_P(precision) ? -1 : NUM2INT(precision));
+  RB_GC_GUARD(self);
+  return result;
+}
+
+static VALUE
+method_factory_parse_geojson(VALUE self, VALUE str)
+{
+#ifdef RGEO_GEOS_SUPPORTS_GEOJSON
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSGeometry* geom;
+  int flags;
+  int state = 0;
+
+  Check_Type(str, T_STRING);
+  // The frozen copy cannot change while the GVL is released.
+  str = rb_str_new_frozen(str);
+  geom = (GEOSGeometry*)rgeo_without_gvl(
+    read_geojson_nogvl, (void*)StringValueCStr(str), &state);
+  RB_GC_GUARD(str);
+  if (state) {
+    if (geom) {
+      GEOSGeom_destroy_r(context, geom);
+    }
+    rb_jump_tag(state);
+  }
+  if (!geom) {
+    rb_raise(rb_eRGeoParseError, "Cannot parse GeoJSON");
+  }
+  // GeoJSON has no M. 2D data is kept as is on 3D factories, as the
+  // writer does, but Z values need a factory with Z coordinates.
+  flags = RGEO_FACTORY_DATA_PTR(self)->flags;
+  if (GEOSGeom_getCoordinateDimension_r(context, geom) > 2 &&
+      !(flags & RGEO_FACTORYFLAGS_SUPPORTS_Z)) {
+    GEOSGeom_destroy_r(context, geom);
+    rb_raise(
+      rb_eRGeoParseError,
+      "Data has Z coordinates but the factory doesn't have Z coordinates");
+  }
+  return rgeo_wrap_geos_geometry(self, geom, Qnil);
+#else
+  rb_raise(rb_eRGeoUnsupportedOperation,
+           "Reading GeoJSON requires GEOS 3.10 or later");
+  return Qnil;
+#endif
+}
+
+void
+rgeo_init_geos_geojson()
+{
+  VALUE geos_geometry_methods;
+  VALUE geos_factory_class;
+
+  geos_geometry_methods =
+    rb_define_module_under(rgeo_geos_module, "CAPIGeometryMethods");
+  geos_factory_class =
+    rb_const_get_at(rgeo_geos_module, rb_intern("CAPIFactory"));
+  rb_define_method(
+    geos_geometry_methods, "_as_geojson", method_geometry_as_geojson, 1);
+  rb_define_method(
+    geos_factory_class, "_parse_geojson", method_factory_parse_geojson, 1);
+}
+
+RGEO_END_C
+
+#endif
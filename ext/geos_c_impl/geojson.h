@@ -0,0 +1,37 @@
+/*
+  GeoJSON serialization for GEOS wrapper
+*/
+
+#ifndef RGEO_GEOS_GEOJSON_INCLUDED
+#define RGEO_GEOS_GEOJSON_INCLUDED
+
+#include <geos_c.h>
+#include <ruby.h>
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+RGEO_BEGIN_C
+
+/*
+  Returns the GeoJSON geometry object of the given GEOS geometry as a
+  string. Coordinates are rounded to precision decimal digits (0 to 17),
+  or written in full if precision is negative. Z coordinates are written
+  for factories with the given flags that have them; M coordinates are
+  not part of GeoJSON. Raises RGeo::Error::UnsupportedOperation for non
+  finite coordinates.
+*/
+VALUE
+rgeo_write_geojson(const GEOSGeometry* geom, int flags, int precision);
+
+/*
+  Initializes the GeoJSON module. This should be called after
+  the geometry module is initialized.
+*/
+void
+rgeo_init_geos_geojson();
+
+RGEO_END_C
+
+#endif // RGEO_GEOS_SUPPORTED
+
+#endif // RGEO_GEOS_GEOJSON_INCLUDED
@@ -8,12 +8,15 @@
 
 #include <geos_c.h>
 #include <ruby.h>
+#include <stdint.h>
 #include <string.h>
 
+#include "coordinates.h"
 #include "errors.h"
 #include "factory.h"
 #include "geometry.h"
 #include "globals.h"
+#include "nogvl.h"
 
 RGEO_BEGIN_C
 
@@ -25,6 +28,7 @@ RGEO_BEGIN_C
 static int
 compute_dimension(const GEOSGeometry* geom)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   int result;
   int size;
   int i;
@@ -32,12 +36,12 @@ compute_dimension(const GEOSGeometry* geom)
 
   result = -1;
   if (geom) {
-    switch (GEOSGeomTypeId(geom)) {
+    switch (GEOSGeomTypeId_r(context, geom)) {
       case GEOS_POINT:
         result = 0;
         break;
       case GEOS_MULTIPOINT:
-        if (!GEOSisEmpty(geom)) {
+        if (!GEOSisEmpty_r(context, geom)) {
           result = 0;
         }
         break;
@@ -46,7 +50,7 @@ compute_dimension(const GEOSGeometry* geom)
         result = 1;
         break;
       case GEOS_MULTILINESTRING:
-        if (!GEOSisEmpty(geom)) {
+        if (!GEOSisEmpty_r(context, geom)) {
           result = 1;
         }
         break;
@@ -54,14 +58,14 @@ compute_dimension(const GEOSGeometry* geom)
         result = 2;
         break;
       case GEOS_MULTIPOLYGON:
-        if (!GEOSisEmpty(geom)) {
+        if (!GEOSisEmpty_r(context, geom)) {
           result = 2;
         }
         break;
       case GEOS_GEOMETRYCOLLECTION:
-        size = GEOSGetNumGeometries(geom);
+        size = GEOSGetNumGeometries_r(context, geom);
         for (i = 0; i < size; ++i) {
-          dim = compute_dimension(GEOSGetGeometryN(geom, i));
+          dim = compute_dimension(GEOSGetGeometryN_r(context, geom, i));
           if (dim > result) {
             result = dim;
           }
@@ -72,32 +76,304 @@ compute_dimension(const GEOSGeometry* geom)
   return result;
 }
 
-// Returns a prepared geometry, honoring the preparation policy.
+// Relation between the bounding boxes of self and rhs, used to answer
+// predicates without calling GEOS. The cached bounds of rhs are used
+// when rhs_geom is its own geometry. An empty geometry is apart from
+// any other.
 
-static const GEOSPreparedGeometry*
-rgeo_request_prepared_geometry(RGeo_GeometryData* object_data)
+#define RGEO_BBOX_APART 1
+#define RGEO_BBOX_COVERS 2
+#define RGEO_BBOX_COVERED 4
+#define RGEO_BBOX_INTERSECTS 8
+
+static int
+bbox_relation(RGeo_GeometryData* self_data,
+              VALUE rhs,
+              const GEOSGeometry* rhs_geom)
 {
+  const double* self_bounds;
+  const double* rhs_bounds;
+  double buffer[4];
+  int result;
+
+  self_bounds = rgeo_geometry_bounds(self_data);
+  if (!self_bounds) {
+    return RGEO_BBOX_APART;
+  }
+  if (rgeo_is_geos_object(rhs) &&
+      RGEO_GEOMETRY_DATA_PTR(rhs)->geom == rhs_geom) {
+    rhs_bounds = rgeo_geometry_bounds(RGEO_GEOMETRY_DATA_PTR(rhs));
+  } else {
+    rhs_bounds = rgeo_geos_geometry_bounds(rhs_geom, buffer) ? buffer : NULL;
+  }
+  if (!rhs_bounds) {
+    return RGEO_BBOX_APART;
+  }
+
+  if (rhs_bounds[0] > self_bounds[2] || rhs_bounds[2] < self_bounds[0] ||
+      rhs_bounds[1] > self_bounds[3] || rhs_bounds[3] < self_bounds[1]) {
+    return RGEO_BBOX_APART;
+  }
+  result = RGEO_BBOX_INTERSECTS;
+  if (self_bounds[0] <= rhs_bounds[0] && self_bounds[1] <= rhs_bounds[1] &&
+      self_bounds[2] >= rhs_bounds[2] && self_bounds[3] >= rhs_bounds[3]) {
+    result |= RGEO_BBOX_COVERS;
+  }
+  if (rhs_bounds[0] <= self_bounds[0] && rhs_bounds[1] <= self_bounds[1] &&
+      rhs_bounds[2] >= self_bounds[2] && rhs_bounds[3] >= self_bounds[3]) {
+    result |= RGEO_BBOX_COVERED;
+  }
+  return result;
+}
+
+// Evaluates a predicate of self against each geometry of the candidates
+// array, using the prepared geometry when there is more than one
+// candidate. Candidates whose bounding box relation to self, as given by
+// bbox_relation, lacks bbox_required do not match, without calling GEOS.
+// Returns the indexes of the matching candidates, or, if bitmap is true,
+// a binary string whose bit i (least significant bit first, as in
+// unpack("b*")) is set when candidate i matches.
+
+static VALUE
+batch_predicate(VALUE self,
+                VALUE candidates,
+                VALUE bitmap,
+                int bbox_required,
+                char (*prepared_predicate)(GEOSContextHandle_t,
+                                           const GEOSPreparedGeometry*,
+                                           const GEOSGeometry*),
+                char (*predicate)(GEOSContextHandle_t,
+                                  const GEOSGeometry*,
+                                  const GEOSGeometry*))
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  VALUE result;
+  RGeo_GeometryData* self_data;
+  const GEOSGeometry* self_geom;
+  VALUE candidate;
+  const GEOSGeometry* candidate_geom;
   const GEOSPreparedGeometry* prep;
+  char* bits;
+  char val;
+  long size;
+  long i;
+  int state = 0;
 
-  prep = object_data->prep;
-  if (prep == (const GEOSPreparedGeometry*)1) {
-    object_data->prep = (GEOSPreparedGeometry*)2;
-    prep = NULL;
-  } else if (prep == (const GEOSPreparedGeometry*)2) {
-    if (object_data->geom) {
-      prep = GEOSPrepare(object_data->geom);
-    } else {
-      prep = NULL;
+  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  self_geom = self_data->geom;
+  if (!self_geom) {
+    return Qnil;
+  }
+  Check_Type(candidates, T_ARRAY);
+  size = RARRAY_LEN(candidates);
+  prep = NULL;
+#ifdef RGEO_GEOS_SUPPORTS_PREPARED1
+  prep = rgeo_request_prepared_geometry(self_data, size > 1);
+#endif
+
+  if (RTEST(bitmap)) {
+    result = rb_str_new(NULL, (size + 7) / 8);
+    memset(RSTRING_PTR(result), 0, (size + 7) / 8);
+  } else {
+    result = rb_ary_new();
+  }
+  for (i = 0; i < size; ++i) {
+    candidate = rb_ary_entry(candidates, i);
+    candidate_geom = rgeo_convert_to_geos_geometry(
+      self_data->factory, candidate, Qnil, &state);
+    if (state) {
+      rb_jump_tag(state);
+    }
+    if (!(bbox_relation(self_data, candidate, candidate_geom) &
+          bbox_required)) {
+      continue;
     }
+    // The conversion may run ruby code, which may evict the prepared
+    // geometry.
     if (prep) {
-      object_data->prep = prep;
+      prep = rgeo_prepared_geometry_holder(self_data)->prep;
+    }
+    if (prep) {
+      val = prepared_predicate(context, prep, candidate_geom);
     } else {
-      object_data->prep = (const GEOSPreparedGeometry*)3;
+      val = predicate(context, self_geom, candidate_geom);
+    }
+    if (val == 1) {
+      if (RTEST(bitmap)) {
+        bits = RSTRING_PTR(result);
+        bits[i / 8] |= (char)(1 << (i % 8));
+      } else {
+        rb_ary_push(result, LONG2NUM(i));
+      }
     }
-  } else if (prep == (const GEOSPreparedGeometry*)3) {
-    prep = NULL;
   }
-  return prep;
+  return result;
+}
+
+// Arguments of the GEOS operations below, which are run without the GVL.
+// Only the fields relevant to a given operation are set.
+
+typedef struct
+{
+  const GEOSGeometry* geom;
+  const GEOSGeometry* other;
+  double param;
+  int quadsegs;
+  int end_cap_style;
+  int join_style;
+  double mitre_limit;
+} RGeo_OperationArgs;
+
+static void*
+buffer_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSBuffer_r(context, args->geom, args->param, args->quadsegs);
+}
+
+static void*
+buffer_with_style_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSBufferWithStyle_r(context,
+                               args->geom,
+                               args->param,
+                               args->quadsegs,
+                               args->end_cap_style,
+                               args->join_style,
+                               args->mitre_limit);
+}
+
+#ifdef RGEO_GEOS_SUPPORTS_DENSIFY
+static void*
+densify_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSDensify_r(context, args->geom, args->param);
+}
+#endif
+
+static void*
+simplify_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSSimplify_r(context, args->geom, args->param);
+}
+
+static void*
+simplify_preserve_topology_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSTopologyPreserveSimplify_r(context, args->geom, args->param);
+}
+
+static void*
+convex_hull_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSConvexHull_r(context, args->geom);
+}
+
+static void*
+intersection_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSIntersection_r(context, args->geom, args->other);
+}
+
+static void*
+union_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSUnion_r(context, args->geom, args->other);
+}
+
+#ifdef RGEO_GEOS_SUPPORTS_UNARYUNION
+static void*
+unary_union_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSUnaryUnion_r(context, args->geom);
+}
+#endif
+
+static void*
+difference_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSDifference_r(context, args->geom, args->other);
+}
+
+static void*
+sym_difference_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSSymDifference_r(context, args->geom, args->other);
+}
+
+static void*
+make_valid_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSMakeValid_r(context, args->geom);
+}
+
+static void*
+polygonize_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return GEOSPolygonize_r(context, &args->geom, 1);
+}
+
+static void*
+is_valid_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_OperationArgs* args = (RGeo_OperationArgs*)data;
+  return (void*)(intptr_t)GEOSisValid_r(context, args->geom);
+}
+
+// Runs a GEOS binary operation without the GVL. rhs is cast to the
+// factory of self first.
+
+static VALUE
+binary_operation_nogvl(VALUE self, VALUE rhs, void* (*func)(void*))
+{
+  VALUE result;
+  RGeo_GeometryData* self_data;
+  RGeo_OperationArgs args;
+  VALUE factory;
+  VALUE rhs_obj;
+  int state = 0;
+
+  result = Qnil;
+  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    factory = self_data->factory;
+    rhs_obj = rgeo_convert_to_geos_object(factory, rhs, Qnil, &state);
+    if (state) {
+      rb_jump_tag(state);
+    }
+    args.other = RGEO_GEOMETRY_DATA_PTR(rhs_obj)->geom;
+    result = rgeo_wrap_geos_geometry_nogvl(factory, func, &args, Qnil);
+    RB_GC_GUARD(rhs_obj);
+    RB_GC_GUARD(self);
+  }
+  return result;
 }
 
 /**** RUBY METHOD DEFINITIONS ****/
@@ -111,25 +387,33 @@ method_geometry_initialized_p(VALUE self)
 static VALUE
 method_geometry_factory(VALUE self)
 {
-  return RGEO_GEOMETRY_DATA_PTR(self)->factory;
+  return RGEO_GEOMETRY_LAZY_DATA_PTR(self)->factory;
 }
 
 static VALUE
 method_geometry_set_factory(VALUE self, VALUE factory)
 {
-  RGEO_GEOMETRY_DATA_PTR(self)->factory = factory;
+  RGeo_GeometryData* self_data;
+
+  // Cached output may not be what the new factory writes, and the source
+  // WKB of lazy geometries may include the SRID of the former factory.
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  rgeo_release_geometry_output(self_data);
+  if (self_data->wkb_format >= 0 &&
+      (self_data->wkb_format & RGEO_WKB_INCLUDE_SRID) &&
+      (NIL_P(self_data->factory) || NIL_P(factory) ||
+       RGEO_FACTORY_DATA_PTR(self_data->factory)->srid !=
+         RGEO_FACTORY_DATA_PTR(factory)->srid)) {
+    self_data->wkb_format = -1;
+  }
+  self_data->factory = factory;
   return factory;
 }
 
 static VALUE
 method_geometry_prepared_p(VALUE self)
 {
-  const GEOSPreparedGeometry* prep;
-
-  prep = RGEO_GEOMETRY_DATA_PTR(self)->prep;
-  return (prep && prep != (const GEOSPreparedGeometry*)1 &&
-          prep != (const GEOSPreparedGeometry*)2 &&
-          prep != (GEOSPreparedGeometry*)3)
+  return rgeo_prepared_geometry_holder(RGEO_GEOMETRY_DATA_PTR(self))->prep
            ? Qtrue
            : Qfalse;
 }
@@ -137,23 +421,28 @@ method_geometry_prepared_p(VALUE self)
 static VALUE
 method_geometry_prepare(VALUE self)
 {
+  rgeo_request_prepared_geometry(RGEO_GEOMETRY_DATA_PTR(self), 1);
+  return self;
+}
+
+// Returns [coordinates, sequence_offsets, part_offsets], see
+// extract_packed_coordinates.
+
+static VALUE
+method_geometry_coordinates_packed(VALUE self)
+{
+  VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSPreparedGeometry* prep;
 
+  result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   if (self_data->geom) {
-    prep = self_data->prep;
-    if (!prep || prep == (const GEOSPreparedGeometry*)1 ||
-        prep == (const GEOSPreparedGeometry*)2) {
-      prep = GEOSPrepare(self_data->geom);
-      if (prep) {
-        self_data->prep = prep;
-      } else {
-        self_data->prep = (const GEOSPreparedGeometry*)3;
-      }
-    }
+    result = extract_packed_coordinates(
+      self_data->geom,
+      RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
+        RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M);
   }
-  return self;
+  return result;
 }
 
 static VALUE
@@ -179,8 +468,8 @@ method_geometry_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_geometry_module;
   }
   return result;
@@ -191,13 +480,13 @@ method_geometry_srid(VALUE self)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
 
+  // The GEOS geometry may be shared with copies made by other factories,
+  // so the SRID is the one of the factory.
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    result = INT2NUM(GEOSGetSRID(self_geom));
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data) && !NIL_P(self_data->factory)) {
+    result = INT2NUM(RGEO_FACTORY_DATA_PTR(self_data->factory)->srid);
   }
   return result;
 }
@@ -205,6 +494,7 @@ method_geometry_srid(VALUE self)
 static VALUE
 method_geometry_envelope(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -214,18 +504,37 @@ method_geometry_envelope(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    envelope = GEOSEnvelope(self_geom);
+    envelope = GEOSEnvelope_r(context, self_geom);
     if (!envelope) {
-      envelope = GEOSGeom_createCollection(GEOS_GEOMETRYCOLLECTION, NULL, 0);
+      envelope = GEOSGeom_createCollection_r(
+        context, GEOS_GEOMETRYCOLLECTION, NULL, 0);
     }
     result = rgeo_wrap_geos_geometry(self_data->factory, envelope, Qnil);
   }
   return result;
 }
 
+static VALUE
+method_geometry_bounds(VALUE self)
+{
+  const double* bounds;
+
+  // Lazy geometries get their bounds when they are parsed.
+  bounds = rgeo_geometry_bounds(RGEO_GEOMETRY_LAZY_DATA_PTR(self));
+  if (!bounds) {
+    return Qnil;
+  }
+  return rb_ary_new_from_args(4,
+                              DBL2NUM(bounds[0]),
+                              DBL2NUM(bounds[1]),
+                              DBL2NUM(bounds[2]),
+                              DBL2NUM(bounds[3]));
+}
+
 static VALUE
 method_geometry_boundary(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -235,7 +544,7 @@ method_geometry_boundary(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    boundary = GEOSBoundary(self_geom);
+    boundary = GEOSBoundary_r(context, self_geom);
     if (boundary) {
       result = rgeo_wrap_geos_geometry(self_data->factory, boundary, Qnil);
     }
@@ -243,41 +552,42 @@ method_geometry_boundary(VALUE self)
   return result;
 }
 
+// Output dimension of as_text and as_binary without a WKRep generator.
+// Native XYZM factories have no ZMFactory generator to keep Z and M.
+
+static int
+native_output_dimension(const RGeo_FactoryData* factory_data)
+{
+  return RGEO_FACTORY_DIMS(factory_data->flags) == 4 ? 4 : 2;
+}
+
 static VALUE
 method_geometry_as_text(VALUE self)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
   RGeo_FactoryData* factory_data;
   VALUE wkt_generator;
-  GEOSWKTWriter* wkt_writer;
-  char* str;
 
   result = Qnil;
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (!NIL_P(self_data->text)) {
+    return self_data->text;
+  }
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
+  if (self_data->geom) {
     factory_data = RGEO_FACTORY_DATA_PTR(self_data->factory);
     wkt_generator = factory_data->wkrep_wkt_generator;
     if (!NIL_P(wkt_generator)) {
       result = rb_funcall(wkt_generator, rb_intern("generate"), 1, self);
     } else {
-      wkt_writer = factory_data->wkt_writer;
-      if (!wkt_writer) {
-        wkt_writer = GEOSWKTWriter_create();
-        GEOSWKTWriter_setOutputDimension(wkt_writer, 2);
-        GEOSWKTWriter_setTrim(wkt_writer, 1);
-        factory_data->wkt_writer = wkt_writer;
-      }
-      str = GEOSWKTWriter_write(wkt_writer, self_geom);
-      if (str) {
-        result = rb_str_new2(str);
-        GEOSFree(str);
-      }
+      result = rgeo_write_wkt(self_data->factory,
+                              &factory_data->wkt_writer,
+                              native_output_dimension(factory_data),
+                              self);
     }
   }
-  return result;
+  return rgeo_cache_geometry_output(self_data, 0, result);
 }
 
 static VALUE
@@ -285,42 +595,44 @@ method_geometry_as_binary(VALUE self)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
   RGeo_FactoryData* factory_data;
   VALUE wkb_generator;
-  GEOSWKBWriter* wkb_writer;
-  size_t size;
-  char* str;
 
-  result = Qnil;
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (!NIL_P(self_data->binary)) {
+    return self_data->binary;
+  }
+  result = rgeo_lazy_wkb_as_binary(self_data);
+  if (!NIL_P(result)) {
+    return rgeo_cache_geometry_output(self_data, 1, result);
+  }
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
+  if (self_data->geom) {
     factory_data = RGEO_FACTORY_DATA_PTR(self_data->factory);
     wkb_generator = factory_data->wkrep_wkb_generator;
-    if (!NIL_P(wkb_generator)) {
+    if (factory_data->wkb_options & RGEO_WKB_NATIVE) {
+      result = rgeo_write_wkb(self_data->factory,
+                              &factory_data->wkb_writer,
+                              factory_data->wkb_output_dimension,
+                              factory_data->wkb_options,
+                              self);
+    } else if (!NIL_P(wkb_generator)) {
       result = rb_funcall(wkb_generator, rb_intern("generate"), 1, self);
     } else {
-      wkb_writer = factory_data->wkb_writer;
-
-      if (!wkb_writer) {
-        wkb_writer = GEOSWKBWriter_create();
-        GEOSWKBWriter_setOutputDimension(wkb_writer, 2);
-        factory_data->wkb_writer = wkb_writer;
-      }
-      str = (char*)GEOSWKBWriter_write(wkb_writer, self_geom, &size);
-      if (str) {
-        result = rb_str_new(str, size);
-        GEOSFree(str);
-      }
+      result = rgeo_write_wkb(self_data->factory,
+                              &factory_data->wkb_writer,
+                              native_output_dimension(factory_data),
+                              0,
+                              self);
     }
   }
-  return result;
+  return rgeo_cache_geometry_output(self_data, 1, result);
 }
 
 static VALUE
 method_geometry_is_empty(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -330,7 +642,7 @@ method_geometry_is_empty(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    val = GEOSisEmpty(self_geom);
+    val = GEOSisEmpty_r(context, self_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -343,6 +655,7 @@ method_geometry_is_empty(VALUE self)
 static VALUE
 method_geometry_is_simple(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -352,7 +665,7 @@ method_geometry_is_simple(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    val = GEOSisSimple(self_geom);
+    val = GEOSisSimple_r(context, self_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -365,6 +678,7 @@ method_geometry_is_simple(VALUE self)
 static VALUE
 method_geometry_equals(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -383,10 +697,11 @@ method_geometry_equals(VALUE self, VALUE rhs)
     if (rhs_geom) {
       // GEOS has a bug where empty geometries are not spatially equal
       // to each other. Work around this case first.
-      if (GEOSisEmpty(self_geom) == 1 && GEOSisEmpty(rhs_geom) == 1) {
+      if (GEOSisEmpty_r(context, self_geom) == 1 &&
+          GEOSisEmpty_r(context, rhs_geom) == 1) {
         result = Qtrue;
       } else {
-        result = GEOSEquals(self_geom, rhs_geom) ? Qtrue : Qfalse;
+        result = GEOSEquals_r(context, self_geom, rhs_geom) ? Qtrue : Qfalse;
       }
     }
   }
@@ -403,6 +718,7 @@ method_geometry_eql(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_disjoint(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -421,13 +737,16 @@ method_geometry_disjoint(VALUE self, VALUE rhs)
     if (state) {
       rb_jump_tag(state);
     }
+    if (bbox_relation(self_data, rhs, rhs_geom) & RGEO_BBOX_APART) {
+      return Qtrue;
+    }
 #ifdef RGEO_GEOS_SUPPORTS_PREPARED2
-    prep = rgeo_request_prepared_geometry(self_data);
+    prep = rgeo_request_prepared_geometry(self_data, 0);
     if (prep)
-      result = GEOSPreparedDisjoint(prep, rhs_geom) ? Qtrue : Qfalse;
+      result = GEOSPreparedDisjoint_r(context, prep, rhs_geom) ? Qtrue : Qfalse;
     else
 #endif
-      result = GEOSDisjoint(self_geom, rhs_geom) ? Qtrue : Qfalse;
+      result = GEOSDisjoint_r(context, self_geom, rhs_geom) ? Qtrue : Qfalse;
   }
   return result;
 }
@@ -435,6 +754,7 @@ method_geometry_disjoint(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_intersects(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -454,13 +774,16 @@ method_geometry_intersects(VALUE self, VALUE rhs)
     if (state) {
       rb_jump_tag(state);
     }
+    if (bbox_relation(self_data, rhs, rhs_geom) & RGEO_BBOX_APART) {
+      return Qfalse;
+    }
 #ifdef RGEO_GEOS_SUPPORTS_PREPARED1
-    prep = rgeo_request_prepared_geometry(self_data);
+    prep = rgeo_request_prepared_geometry(self_data, 0);
     if (prep)
-      val = GEOSPreparedIntersects(prep, rhs_geom);
+      val = GEOSPreparedIntersects_r(context, prep, rhs_geom);
     else
 #endif
-      val = GEOSIntersects(self_geom, rhs_geom);
+      val = GEOSIntersects_r(context, self_geom, rhs_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -473,6 +796,7 @@ method_geometry_intersects(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_touches(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -493,12 +817,12 @@ method_geometry_touches(VALUE self, VALUE rhs)
       rb_jump_tag(state);
     }
 #ifdef RGEO_GEOS_SUPPORTS_PREPARED2
-    prep = rgeo_request_prepared_geometry(self_data);
+    prep = rgeo_request_prepared_geometry(self_data, 0);
     if (prep)
-      val = GEOSPreparedTouches(prep, rhs_geom);
+      val = GEOSPreparedTouches_r(context, prep, rhs_geom);
     else
 #endif
-      val = GEOSTouches(self_geom, rhs_geom);
+      val = GEOSTouches_r(context, self_geom, rhs_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -511,6 +835,7 @@ method_geometry_touches(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_crosses(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -531,12 +856,12 @@ method_geometry_crosses(VALUE self, VALUE rhs)
       rb_jump_tag(state);
     }
 #ifdef RGEO_GEOS_SUPPORTS_PREPARED2
-    prep = rgeo_request_prepared_geometry(self_data);
+    prep = rgeo_request_prepared_geometry(self_data, 0);
     if (prep)
-      val = GEOSPreparedCrosses(prep, rhs_geom);
+      val = GEOSPreparedCrosses_r(context, prep, rhs_geom);
     else
 #endif
-      val = GEOSCrosses(self_geom, rhs_geom);
+      val = GEOSCrosses_r(context, self_geom, rhs_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -549,6 +874,7 @@ method_geometry_crosses(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_within(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -568,13 +894,16 @@ method_geometry_within(VALUE self, VALUE rhs)
     if (state) {
       rb_jump_tag(state);
     }
+    if (!(bbox_relation(self_data, rhs, rhs_geom) & RGEO_BBOX_COVERED)) {
+      return Qfalse;
+    }
 #ifdef RGEO_GEOS_SUPPORTS_PREPARED2
-    prep = rgeo_request_prepared_geometry(self_data);
+    prep = rgeo_request_prepared_geometry(self_data, 0);
     if (prep)
-      val = GEOSPreparedWithin(prep, rhs_geom);
+      val = GEOSPreparedWithin_r(context, prep, rhs_geom);
     else
 #endif
-      val = GEOSWithin(self_geom, rhs_geom);
+      val = GEOSWithin_r(context, self_geom, rhs_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -587,6 +916,7 @@ method_geometry_within(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_contains(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -606,13 +936,16 @@ method_geometry_contains(VALUE self, VALUE rhs)
     if (state) {
       rb_jump_tag(state);
     }
+    if (!(bbox_relation(self_data, rhs, rhs_geom) & RGEO_BBOX_COVERS)) {
+      return Qfalse;
+    }
 #ifdef RGEO_GEOS_SUPPORTS_PREPARED1
-    prep = rgeo_request_prepared_geometry(self_data);
+    prep = rgeo_request_prepared_geometry(self_data, 0);
     if (prep)
-      val = GEOSPreparedContains(prep, rhs_geom);
+      val = GEOSPreparedContains_r(context, prep, rhs_geom);
     else
 #endif
-      val = GEOSContains(self_geom, rhs_geom);
+      val = GEOSContains_r(context, self_geom, rhs_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -622,9 +955,212 @@ method_geometry_contains(VALUE self, VALUE rhs)
   return result;
 }
 
+static VALUE
+method_geometry_contains_each(VALUE self, VALUE candidates, VALUE bitmap)
+{
+  return batch_predicate(self,
+                         candidates,
+                         bitmap,
+                         RGEO_BBOX_COVERS,
+                         GEOSPreparedContains_r,
+                         GEOSContains_r);
+}
+
+static VALUE
+method_geometry_intersects_each(VALUE self, VALUE candidates, VALUE bitmap)
+{
+  return batch_predicate(self,
+                         candidates,
+                         bitmap,
+                         RGEO_BBOX_INTERSECTS,
+                         GEOSPreparedIntersects_r,
+                         GEOSIntersects_r);
+}
+
+// Evaluates the contains or intersects predicate of a geometry against
+// the point (x, y) without allocating any ruby object. Points outside
+// bounds, the bounds of the geometry or NULL if it is empty, are rejected
+// first. GEOS >= 3.12 tests the coordinates directly against the prepared
+// geometry; otherwise a temporary GEOS point is allocated for each test.
+// Returns 2 on failure, like GEOS predicates.
+
+static char
+xy_predicate(GEOSContextHandle_t context,
+             const GEOSGeometry* geom,
+             const double* bounds,
+             const GEOSPreparedGeometry* prep,
+             char contains,
+             double x,
+             double y)
+{
+  GEOSGeometry* point;
+  char result;
+
+  if (!bounds || x < bounds[0] || y < bounds[1] || x > bounds[2] ||
+      y > bounds[3]) {
+    return 0;
+  }
+#ifdef RGEO_GEOS_SUPPORTS_PREPARED_XY
+  if (prep) {
+    return contains ? GEOSPreparedContainsXY_r(context, prep, x, y)
+                    : GEOSPreparedIntersectsXY_r(context, prep, x, y);
+  }
+#endif
+  point = GEOSGeom_createPointFromXY_r(context, x, y);
+  if (!point) {
+    return 2;
+  }
+#ifdef RGEO_GEOS_SUPPORTS_PREPARED1
+  if (prep) {
+    result = contains ? GEOSPreparedContains_r(context, prep, point)
+                      : GEOSPreparedIntersects_r(context, prep, point);
+  } else
+#endif
+    result = contains ? GEOSContains_r(context, geom, point)
+                      : GEOSIntersects_r(context, geom, point);
+  GEOSGeom_destroy_r(context, point);
+  return result;
+}
+
+static VALUE
+xy_predicate_value(VALUE self, VALUE x, VALUE y, char contains)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_GeometryData* self_data;
+  const GEOSPreparedGeometry* prep;
+  char val;
+
+  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  if (!self_data->geom) {
+    return Qnil;
+  }
+  prep = NULL;
+#ifdef RGEO_GEOS_SUPPORTS_PREPARED1
+  prep = rgeo_request_prepared_geometry(self_data, 0);
+#endif
+  val = xy_predicate(context,
+                     self_data->geom,
+                     rgeo_geometry_bounds(self_data),
+                     prep,
+                     contains,
+                     rb_num2dbl(x),
+                     rb_num2dbl(y));
+  if (val == 0) {
+    return Qfalse;
+  } else if (val == 1) {
+    return Qtrue;
+  }
+  return Qnil;
+}
+
+// Batch form of xy_predicate_value. coordinates is either a flat array of
+// numbers or a binary string of native doubles (as given by pack("d*")),
+// both holding x, y pairs. The result is the same as in batch_predicate.
+
+static VALUE
+batch_xy_predicate(VALUE self, VALUE coordinates, VALUE bitmap, char contains)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  VALUE result;
+  RGeo_GeometryData* self_data;
+  const double* bounds;
+  const GEOSPreparedGeometry* prep;
+  const char* packed;
+  double xy[2];
+  char* bits;
+  char val;
+  long size;
+  long i;
+
+  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  if (!self_data->geom) {
+    return Qnil;
+  }
+  if (RB_TYPE_P(coordinates, T_STRING)) {
+    if (RSTRING_LEN(coordinates) % (2 * sizeof(double)) != 0) {
+      rb_raise(rb_eArgError,
+               "Packed coordinates must hold pairs of doubles, got %ld bytes",
+               RSTRING_LEN(coordinates));
+    }
+    size = RSTRING_LEN(coordinates) / (2 * sizeof(double));
+  } else {
+    Check_Type(coordinates, T_ARRAY);
+    if (RARRAY_LEN(coordinates) % 2 != 0) {
+      rb_raise(rb_eArgError,
+               "Coordinates must be x, y pairs, got %ld numbers",
+               RARRAY_LEN(coordinates));
+    }
+    size = RARRAY_LEN(coordinates) / 2;
+  }
+  bounds = rgeo_geometry_bounds(self_data);
+  prep = NULL;
+#ifdef RGEO_GEOS_SUPPORTS_PREPARED1
+  prep = rgeo_request_prepared_geometry(self_data, 1);
+#endif
+
+  if (RTEST(bitmap)) {
+    result = rb_str_new(NULL, (size + 7) / 8);
+    memset(RSTRING_PTR(result), 0, (size + 7) / 8);
+  } else {
+    result = rb_ary_new();
+  }
+  for (i = 0; i < size; ++i) {
+    if (RB_TYPE_P(coordinates, T_STRING)) {
+      // The string buffer may not be aligned for doubles.
+      packed = RSTRING_PTR(coordinates) + i * sizeof(xy);
+      memcpy(xy, packed, sizeof(xy));
+    } else {
+      xy[0] = rb_num2dbl(rb_ary_entry(coordinates, 2 * i));
+      xy[1] = rb_num2dbl(rb_ary_entry(coordinates, 2 * i + 1));
+      if (prep) {
+        prep = rgeo_prepared_geometry_holder(self_data)->prep;
+      }
+    }
+    val = xy_predicate(
+      context, self_data->geom, bounds, prep, contains, xy[0], xy[1]);
+    if (val == 1) {
+      if (RTEST(bitmap)) {
+        bits = RSTRING_PTR(result);
+        bits[i / 8] |= (char)(1 << (i % 8));
+      } else {
+        rb_ary_push(result, LONG2NUM(i));
+      }
+    }
+  }
+  RB_GC_GUARD(coordinates);
+  return result;
+}
+
+static VALUE
+method_geometry_contains_xy(VALUE self, VALUE x, VALUE y)
+{
+  return xy_predicate_value(self, x, y, 1);
+}
+
+static VALUE
+method_geometry_intersects_xy(VALUE self, VALUE x, VALUE y)
+{
+  return xy_predicate_value(self, x, y, 0);
+}
+
+static VALUE
+method_geometry_contains_xy_each(VALUE self, VALUE coordinates, VALUE bitmap)
+{
+  return batch_xy_predicate(self, coordinates, bitmap, 1);
+}
+
+static VALUE
+method_geometry_intersects_xy_each(VALUE self,
+                                   VALUE coordinates,
+                                   VALUE bitmap)
+{
+  return batch_xy_predicate(self, coordinates, bitmap, 0);
+}
+
 static VALUE
 method_geometry_overlaps(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -645,12 +1181,12 @@ method_geometry_overlaps(VALUE self, VALUE rhs)
       rb_jump_tag(state);
     }
 #ifdef RGEO_GEOS_SUPPORTS_PREPARED2
-    prep = rgeo_request_prepared_geometry(self_data);
+    prep = rgeo_request_prepared_geometry(self_data, 0);
     if (prep)
-      val = GEOSPreparedOverlaps(prep, rhs_geom);
+      val = GEOSPreparedOverlaps_r(context, prep, rhs_geom);
     else
 #endif
-      val = GEOSOverlaps(self_geom, rhs_geom);
+      val = GEOSOverlaps_r(context, self_geom, rhs_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -663,6 +1199,7 @@ method_geometry_overlaps(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_relate(VALUE self, VALUE rhs, VALUE pattern)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -680,7 +1217,8 @@ method_geometry_relate(VALUE self, VALUE rhs, VALUE pattern)
       rb_jump_tag(state);
     }
 
-    val = GEOSRelatePattern(self_geom, rhs_geom, StringValuePtr(pattern));
+    val = GEOSRelatePattern_r(
+      context, self_geom, rhs_geom, StringValuePtr(pattern));
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -693,6 +1231,7 @@ method_geometry_relate(VALUE self, VALUE rhs, VALUE pattern)
 static VALUE
 method_geometry_distance(VALUE self, VALUE rhs)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -710,7 +1249,7 @@ method_geometry_distance(VALUE self, VALUE rhs)
       rb_jump_tag(state);
     }
 
-    if (GEOSDistance(self_geom, rhs_geom, &dist)) {
+    if (GEOSDistance_r(context, self_geom, rhs_geom, &dist)) {
       result = rb_float_new(dist);
     }
   }
@@ -722,20 +1261,19 @@ method_geometry_buffer(VALUE self, VALUE distance)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
+  RGeo_OperationArgs args;
   VALUE factory;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
+  args.geom = self_data->geom;
+  if (args.geom) {
     factory = self_data->factory;
-    result = rgeo_wrap_geos_geometry(
-      factory,
-      GEOSBuffer(self_geom,
-                 rb_num2dbl(distance),
-                 RGEO_FACTORY_DATA_PTR(factory)->buffer_resolution),
-      Qnil);
+    args.param = rb_num2dbl(distance);
+    args.quadsegs = RGEO_FACTORY_DATA_PTR(factory)->buffer_resolution;
+    result =
+      rgeo_wrap_geos_geometry_nogvl(factory, buffer_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
   }
   return result;
 }
@@ -746,16 +1284,16 @@ method_geometry_segmentize(VALUE self, VALUE max_segment_length)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
+  RGeo_OperationArgs args;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    result = rgeo_wrap_geos_geometry(
-      factory, GEOSDensify(self_geom, rb_num2dbl(max_segment_length)), Qnil);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    args.param = rb_num2dbl(max_segment_length);
+    result = rgeo_wrap_geos_geometry_nogvl(
+      self_data->factory, densify_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
   }
   return result;
 }
@@ -770,23 +1308,22 @@ method_geometry_buffer_with_style(VALUE self,
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
+  RGeo_OperationArgs args;
   VALUE factory;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
+  args.geom = self_data->geom;
+  if (args.geom) {
     factory = self_data->factory;
-    result = rgeo_wrap_geos_geometry(
-      factory,
-      GEOSBufferWithStyle(self_geom,
-                          rb_num2dbl(distance),
-                          RGEO_FACTORY_DATA_PTR(factory)->buffer_resolution,
-                          RB_NUM2INT(endCapStyle),
-                          RB_NUM2INT(joinStyle),
-                          rb_num2dbl(mitreLimit)),
-      Qnil);
+    args.param = rb_num2dbl(distance);
+    args.quadsegs = RGEO_FACTORY_DATA_PTR(factory)->buffer_resolution;
+    args.end_cap_style = RB_NUM2INT(endCapStyle);
+    args.join_style = RB_NUM2INT(joinStyle);
+    args.mitre_limit = rb_num2dbl(mitreLimit);
+    result = rgeo_wrap_geos_geometry_nogvl(
+      factory, buffer_with_style_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
   }
   return result;
 }
@@ -796,16 +1333,16 @@ method_geometry_simplify(VALUE self, VALUE tolerance)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
+  RGeo_OperationArgs args;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    result = rgeo_wrap_geos_geometry(
-      factory, GEOSSimplify(self_geom, rb_num2dbl(tolerance)), Qnil);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    args.param = rb_num2dbl(tolerance);
+    result = rgeo_wrap_geos_geometry_nogvl(
+      self_data->factory, simplify_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
   }
   return result;
 }
@@ -815,18 +1352,16 @@ method_geometry_simplify_preserve_topology(VALUE self, VALUE tolerance)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
+  RGeo_OperationArgs args;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    result = rgeo_wrap_geos_geometry(
-      factory,
-      GEOSTopologyPreserveSimplify(self_geom, rb_num2dbl(tolerance)),
-      Qnil);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    args.param = rb_num2dbl(tolerance);
+    result = rgeo_wrap_geos_geometry_nogvl(
+      self_data->factory, simplify_preserve_topology_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
   }
   return result;
 }
@@ -836,14 +1371,15 @@ method_geometry_convex_hull(VALUE self)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
+  RGeo_OperationArgs args;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    result = rgeo_wrap_geos_geometry(
-      self_data->factory, GEOSConvexHull(self_geom), Qnil);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    result = rgeo_wrap_geos_geometry_nogvl(
+      self_data->factory, convex_hull_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
   }
   return result;
 }
@@ -851,67 +1387,30 @@ method_geometry_convex_hull(VALUE self)
 static VALUE
 method_geometry_intersection(VALUE self, VALUE rhs)
 {
-  VALUE result;
-  RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
-  const GEOSGeometry* rhs_geom;
-  int state = 0;
-
-  result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    rhs_geom = rgeo_convert_to_geos_geometry(factory, rhs, Qnil, &state);
-    if (state) {
-      rb_jump_tag(state);
-    }
-
-    result = rgeo_wrap_geos_geometry(
-      factory, GEOSIntersection(self_geom, rhs_geom), Qnil);
-  }
-  return result;
+  return binary_operation_nogvl(self, rhs, intersection_nogvl);
 }
 
 static VALUE
 method_geometry_union(VALUE self, VALUE rhs)
 {
-  VALUE result;
-  RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
-  const GEOSGeometry* rhs_geom;
-  int state = 0;
-
-  result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    rhs_geom = rgeo_convert_to_geos_geometry(factory, rhs, Qnil, &state);
-    if (state) {
-      rb_jump_tag(state);
-    }
-
-    result =
-      rgeo_wrap_geos_geometry(factory, GEOSUnion(self_geom, rhs_geom), Qnil);
-  }
-  return result;
+  return binary_operation_nogvl(self, rhs, union_nogvl);
 }
 
 static VALUE
 method_geometry_unary_union(VALUE self)
 {
 #ifdef RGEO_GEOS_SUPPORTS_UNARYUNION
+  VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
+  RGeo_OperationArgs args;
 
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    return rgeo_wrap_geos_geometry(
-      self_data->factory, GEOSUnaryUnion(self_geom), Qnil);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    result = rgeo_wrap_geos_geometry_nogvl(
+      self_data->factory, unary_union_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
+    return result;
   }
 #endif
 
@@ -921,97 +1420,88 @@ method_geometry_unary_union(VALUE self)
 static VALUE
 method_geometry_difference(VALUE self, VALUE rhs)
 {
-  VALUE result;
-  RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
-  const GEOSGeometry* rhs_geom;
-  int state = 0;
-
-  result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    rhs_geom = rgeo_convert_to_geos_geometry(factory, rhs, Qnil, &state);
-    if (state) {
-      rb_jump_tag(state);
-    }
-
-    result = rgeo_wrap_geos_geometry(
-      factory, GEOSDifference(self_geom, rhs_geom), Qnil);
-  }
-  return result;
+  return binary_operation_nogvl(self, rhs, difference_nogvl);
 }
 
 static VALUE
 method_geometry_sym_difference(VALUE self, VALUE rhs)
 {
-  VALUE result;
-  RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
-  const GEOSGeometry* rhs_geom;
-  int state = 0;
-
-  result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    rhs_geom = rgeo_convert_to_geos_geometry(factory, rhs, Qnil, &state);
-    if (state) {
-      rb_jump_tag(state);
-    }
-
-    result = rgeo_wrap_geos_geometry(
-      factory, GEOSSymDifference(self_geom, rhs_geom), Qnil);
-  }
-  return result;
+  return binary_operation_nogvl(self, rhs, sym_difference_nogvl);
 }
 
 static VALUE
 method_geometry_initialize_copy(VALUE self, VALUE orig)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   RGeo_GeometryData* self_data;
-  const GEOSPreparedGeometry* prep;
   const GEOSGeometry* geom;
   RGeo_GeometryData* orig_data;
   GEOSGeometry* clone_geom;
-  RGeo_FactoryData* factory_data;
+  VALUE owner;
 
-  // Clear out any existing value
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  if (self == orig) {
+    return self;
+  }
+
+  // Clear out any existing value. Views of it keep its GEOS geometry.
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  rgeo_retire_geometry(self_data);
+  rgeo_untrack_geometry_memory(self_data);
+  rgeo_release_geometry_output(self_data);
+  self_data->bounds_state = RGEO_BOUNDS_UNKNOWN;
+  self_data->has_hash = 0;
   if (self_data->geom) {
-    GEOSGeom_destroy(self_data->geom);
+    if (NIL_P(self_data->parent)) {
+      GEOSGeom_destroy_r(context, self_data->geom);
+    }
     self_data->geom = NULL;
   }
-  prep = self_data->prep;
-  if (prep && prep != (GEOSPreparedGeometry*)1 &&
-      prep != (GEOSPreparedGeometry*)2) {
-    GEOSPreparedGeom_destroy(prep);
-  }
-  self_data->prep = NULL;
   self_data->factory = Qnil;
   self_data->klasses = Qnil;
+  self_data->parent = Qnil;
+  self_data->prep_failed = 0;
+  self_data->prep_requests = 0;
+  self_data->wkb = Qnil;
+  self_data->wkb_hex = 0;
+  self_data->wkb_format = -1;
+
+  if (!RGEO_GEOMETRY_TYPEDDATA_P(orig)) {
+    return self;
+  }
+  // Copy the WKB of lazy geometries, which is only read if orig was.
+  orig_data = RGEO_GEOMETRY_LAZY_DATA_PTR(orig);
+  if (!NIL_P(orig_data->wkb)) {
+    self_data->wkb = orig_data->wkb;
+    self_data->wkb_hex = orig_data->wkb_hex;
+    self_data->wkb_format = orig_data->wkb_format;
+    self_data->bounds_state = orig_data->bounds_state;
+    memcpy(self_data->bounds, orig_data->bounds, sizeof(self_data->bounds));
+    if (!orig_data->geom) {
+      self_data->factory = orig_data->factory;
+      self_data->klasses = orig_data->klasses;
+      return self;
+    }
+  }
 
-  // Copy value from orig
-  geom = rgeo_get_geos_geometry_safe(orig);
+  // Share the GEOS geometry of orig as a view of its owner. It is copied
+  // only if orig was a view of self, whose geometry was just retired.
+  geom = orig_data->geom;
   if (geom) {
-    orig_data = RGEO_GEOMETRY_DATA_PTR(orig);
-    clone_geom = GEOSGeom_clone(geom);
-    if (clone_geom) {
-      factory_data = RGEO_FACTORY_DATA_PTR(orig_data->factory);
-      GEOSSetSRID(clone_geom, GEOSGetSRID(geom));
+    owner = NIL_P(orig_data->parent) ? orig : orig_data->parent;
+    if (owner == self) {
+      clone_geom = GEOSGeom_clone_r(context, geom);
+      if (!clone_geom) {
+        return self;
+      }
       self_data->geom = clone_geom;
-      self_data->prep =
-        factory_data &&
-            ((factory_data->flags & RGEO_FACTORYFLAGS_PREPARE_HEURISTIC) != 0)
-          ? (GEOSPreparedGeometry*)1
-          : NULL;
-      self_data->factory = orig_data->factory;
-      self_data->klasses = orig_data->klasses;
+    } else {
+      self_data->geom = (GEOSGeometry*)geom;
+      self_data->parent = owner;
+      RGEO_GEOMETRY_LAZY_DATA_PTR(owner)->has_views = 1;
     }
+    self_data->factory = orig_data->factory;
+    self_data->klasses = orig_data->klasses;
+    rgeo_track_geometry_memory(self_data);
   }
   return self;
 }
@@ -1019,36 +1509,60 @@ method_geometry_initialize_copy(VALUE self, VALUE orig)
 static VALUE
 method_geometry_steal(VALUE self, VALUE orig)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   RGeo_GeometryData* self_data;
-  const GEOSPreparedGeometry* prep;
-  const GEOSGeometry* geom;
   RGeo_GeometryData* orig_data;
 
-  geom = rgeo_get_geos_geometry_safe(orig);
-  if (geom) {
-    // Clear out any existing value
-    self_data = RGEO_GEOMETRY_DATA_PTR(self);
-    if (self_data->geom) {
-      GEOSGeom_destroy(self_data->geom);
+  if (self == orig || !RGEO_GEOMETRY_TYPEDDATA_P(orig)) {
+    return self;
+  }
+  orig_data = RGEO_GEOMETRY_LAZY_DATA_PTR(orig);
+  if (RGEO_GEOMETRY_INITIALIZED_P(orig_data)) {
+    // A geometry that lent parts to views keeps its GEOS geometry, and
+    // the GEOS geometry of a view of self goes away with self's.
+    if (orig_data->has_views || orig_data->parent == self) {
+      return method_geometry_initialize_copy(self, orig);
     }
-    prep = self_data->prep;
-    if (prep && prep != (GEOSPreparedGeometry*)1 &&
-        prep != (GEOSPreparedGeometry*)2) {
-      GEOSPreparedGeom_destroy(prep);
+
+    // Clear out any existing value. Views of it keep its GEOS geometry.
+    self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+    rgeo_retire_geometry(self_data);
+    rgeo_untrack_geometry_memory(self_data);
+    rgeo_release_geometry_output(self_data);
+    if (self_data->geom && NIL_P(self_data->parent)) {
+      GEOSGeom_destroy_r(context, self_data->geom);
     }
 
-    // Steal value from orig
-    orig_data = RGEO_GEOMETRY_DATA_PTR(orig);
+    // Steal value from orig. Its prepared geometry is linked to orig, so
+    // it is released rather than moved. Its bounds are kept, since lazy
+    // geometries cannot compute them before they are read.
+    rgeo_release_prepared_geometry(orig_data);
+    rgeo_release_geometry_output(orig_data);
     self_data->geom = orig_data->geom;
-    self_data->prep = orig_data->prep;
     self_data->factory = orig_data->factory;
     self_data->klasses = orig_data->klasses;
+    self_data->parent = orig_data->parent;
+    self_data->prep_failed = 0;
+    self_data->prep_requests = 0;
+    self_data->geom_size = orig_data->geom_size;
+    self_data->bounds_state = orig_data->bounds_state;
+    memcpy(self_data->bounds, orig_data->bounds, sizeof(self_data->bounds));
+    self_data->has_hash = 0;
+    self_data->wkb = orig_data->wkb;
+    self_data->wkb_hex = orig_data->wkb_hex;
+    self_data->wkb_format = orig_data->wkb_format;
 
     // Clear out orig
     orig_data->geom = NULL;
-    orig_data->prep = NULL;
+    orig_data->geom_size = 0;
+    orig_data->bounds_state = RGEO_BOUNDS_UNKNOWN;
+    orig_data->has_hash = 0;
     orig_data->factory = Qnil;
     orig_data->klasses = Qnil;
+    orig_data->parent = Qnil;
+    orig_data->wkb = Qnil;
+    orig_data->wkb_hex = 0;
+    orig_data->wkb_format = -1;
   }
   return self;
 }
@@ -1058,14 +1572,19 @@ method_geometry_is_valid(VALUE self)
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
+  RGeo_OperationArgs args;
   char val;
+  int state = 0;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    val = GEOSisValid(self_geom);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    val = (char)(intptr_t)rgeo_without_gvl(is_valid_nogvl, &args, &state);
+    RB_GC_GUARD(self);
+    if (state) {
+      rb_jump_tag(state);
+    }
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -1078,6 +1597,7 @@ method_geometry_is_valid(VALUE self)
 static VALUE
 method_geometry_invalid_reason(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -1088,7 +1608,7 @@ method_geometry_invalid_reason(VALUE self)
   self_geom = self_data->geom;
   if (self_geom) {
     // We use NULL there to tell GEOS that we don't care about the position.
-    switch (GEOSisValidDetail(self_geom, 0, &str, NULL)) {
+    switch (GEOSisValidDetail_r(context, self_geom, 0, &str, NULL)) {
       case 0: // invalid
         result = rb_utf8_str_new_cstr(str);
       case 1: // valid
@@ -1099,7 +1619,7 @@ method_geometry_invalid_reason(VALUE self)
         break;
     };
     if (str)
-      GEOSFree(str);
+      GEOSFree_r(context, str);
   }
   return result;
 }
@@ -1107,6 +1627,7 @@ method_geometry_invalid_reason(VALUE self)
 static VALUE
 method_geometry_invalid_reason_location(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -1117,7 +1638,7 @@ method_geometry_invalid_reason_location(VALUE self)
   self_geom = self_data->geom;
   if (self_geom) {
     // We use NULL there to tell GEOS that we don't care about the reason.
-    switch (GEOSisValidDetail(self_geom, 0, NULL, &location)) {
+    switch (GEOSisValidDetail_r(context, self_geom, 0, NULL, &location)) {
       case 0: // invalid
         result = rgeo_wrap_geos_geometry(self_data->factory, location, Qnil);
       case 1: // valid
@@ -1134,16 +1655,27 @@ method_geometry_invalid_reason_location(VALUE self)
 static VALUE
 method_geometry_make_valid(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
+  RGeo_OperationArgs args;
   GEOSGeometry* valid_geom;
+  int state = 0;
+
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (!self_geom)
+  args.geom = self_data->geom;
+  if (!args.geom)
     return Qnil;
 
   // According to GEOS implementation, MakeValid always returns.
-  valid_geom = GEOSMakeValid(self_geom);
+  valid_geom =
+    (GEOSGeometry*)rgeo_without_gvl(make_valid_nogvl, &args, &state);
+  RB_GC_GUARD(self);
+  if (state) {
+    if (valid_geom) {
+      GEOSGeom_destroy_r(context, valid_geom);
+    }
+    rb_jump_tag(state);
+  }
   if (!valid_geom) {
     rb_raise(rb_eRGeoInvalidGeometry,
              "%" PRIsVALUE,
@@ -1155,6 +1687,7 @@ method_geometry_make_valid(VALUE self)
 static VALUE
 method_geometry_point_on_surface(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -1164,7 +1697,7 @@ method_geometry_point_on_surface(VALUE self)
   self_geom = self_data->geom;
   if (self_geom) {
     result = rgeo_wrap_geos_geometry(
-      self_data->factory, GEOSPointOnSurface(self_geom), Qnil);
+      self_data->factory, GEOSPointOnSurface_r(context, self_geom), Qnil);
   }
   return result;
 }
@@ -1189,16 +1722,26 @@ method_geometry_point_on_surface(VALUE self)
 static VALUE
 method_geometry_polygonize(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
+  RGeo_OperationArgs args;
   GEOSGeometry* geos_polygon_collection;
+  int state = 0;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    geos_polygon_collection = GEOSPolygonize(&self_geom, 1);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    geos_polygon_collection =
+      (GEOSGeometry*)rgeo_without_gvl(polygonize_nogvl, &args, &state);
+    RB_GC_GUARD(self);
+    if (state) {
+      if (geos_polygon_collection) {
+        GEOSGeom_destroy_r(context, geos_polygon_collection);
+      }
+      rb_jump_tag(state);
+    }
 
     if (geos_polygon_collection == NULL) {
       rb_raise(rb_eGeosError, "GEOS can't polygonize this geometry.");
@@ -1214,7 +1757,8 @@ VALUE
 rgeo_geos_geometries_strict_eql(const GEOSGeometry* geom1,
                                 const GEOSGeometry* geom2)
 {
-  switch (GEOSEqualsExact(geom1, geom2, 0.0)) {
+  GEOSContextHandle_t context = rgeo_geos_context();
+  switch (GEOSEqualsExact_r(context, geom1, geom2, 0.0)) {
     case 0:
       return Qfalse;
     case 1:
@@ -1252,11 +1796,16 @@ rgeo_init_geos_geometry()
     geos_geometry_methods, "prepare!", method_geometry_prepare, 0);
   rb_define_method(
     geos_geometry_methods, "dimension", method_geometry_dimension, 0);
+  rb_define_method(geos_geometry_methods,
+                   "coordinates_packed",
+                   method_geometry_coordinates_packed,
+                   0);
   rb_define_method(
     geos_geometry_methods, "geometry_type", method_geometry_geometry_type, 0);
   rb_define_method(geos_geometry_methods, "srid", method_geometry_srid, 0);
   rb_define_method(
     geos_geometry_methods, "envelope", method_geometry_envelope, 0);
+  rb_define_method(geos_geometry_methods, "bounds", method_geometry_bounds, 0);
   rb_define_method(
     geos_geometry_methods, "boundary", method_geometry_boundary, 0);
   rb_define_method(
@@ -1283,6 +1832,28 @@ rgeo_init_geos_geometry()
   rb_define_method(geos_geometry_methods, "within?", method_geometry_within, 1);
   rb_define_method(
     geos_geometry_methods, "contains?", method_geometry_contains, 1);
+  rb_define_method(geos_geometry_methods,
+                   "_contains_each",
+                   method_geometry_contains_each,
+                   2);
+  rb_define_method(geos_geometry_methods,
+                   "_intersects_each",
+                   method_geometry_intersects_each,
+                   2);
+  rb_define_method(
+    geos_geometry_methods, "_contains_xy?", method_geometry_contains_xy, 2);
+  rb_define_method(geos_geometry_methods,
+                   "_intersects_xy?",
+                   method_geometry_intersects_xy,
+                   2);
+  rb_define_method(geos_geometry_methods,
+                   "_contains_xy_each",
+                   method_geometry_contains_xy_each,
+                   2);
+  rb_define_method(geos_geometry_methods,
+                   "_intersects_xy_each",
+                   method_geometry_intersects_xy_each,
+                   2);
   rb_define_method(
     geos_geometry_methods, "overlaps?", method_geometry_overlaps, 1);
   rb_define_method(geos_geometry_methods, "relate?", method_geometry_relate, 2);
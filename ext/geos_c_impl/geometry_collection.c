@@ -28,6 +28,7 @@ RGEO_BEGIN_C
 static VALUE
 create_geometry_collection(VALUE module, int type, VALUE factory, VALUE array)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   unsigned int len;
   GEOSGeometry** geoms;
@@ -66,7 +67,7 @@ create_geometry_collection(VALUE module, int type, VALUE factory, VALUE array)
       rb_ary_entry(array, i), factory, cast_type, &klass, &state);
     if (state) {
       for (j = 0; j < i; j++) {
-        GEOSGeom_destroy(geoms[j]);
+        GEOSGeom_destroy_r(context, geoms[j]);
       }
       FREE(geoms);
       rb_jump_tag(state);
@@ -83,7 +84,7 @@ create_geometry_collection(VALUE module, int type, VALUE factory, VALUE array)
       rb_ary_push(klasses, klass);
     }
   }
-  collection = GEOSGeom_createCollection(type, geoms, len);
+  collection = GEOSGeom_createCollection_r(context, type, geoms, len);
   if (collection) {
     result = rgeo_wrap_geos_geometry(factory, collection, module);
     RGEO_GEOMETRY_DATA_PTR(result)->klasses = klasses;
@@ -121,17 +122,9 @@ method_geometry_collection_eql(VALUE self, VALUE rhs)
 static VALUE
 method_geometry_collection_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
-
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(
-    factory, rgeo_feature_geometry_collection_module, hash);
-  hash = rgeo_geos_geometry_collection_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+  return rgeo_geometry_hash(self,
+                            rgeo_feature_geometry_collection_module,
+                            rgeo_geos_geometry_collection_hash);
 }
 
 static VALUE
@@ -141,8 +134,8 @@ method_geometry_collection_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_geometry_collection_module;
   }
   return result;
@@ -151,6 +144,7 @@ method_geometry_collection_geometry_type(VALUE self)
 static VALUE
 method_geometry_collection_num_geometries(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -159,7 +153,7 @@ method_geometry_collection_num_geometries(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    result = INT2NUM(GEOSGetNumGeometries(self_geom));
+    result = INT2NUM(GEOSGetNumGeometries_r(context, self_geom));
   }
   return result;
 }
@@ -167,6 +161,7 @@ method_geometry_collection_num_geometries(VALUE self)
 static VALUE
 impl_geometry_n(VALUE self, VALUE n, char allow_negatives)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -181,14 +176,14 @@ impl_geometry_n(VALUE self, VALUE n, char allow_negatives)
     klasses = self_data->klasses;
     i = RB_NUM2INT(n);
     if (allow_negatives || i >= 0) {
-      len = GEOSGetNumGeometries(self_geom);
+      len = GEOSGetNumGeometries_r(context, self_geom);
       if (i < 0) {
         i += len;
       }
       if (i >= 0 && i < len) {
-        result = rgeo_wrap_geos_geometry_clone(
-          self_data->factory,
-          GEOSGetGeometryN(self_geom, i),
+        result = rgeo_wrap_geos_geometry_view(
+          self,
+          GEOSGetGeometryN_r(context, self_geom, i),
           NIL_P(klasses) ? Qnil : rb_ary_entry(klasses, i));
       }
     }
@@ -211,6 +206,7 @@ method_geometry_collection_brackets(VALUE self, VALUE n)
 static VALUE
 method_geometry_collection_each(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   RETURN_ENUMERATOR(
     self, 0, 0); /* return enum_for(__callee__) unless block_given? */
 
@@ -226,13 +222,13 @@ method_geometry_collection_each(VALUE self)
 
   self_geom = self_data->geom;
   if (self_geom) {
-    len = GEOSGetNumGeometries(self_geom);
+    len = GEOSGetNumGeometries_r(context, self_geom);
     if (len > 0) {
       klasses = self_data->klasses;
       for (i = 0; i < len; ++i) {
-        elem_geom = GEOSGetGeometryN(self_geom, i);
-        elem = rgeo_wrap_geos_geometry_clone(
-          self_data->factory,
+        elem_geom = GEOSGetGeometryN_r(context, self_geom, i);
+        elem = rgeo_wrap_geos_geometry_view(
+          self,
           elem_geom,
           NIL_P(klasses) ? Qnil : rb_ary_entry(klasses, i));
         if (!NIL_P(elem)) {
@@ -251,8 +247,8 @@ method_multi_point_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_multi_point_module;
   }
   return result;
@@ -261,21 +257,14 @@ method_multi_point_geometry_type(VALUE self)
 static VALUE
 method_multi_point_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
-
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(factory, rgeo_feature_multi_point_module, hash);
-  hash = rgeo_geos_geometry_collection_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+  return rgeo_geometry_hash(
+    self, rgeo_feature_multi_point_module, rgeo_geos_geometry_collection_hash);
 }
 
 static VALUE
 method_multi_point_coordinates(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -293,11 +282,11 @@ method_multi_point_coordinates(VALUE self)
     zCoordinate = RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
                   RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M;
 
-    count = GEOSGetNumGeometries(self_geom);
+    count = GEOSGetNumGeometries_r(context, self_geom);
     result = rb_ary_new2(count);
     for (i = 0; i < count; ++i) {
-      point = GEOSGetGeometryN(self_geom, i);
-      coord_sequence = GEOSGeom_getCoordSeq(point);
+      point = GEOSGetGeometryN_r(context, self_geom, i);
+      coord_sequence = GEOSGeom_getCoordSeq_r(context, point);
       rb_ary_push(result,
                   rb_ary_pop(extract_points_from_coordinate_sequence(
                     coord_sequence, zCoordinate)));
@@ -314,8 +303,8 @@ method_multi_line_string_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_multi_line_string_module;
   }
   return result;
@@ -324,17 +313,16 @@ method_multi_line_string_geometry_type(VALUE self)
 static VALUE
 method_multi_line_string_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
+  return rgeo_geometry_hash(self,
+                            rgeo_feature_multi_line_string_module,
+                            rgeo_geos_geometry_collection_hash);
+}
 
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(
-    factory, rgeo_feature_multi_line_string_module, hash);
-  hash = rgeo_geos_geometry_collection_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+static void*
+node_nogvl(void* geom)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  return GEOSNode_r(context, (const GEOSGeometry*)geom);
 }
 
 static VALUE
@@ -342,14 +330,12 @@ method_geometry_collection_node(VALUE self)
 {
   VALUE result = Qnil;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  GEOSGeometry* noded;
 
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
 
-  noded = GEOSNode(self_geom);
-  result = rgeo_wrap_geos_geometry(self_data->factory, noded, Qnil);
+  result = rgeo_wrap_geos_geometry_nogvl(
+    self_data->factory, node_nogvl, (void*)self_data->geom, Qnil);
+  RB_GC_GUARD(self);
 
   return result;
 }
@@ -357,6 +343,7 @@ method_geometry_collection_node(VALUE self)
 static VALUE
 method_multi_line_string_coordinates(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -373,11 +360,11 @@ method_multi_line_string_coordinates(VALUE self)
   if (self_geom) {
     zCoordinate = RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
                   RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M;
-    count = GEOSGetNumGeometries(self_geom);
+    count = GEOSGetNumGeometries_r(context, self_geom);
     result = rb_ary_new2(count);
     for (i = 0; i < count; ++i) {
-      line_string = GEOSGetGeometryN(self_geom, i);
-      coord_sequence = GEOSGeom_getCoordSeq(line_string);
+      line_string = GEOSGetGeometryN_r(context, self_geom, i);
+      coord_sequence = GEOSGeom_getCoordSeq_r(context, line_string);
       rb_ary_push(
         result,
         extract_points_from_coordinate_sequence(coord_sequence, zCoordinate));
@@ -390,6 +377,7 @@ method_multi_line_string_coordinates(VALUE self)
 static VALUE
 method_multi_line_string_length(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -399,7 +387,7 @@ method_multi_line_string_length(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    if (GEOSLength(self_geom, &len)) {
+    if (GEOSLength_r(context, self_geom, &len)) {
       result = rb_float_new(len);
     }
   }
@@ -409,6 +397,7 @@ method_multi_line_string_length(VALUE self)
 static VALUE
 method_multi_line_string_is_closed(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -421,10 +410,10 @@ method_multi_line_string_is_closed(VALUE self)
   self_geom = self_data->geom;
   if (self_geom) {
     result = Qtrue;
-    len = GEOSGetNumGeometries(self_geom);
+    len = GEOSGetNumGeometries_r(context, self_geom);
     if (len > 0) {
       for (i = 0; i < len; ++i) {
-        geom = GEOSGetGeometryN(self_geom, i);
+        geom = GEOSGetGeometryN_r(context, self_geom, i);
         if (geom) {
           result = rgeo_is_geos_line_string_closed(self_geom);
           if (result != Qtrue) {
@@ -444,8 +433,8 @@ method_multi_polygon_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_multi_polygon_module;
   }
   return result;
@@ -454,22 +443,15 @@ method_multi_polygon_geometry_type(VALUE self)
 static VALUE
 method_multi_polygon_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
-
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash =
-    rgeo_geos_objbase_hash(factory, rgeo_feature_multi_polygon_module, hash);
-  hash = rgeo_geos_geometry_collection_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+  return rgeo_geometry_hash(self,
+                            rgeo_feature_multi_polygon_module,
+                            rgeo_geos_geometry_collection_hash);
 }
 
 static VALUE
 method_multi_polygon_coordinates(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -485,10 +467,10 @@ method_multi_polygon_coordinates(VALUE self)
   if (self_geom) {
     zCoordinate = RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
                   RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M;
-    count = GEOSGetNumGeometries(self_geom);
+    count = GEOSGetNumGeometries_r(context, self_geom);
     result = rb_ary_new2(count);
     for (i = 0; i < count; ++i) {
-      poly = GEOSGetGeometryN(self_geom, i);
+      poly = GEOSGetGeometryN_r(context, self_geom, i);
       rb_ary_push(result, extract_points_from_polygon(poly, zCoordinate));
     }
   }
@@ -499,6 +481,7 @@ method_multi_polygon_coordinates(VALUE self)
 static VALUE
 method_multi_polygon_area(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -508,7 +491,7 @@ method_multi_polygon_area(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    if (GEOSArea(self_geom, &area)) {
+    if (GEOSArea_r(context, self_geom, &area)) {
       result = rb_float_new(area);
     }
   }
@@ -518,6 +501,7 @@ method_multi_polygon_area(VALUE self)
 static VALUE
 method_multi_polygon_centroid(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -527,7 +511,7 @@ method_multi_polygon_centroid(VALUE self)
   self_geom = self_data->geom;
   if (self_geom) {
     result = rgeo_wrap_geos_geometry(
-      self_data->factory, GEOSGetCentroid(self_geom), Qnil);
+      self_data->factory, GEOSGetCentroid_r(context, self_geom), Qnil);
   }
   return result;
 }
@@ -684,17 +668,18 @@ rgeo_init_geos_geometry_collection()
 st_index_t
 rgeo_geos_geometry_collection_hash(const GEOSGeometry* geom, st_index_t hash)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   const GEOSGeometry* sub_geom;
   int type;
   unsigned int len;
   unsigned int i;
 
   if (geom) {
-    len = GEOSGetNumGeometries(geom);
+    len = GEOSGetNumGeometries_r(context, geom);
     for (i = 0; i < len; ++i) {
-      sub_geom = GEOSGetGeometryN(geom, i);
+      sub_geom = GEOSGetGeometryN_r(context, geom, i);
       if (sub_geom) {
-        type = GEOSGeomTypeId(sub_geom);
+        type = GEOSGeomTypeId_r(context, sub_geom);
         if (type >= 0) {
           hash = hash ^ type;
           switch (type) {
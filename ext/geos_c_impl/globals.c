@@ -2,14 +2,18 @@
 
 #ifdef RGEO_GEOS_SUPPORTED
 
-#include <ctype.h>
 #include <geos_c.h>
 #include <ruby.h>
-#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "errors.h"
 #include "globals.h"
+#include "nogvl.h"
 
 RGEO_BEGIN_C
 
@@ -44,54 +48,142 @@ VALUE rgeo_geos_multi_polygon_class;
 // We still set it to make sure we do not miss any implementation
 // change. Use `DEBUG=1 rake` to show notice.
 static void
-notice_handler(const char* fmt, ...)
+notice_handler(const char* message, void* userdata)
 {
 #ifdef DEBUG
-  va_list args;
-  va_start(args, fmt);
-  fprintf(stderr, "GEOS Notice -- ");
-  vfprintf(stderr, fmt, args);
-  fprintf(stderr, "\n");
-  va_end(args);
+  fprintf(stderr, "GEOS Notice -- %s\n", message);
+#endif
+}
+
+static void
+error_handler(const char* message, void* userdata)
+{
+  // Ruby exceptions cannot be raised without the GVL, the error is raised
+  // once the GEOS call returns instead.
+  if (rgeo_nogvl_capture_error(message)) {
+    return;
+  }
+
+  // rgeo_raise_geos_error modifies the message, it is owned by GEOS.
+  char geos_full_error[strlen(message) + 1];
+  strcpy(geos_full_error, message);
+  rgeo_raise_geos_error(geos_full_error);
+}
+
+// GEOS calls the interrupt handlers from time to time during long
+// operations, on the thread running them, see rgeo_nogvl_interrupted.
+#ifdef RGEO_GEOS_SUPPORTS_CONTEXT_INTERRUPT
+
+static int
+interrupt_handler(void* userdata)
+{
+  return rgeo_nogvl_interrupted();
+}
+
+#elif defined(RGEO_GEOS_SUPPORTS_NOGVL)
+
+// Before GEOS 3.14 the handler is global, and so is the interrupt request,
+// which GEOS checks right after calling the handler on the thread checking
+// for interrupts. A thread that is not interrupted cancels the request of
+// another one, which requests it again at its next check, so that calls
+// made with the GVL held, which cannot be run again, are not stopped in
+// its place. A request made between the two is still seen by the wrong
+// thread: rgeo_without_gvl then runs its call again, and other calls fail
+// with a GeosError. Handlers registered before rgeo are still called.
+static GEOSInterruptCallback* previous_interrupt_handler;
+
+static void
+interrupt_handler()
+{
+  if (rgeo_nogvl_interrupted()) {
+    GEOS_interruptRequest();
+    return;
+  }
+  GEOS_interruptCancel();
+  if (previous_interrupt_handler) {
+    previous_interrupt_handler();
+  }
+}
+
+#endif
+
+static GEOSContextHandle_t
+create_context()
+{
+  GEOSContextHandle_t context;
+
+  context = GEOS_init_r();
+  GEOSContext_setNoticeMessageHandler_r(context, notice_handler, NULL);
+  GEOSContext_setErrorMessageHandler_r(context, error_handler, NULL);
+#ifdef RGEO_GEOS_SUPPORTS_CONTEXT_INTERRUPT
+  GEOSContext_setInterruptCallback_r(context, interrupt_handler, NULL);
 #endif
+  return context;
 }
 
-NORETURN(static void error_handler(const char* fmt, ...))
+#ifdef HAVE_PTHREAD_H
+
+// Each native thread gets its own GEOS context, so that GEOS calls made
+// while the GVL is released never share one. Contexts are destroyed when
+// their thread exits.
+static pthread_key_t context_key;
+
+static void
+destroy_context(void* context)
 {
-  // See https://en.cppreference.com/w/c/io/vfprintf
-  va_list args1;
-  va_start(args1, fmt);
-  va_list args2;
-  va_copy(args2, args1);
-  int size = 1 + vsnprintf(NULL, 0, fmt, args1);
-  va_end(args1);
-  char geos_full_error[size];
-  vsnprintf(geos_full_error, sizeof geos_full_error, fmt, args2);
-  va_end(args2);
-
-  // NOTE: strtok is destructive, geos_full_error is not to be used afterwards.
-  char* geos_error = strtok(geos_full_error, ":");
-  char* geos_message = strtok(NULL, ":");
-  while (isspace(*geos_message))
-    geos_message++;
-
-  if (streq(geos_error, "UnsupportedOperationException")) {
-    rb_raise(rb_eRGeoUnsupportedOperation, "%s", geos_message);
-  } else if (streq(geos_error, "IllegalArgumentException")) {
-    rb_raise(rb_eRGeoInvalidGeometry, "%s", geos_message);
-  } else if (streq(geos_error, "ParseException")) {
-    rb_raise(rb_eRGeoParseError, "%s", geos_message);
-  } else if (geos_message) {
-    rb_raise(rb_eGeosError, "%s: %s", geos_error, geos_message);
-  } else {
-    rb_raise(rb_eGeosError, "%s", geos_error);
+  GEOS_finish_r((GEOSContextHandle_t)context);
+}
+
+GEOSContextHandle_t
+rgeo_geos_context()
+{
+  GEOSContextHandle_t context;
+
+  context = (GEOSContextHandle_t)pthread_getspecific(context_key);
+  if (!context) {
+    context = create_context();
+    pthread_setspecific(context_key, context);
   }
+  return context;
 }
 
+static void
+init_contexts()
+{
+  if (pthread_key_create(&context_key, destroy_context)) {
+    rb_raise(rb_eRuntimeError, "Unable to create the GEOS context key");
+  }
+}
+
+#else
+
+// Without thread specific data, a single context is shared. The GVL is
+// never released around GEOS calls in that case, see nogvl.h.
+static GEOSContextHandle_t global_context;
+
+GEOSContextHandle_t
+rgeo_geos_context()
+{
+  return global_context;
+}
+
+static void
+init_contexts()
+{
+  global_context = create_context();
+}
+
+#endif // HAVE_PTHREAD_H
+
 void
 rgeo_init_geos_globals()
 {
-  initGEOS(notice_handler, error_handler);
+  init_contexts();
+#if !defined(RGEO_GEOS_SUPPORTS_CONTEXT_INTERRUPT) &&                          \
+  defined(RGEO_GEOS_SUPPORTS_NOGVL)
+  previous_interrupt_handler =
+    GEOS_interruptRegisterCallback(interrupt_handler);
+#endif
 
   rgeo_module = rb_define_module("RGeo");
   rb_gc_register_mark_object(rgeo_module);
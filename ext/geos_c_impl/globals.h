@@ -38,6 +38,15 @@ extern VALUE rgeo_geos_multi_point_class;
 extern VALUE rgeo_geos_multi_line_string_class;
 extern VALUE rgeo_geos_multi_polygon_class;
 
+/*
+  Returns the GEOS context of the current native thread, creating it on
+  first use. Every GEOS call goes through the reentrant `*_r` API with
+  this context. Contexts are not shared between threads, so a context
+  must not be kept around across calls that may switch threads.
+*/
+GEOSContextHandle_t
+rgeo_geos_context();
+
 void
 rgeo_init_geos_globals();
 
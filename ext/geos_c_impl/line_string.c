@@ -7,6 +7,7 @@
 #ifdef RGEO_GEOS_SUPPORTED
 
 #include <geos_c.h>
+#include <limits.h>
 #include <ruby.h>
 #include <string.h>
 
@@ -26,8 +27,8 @@ method_line_string_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_line_string_module;
   }
   return result;
@@ -40,8 +41,8 @@ method_linear_ring_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_linear_ring_module;
   }
   return result;
@@ -54,8 +55,8 @@ method_line_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_line_module;
   }
   return result;
@@ -64,6 +65,7 @@ method_line_geometry_type(VALUE self)
 static VALUE
 method_line_string_length(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -73,7 +75,7 @@ method_line_string_length(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    if (GEOSLength(self_geom, &len)) {
+    if (GEOSLength_r(context, self_geom, &len)) {
       result = rb_float_new(len);
     }
   }
@@ -83,6 +85,7 @@ method_line_string_length(VALUE self)
 static VALUE
 method_line_string_num_points(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -91,7 +94,7 @@ method_line_string_num_points(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    result = INT2NUM(GEOSGetNumCoordinates(self_geom));
+    result = INT2NUM(GEOSGetNumCoordinates_r(context, self_geom));
   }
   return result;
 }
@@ -99,6 +102,7 @@ method_line_string_num_points(VALUE self)
 static VALUE
 method_line_string_coordinates(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -112,7 +116,7 @@ method_line_string_coordinates(VALUE self)
   if (self_geom) {
     zCoordinate = RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
                   RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M;
-    coord_sequence = GEOSGeom_getCoordSeq(self_geom);
+    coord_sequence = GEOSGeom_getCoordSeq_r(context, self_geom);
     if (coord_sequence) {
       result =
         extract_points_from_coordinate_sequence(coord_sequence, zCoordinate);
@@ -125,24 +129,25 @@ static VALUE
 get_point_from_coordseq(VALUE self,
                         const GEOSCoordSequence* coord_seq,
                         unsigned int i,
-                        char has_z)
+                        int dims)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
-  double x, y, z;
+  double x, y, z, m;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (GEOSCoordSeq_getX(coord_seq, i, &x)) {
-    if (GEOSCoordSeq_getY(coord_seq, i, &y)) {
-      if (has_z) {
-        if (!GEOSCoordSeq_getZ(coord_seq, i, &z)) {
-          z = 0.0;
-        }
-      } else {
+  if (GEOSCoordSeq_getX_r(context, coord_seq, i, &x)) {
+    if (GEOSCoordSeq_getY_r(context, coord_seq, i, &y)) {
+      if (dims < 3 || !GEOSCoordSeq_getZ_r(context, coord_seq, i, &z)) {
         z = 0.0;
       }
-      result = rgeo_create_geos_point(self_data->factory, x, y, z);
+      if (dims < 4 ||
+          !GEOSCoordSeq_getOrdinate_r(context, coord_seq, i, 3, &m)) {
+        m = 0.0;
+      }
+      result = rgeo_create_geos_point(self_data->factory, x, y, z, m);
     }
   }
   return result;
@@ -151,11 +156,12 @@ get_point_from_coordseq(VALUE self,
 static VALUE
 method_line_string_point_n(VALUE self, VALUE n)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
   const GEOSCoordSequence* coord_seq;
-  char has_z;
+  int dims;
   int si;
   unsigned int i;
   unsigned int size;
@@ -164,16 +170,16 @@ method_line_string_point_n(VALUE self, VALUE n)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    coord_seq = GEOSGeom_getCoordSeq(self_geom);
+    coord_seq = GEOSGeom_getCoordSeq_r(context, self_geom);
     if (coord_seq) {
-      has_z = (char)(RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
-                     RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M);
+      dims =
+        RGEO_FACTORY_DIMS(RGEO_FACTORY_DATA_PTR(self_data->factory)->flags);
       si = RB_NUM2INT(n);
       if (si >= 0) {
         i = si;
-        if (GEOSCoordSeq_getSize(coord_seq, &size)) {
+        if (GEOSCoordSeq_getSize_r(context, coord_seq, &size)) {
           if (i < size) {
-            result = get_point_from_coordseq(self, coord_seq, i, has_z);
+            result = get_point_from_coordseq(self, coord_seq, i, dims);
           }
         }
       }
@@ -185,11 +191,12 @@ method_line_string_point_n(VALUE self, VALUE n)
 static VALUE
 method_line_string_points(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
   const GEOSCoordSequence* coord_seq;
-  char has_z;
+  int dims;
   unsigned int size;
   unsigned int i;
   VALUE point;
@@ -198,14 +205,14 @@ method_line_string_points(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    coord_seq = GEOSGeom_getCoordSeq(self_geom);
+    coord_seq = GEOSGeom_getCoordSeq_r(context, self_geom);
     if (coord_seq) {
-      has_z = (char)(RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
-                     RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M);
-      if (GEOSCoordSeq_getSize(coord_seq, &size)) {
+      dims =
+        RGEO_FACTORY_DIMS(RGEO_FACTORY_DATA_PTR(self_data->factory)->flags);
+      if (GEOSCoordSeq_getSize_r(context, coord_seq, &size)) {
         result = rb_ary_new2(size);
         for (i = 0; i < size; ++i) {
-          point = get_point_from_coordseq(self, coord_seq, i, has_z);
+          point = get_point_from_coordseq(self, coord_seq, i, dims);
           if (!NIL_P(point)) {
             rb_ary_store(result, i, point);
           }
@@ -225,6 +232,7 @@ method_line_string_start_point(VALUE self)
 static VALUE
 method_line_string_end_point(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -234,7 +242,7 @@ method_line_string_end_point(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    n = GEOSGetNumCoordinates(self_geom);
+    n = GEOSGetNumCoordinates_r(context, self_geom);
     if (n > 0) {
       result = method_line_string_point_n(self, INT2NUM(n - 1));
     }
@@ -245,6 +253,7 @@ method_line_string_end_point(VALUE self)
 static VALUE
 method_line_string_project_point(VALUE self, VALUE point)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
   VALUE factory;
   RGeo_GeometryData* self_data;
@@ -265,7 +274,7 @@ method_line_string_project_point(VALUE self, VALUE point)
       rb_jump_tag(state);
     }
 
-    location = GEOSProject(self_geom, geos_point);
+    location = GEOSProject_r(context, self_geom, geos_point);
     result = DBL2NUM(location);
   }
   return result;
@@ -274,6 +283,7 @@ method_line_string_project_point(VALUE self, VALUE point)
 static VALUE
 method_line_string_interpolate_point(VALUE self, VALUE loc_num)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
   VALUE factory;
   RGeo_GeometryData* self_data;
@@ -288,7 +298,7 @@ method_line_string_interpolate_point(VALUE self, VALUE loc_num)
   self_geom = self_data->geom;
 
   if (self_geom) {
-    geos_point = GEOSInterpolate(self_geom, location);
+    geos_point = GEOSInterpolate_r(context, self_geom, location);
     result =
       rgeo_wrap_geos_geometry(factory, geos_point, rgeo_geos_point_class);
   }
@@ -315,6 +325,7 @@ method_line_string_is_closed(VALUE self)
 static VALUE
 method_line_string_is_ring(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -324,7 +335,7 @@ method_line_string_is_ring(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    val = GEOSisRing(self_geom);
+    val = GEOSisRing_r(context, self_geom);
     if (val == 0) {
       result = Qfalse;
     } else if (val == 1) {
@@ -352,54 +363,60 @@ method_line_string_eql(VALUE self, VALUE rhs)
 static VALUE
 method_line_string_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
-
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(factory, rgeo_feature_line_string_module, hash);
-  hash = rgeo_geos_coordseq_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+  return rgeo_geometry_hash(
+    self, rgeo_feature_line_string_module, rgeo_geos_coordseq_hash);
 }
 
 static VALUE
 method_linear_ring_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
-
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(factory, rgeo_feature_linear_ring_module, hash);
-  hash = rgeo_geos_coordseq_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+  return rgeo_geometry_hash(
+    self, rgeo_feature_linear_ring_module, rgeo_geos_coordseq_hash);
 }
 
 static VALUE
 method_line_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
+  return rgeo_geometry_hash(
+    self, rgeo_feature_line_module, rgeo_geos_coordseq_hash);
+}
 
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(factory, rgeo_feature_line_module, hash);
-  hash = rgeo_geos_coordseq_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+// Copies count coordinates of dims ordinates (xy, xyz or xyzm) from the
+// buffer into a sequence of the same dimension.
+
+static GEOSCoordSequence*
+coord_seq_from_buffer(const double* buffer, unsigned int count, int dims)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSCoordSequence* coord_seq;
+#ifndef RGEO_GEOS_SUPPORTS_COORDSEQ_BUFFER
+  unsigned int i;
+#endif
+
+#ifdef RGEO_GEOS_SUPPORTS_COORDSEQ_BUFFER
+  coord_seq = GEOSCoordSeq_copyFromBuffer_r(
+    context, buffer, count, dims >= 3, dims == 4);
+#else
+  coord_seq = GEOSCoordSeq_create_r(context, count, dims);
+  if (coord_seq) {
+    for (i = 0; i < count; ++i) {
+      GEOSCoordSeq_setX_r(context, coord_seq, i, buffer[i * dims]);
+      GEOSCoordSeq_setY_r(context, coord_seq, i, buffer[i * dims + 1]);
+      if (dims >= 3) {
+        GEOSCoordSeq_setZ_r(context, coord_seq, i, buffer[i * dims + 2]);
+      }
+    }
+  }
+#endif
+  return coord_seq;
 }
 
 static GEOSCoordSequence*
 coord_seq_from_array(VALUE factory, VALUE array, char close)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE point_type;
   unsigned int len;
-  char has_z;
   unsigned int dims;
   double* coords;
   unsigned int i;
@@ -413,10 +430,8 @@ coord_seq_from_array(VALUE factory, VALUE array, char close)
   Check_Type(array, T_ARRAY);
   point_type = rgeo_feature_point_module;
   len = (unsigned int)RARRAY_LEN(array);
-  has_z = (char)(RGEO_FACTORY_DATA_PTR(factory)->flags &
-                 RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M);
-  dims = has_z ? 3 : 2;
-  coords = ALLOC_N(double, len == 0 ? 1 : len * dims);
+  dims = RGEO_FACTORY_DIMS(RGEO_FACTORY_DATA_PTR(factory)->flags);
+  coords = ALLOC_N(double, (len + 1) * dims);
   if (!coords) {
     return NULL;
   }
@@ -430,20 +445,27 @@ coord_seq_from_array(VALUE factory, VALUE array, char close)
       rb_jump_tag(state);
     }
 
-    entry_cs = GEOSGeom_getCoordSeq(entry_geom);
+    entry_cs = GEOSGeom_getCoordSeq_r(context, entry_geom);
     if (entry_cs) {
-      if (GEOSCoordSeq_getX(entry_cs, 0, &x)) {
+      if (GEOSCoordSeq_getX_r(context, entry_cs, 0, &x)) {
         coords[i * dims] = x;
-        if (GEOSCoordSeq_getY(entry_cs, 0, &x)) {
+        if (GEOSCoordSeq_getY_r(context, entry_cs, 0, &x)) {
           coords[i * dims + 1] = x;
           good = 1;
-          if (has_z) {
-            if (GEOSCoordSeq_getZ(entry_cs, 0, &x)) {
+          if (dims >= 3) {
+            if (GEOSCoordSeq_getZ_r(context, entry_cs, 0, &x)) {
               coords[i * dims + 2] = x;
             } else {
               good = 0;
             }
           }
+          if (dims == 4) {
+            if (GEOSCoordSeq_getOrdinate_r(context, entry_cs, 0, 3, &x)) {
+              coords[i * dims + 3] = x;
+            } else {
+              good = 0;
+            }
+          }
         }
       }
     }
@@ -452,27 +474,13 @@ coord_seq_from_array(VALUE factory, VALUE array, char close)
       return NULL;
     }
   }
-  if (len > 0 && close) {
-    if (coords[0] == coords[(len - 1) * dims] &&
-        coords[1] == coords[(len - 1) * dims + 1]) {
-      close = 0;
-    }
-  } else {
-    close = 0;
-  }
-  coord_seq = GEOSCoordSeq_create(len + close, 3);
-  if (coord_seq) {
-    for (i = 0; i < len; ++i) {
-      GEOSCoordSeq_setX(coord_seq, i, coords[i * dims]);
-      GEOSCoordSeq_setY(coord_seq, i, coords[i * dims + 1]);
-      GEOSCoordSeq_setZ(coord_seq, i, has_z ? coords[i * dims + 2] : 0);
-    }
-    if (close) {
-      GEOSCoordSeq_setX(coord_seq, len, coords[0]);
-      GEOSCoordSeq_setY(coord_seq, len, coords[1]);
-      GEOSCoordSeq_setZ(coord_seq, len, has_z ? coords[2] : 0);
-    }
+  if (len > 0 && close &&
+      (coords[0] != coords[(len - 1) * dims] ||
+       coords[1] != coords[(len - 1) * dims + 1])) {
+    memcpy(&coords[len * dims], coords, dims * sizeof(double));
+    ++len;
   }
+  coord_seq = coord_seq_from_buffer(coords, len, (int)dims);
   FREE(coords);
   return coord_seq;
 }
@@ -480,6 +488,7 @@ coord_seq_from_array(VALUE factory, VALUE array, char close)
 static VALUE
 cmethod_create_line_string(VALUE module, VALUE factory, VALUE array)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   GEOSCoordSequence* coord_seq;
   GEOSGeometry* geom;
@@ -487,7 +496,7 @@ cmethod_create_line_string(VALUE module, VALUE factory, VALUE array)
   result = Qnil;
   coord_seq = coord_seq_from_array(factory, array, 0);
   if (coord_seq) {
-    geom = GEOSGeom_createLineString(coord_seq);
+    geom = GEOSGeom_createLineString_r(context, coord_seq);
     if (geom) {
       result =
         rgeo_wrap_geos_geometry(factory, geom, rgeo_geos_line_string_class);
@@ -499,6 +508,7 @@ cmethod_create_line_string(VALUE module, VALUE factory, VALUE array)
 static VALUE
 cmethod_create_linear_ring(VALUE module, VALUE factory, VALUE array)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   GEOSCoordSequence* coord_seq;
   GEOSGeometry* geom;
@@ -506,7 +516,154 @@ cmethod_create_linear_ring(VALUE module, VALUE factory, VALUE array)
   result = Qnil;
   coord_seq = coord_seq_from_array(factory, array, 1);
   if (coord_seq) {
-    geom = GEOSGeom_createLinearRing(coord_seq);
+    geom = GEOSGeom_createLinearRing_r(context, coord_seq);
+    if (geom) {
+      result =
+        rgeo_wrap_geos_geometry(factory, geom, rgeo_geos_linear_ring_class);
+    }
+  }
+  return result;
+}
+
+// Reads count points of dims numbers from coords into buffer, with
+// out_dims numbers per point, the missing ones being 0. Called with a
+// constant out_dims, so that the xy, xyz and xyzm loops are specialised
+// when inlined.
+
+static inline void
+read_coords(double* buffer, VALUE coords, long count, int dims, int out_dims)
+{
+  long i;
+  int j;
+
+  for (i = 0; i < count; ++i) {
+    for (j = dims; j < out_dims; ++j) {
+      buffer[i * out_dims + j] = 0;
+    }
+    for (j = 0; j < dims && j < out_dims; ++j) {
+      if (RB_TYPE_P(coords, T_STRING)) {
+        // The string buffer may not be aligned for doubles.
+        memcpy(&buffer[i * out_dims + j],
+               RSTRING_PTR(coords) + (i * dims + j) * sizeof(double),
+               sizeof(double));
+      } else {
+        buffer[i * out_dims + j] =
+          rb_num2dbl(rb_ary_entry(coords, i * dims + j));
+      }
+    }
+  }
+}
+
+GEOSCoordSequence*
+rgeo_coord_seq_from_coords(VALUE factory, VALUE coords, int dims, char close)
+{
+  int out_dims;
+  int max_dims;
+  long len;
+  long count;
+  double* buffer;
+  VALUE buffer_holder;
+  GEOSCoordSequence* coord_seq;
+
+  // A fourth number, M, is only read by factories with both Z and M.
+  out_dims = RGEO_FACTORY_DIMS(RGEO_FACTORY_DATA_PTR(factory)->flags);
+  max_dims = out_dims == 4 ? 4 : 3;
+  if (dims < 2 || dims > max_dims) {
+    rb_raise(rb_eArgError,
+             "Coordinates must have 2 to %d dimensions, got %d",
+             max_dims,
+             dims);
+  }
+  if (RB_TYPE_P(coords, T_STRING)) {
+    len = RSTRING_LEN(coords) / (long)sizeof(double);
+    if (RSTRING_LEN(coords) % (dims * sizeof(double)) != 0) {
+      rb_raise(rb_eArgError,
+               "Packed coordinates must hold %d doubles per point, got %ld "
+               "bytes",
+               dims,
+               RSTRING_LEN(coords));
+    }
+  } else {
+    Check_Type(coords, T_ARRAY);
+    len = RARRAY_LEN(coords);
+    if (len % dims != 0) {
+      rb_raise(rb_eArgError,
+               "Coordinates must hold %d numbers per point, got %ld numbers",
+               dims,
+               len);
+    }
+  }
+  count = len / dims;
+  if (count >= UINT_MAX) {
+    rb_raise(rb_eArgError, "Too many coordinates");
+  }
+
+  // One pass over the input, into the xy, xyz or xyzm layout of the
+  // sequences of the factory. The ALLOCV buffer is released by the GC if a
+  // conversion raises.
+  buffer = ALLOCV_N(double, buffer_holder, (count + 1) * out_dims);
+  switch (out_dims) {
+    case 2:
+      read_coords(buffer, coords, count, dims, 2);
+      break;
+    case 3:
+      read_coords(buffer, coords, count, dims, 3);
+      break;
+    default:
+      read_coords(buffer, coords, count, dims, 4);
+      break;
+  }
+  if (close && count > 0 &&
+      (buffer[0] != buffer[(count - 1) * out_dims] ||
+       buffer[1] != buffer[(count - 1) * out_dims + 1])) {
+    memcpy(&buffer[count * out_dims], buffer, out_dims * sizeof(double));
+    ++count;
+  }
+
+  coord_seq = coord_seq_from_buffer(buffer, (unsigned int)count, out_dims);
+  ALLOCV_END(buffer_holder);
+  RB_GC_GUARD(coords);
+  return coord_seq;
+}
+
+static VALUE
+cmethod_create_line_string_from_coords(VALUE module,
+                                       VALUE factory,
+                                       VALUE coords,
+                                       VALUE dims)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  VALUE result;
+  GEOSCoordSequence* coord_seq;
+  GEOSGeometry* geom;
+
+  result = Qnil;
+  coord_seq = rgeo_coord_seq_from_coords(factory, coords, NUM2INT(dims), 0);
+  if (coord_seq) {
+    geom = GEOSGeom_createLineString_r(context, coord_seq);
+    if (geom) {
+      result =
+        rgeo_wrap_geos_geometry(factory, geom, rgeo_geos_line_string_class);
+    }
+  }
+  return result;
+}
+
+static VALUE
+cmethod_create_linear_ring_from_coords(VALUE module,
+                                       VALUE factory,
+                                       VALUE coords,
+                                       VALUE dims)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  VALUE result;
+  GEOSCoordSequence* coord_seq;
+  GEOSGeometry* geom;
+
+  result = Qnil;
+  coord_seq = rgeo_coord_seq_from_coords(factory, coords, NUM2INT(dims), 1);
+  if (coord_seq) {
+    geom = GEOSGeom_createLinearRing_r(context, coord_seq);
     if (geom) {
       result =
         rgeo_wrap_geos_geometry(factory, geom, rgeo_geos_linear_ring_class);
@@ -519,35 +676,30 @@ static void
 populate_geom_into_coord_seq(const GEOSGeometry* geom,
                              GEOSCoordSequence* coord_seq,
                              unsigned int i,
-                             char has_z)
+                             int dims)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   const GEOSCoordSequence* cs;
   double x;
+  int d;
 
-  cs = GEOSGeom_getCoordSeq(geom);
-  x = 0;
-  if (cs) {
-    GEOSCoordSeq_getX(cs, 0, &x);
-  }
-  GEOSCoordSeq_setX(coord_seq, i, x);
-  x = 0;
-  if (cs) {
-    GEOSCoordSeq_getY(cs, 0, &x);
-  }
-  GEOSCoordSeq_setY(coord_seq, i, x);
-  x = 0;
-  if (has_z && cs) {
-    GEOSCoordSeq_getZ(cs, 0, &x);
+  cs = GEOSGeom_getCoordSeq_r(context, geom);
+  for (d = 0; d < dims; ++d) {
+    x = 0;
+    if (cs) {
+      GEOSCoordSeq_getOrdinate_r(context, cs, 0, d, &x);
+    }
+    GEOSCoordSeq_setOrdinate_r(context, coord_seq, i, d, x);
   }
-  GEOSCoordSeq_setZ(coord_seq, i, x);
 }
 
 static VALUE
 cmethod_create_line(VALUE module, VALUE factory, VALUE start, VALUE end)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_FactoryData* factory_data;
-  char has_z;
+  int dims;
   VALUE point_type;
   const GEOSGeometry* start_geom;
   const GEOSGeometry* end_geom;
@@ -557,7 +709,7 @@ cmethod_create_line(VALUE module, VALUE factory, VALUE start, VALUE end)
 
   result = Qnil;
   factory_data = RGEO_FACTORY_DATA_PTR(factory);
-  has_z = (char)(factory_data->flags & RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M);
+  dims = RGEO_FACTORY_DIMS(factory_data->flags);
   point_type = rgeo_feature_point_module;
 
   start_geom =
@@ -571,11 +723,11 @@ cmethod_create_line(VALUE module, VALUE factory, VALUE start, VALUE end)
     rb_jump_tag(state);
   }
 
-  coord_seq = GEOSCoordSeq_create(2, 3);
+  coord_seq = GEOSCoordSeq_create_r(context, 2, dims);
   if (coord_seq) {
-    populate_geom_into_coord_seq(start_geom, coord_seq, 0, has_z);
-    populate_geom_into_coord_seq(end_geom, coord_seq, 1, has_z);
-    geom = GEOSGeom_createLineString(coord_seq);
+    populate_geom_into_coord_seq(start_geom, coord_seq, 0, dims);
+    populate_geom_into_coord_seq(end_geom, coord_seq, 1, dims);
+    geom = GEOSGeom_createLineString_r(context, coord_seq);
     if (geom) {
       result = rgeo_wrap_geos_geometry(factory, geom, rgeo_geos_line_class);
     }
@@ -587,6 +739,7 @@ cmethod_create_line(VALUE module, VALUE factory, VALUE start, VALUE end)
 static VALUE
 impl_copy_from(VALUE klass, VALUE factory, VALUE original, char subtype)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   const GEOSGeometry* original_geom;
   const GEOSCoordSequence* original_coord_seq;
@@ -596,16 +749,16 @@ impl_copy_from(VALUE klass, VALUE factory, VALUE original, char subtype)
   result = Qnil;
   original_geom = RGEO_GEOMETRY_DATA_PTR(original)->geom;
   if (original_geom) {
-    if (subtype == 1 && GEOSGetNumCoordinates(original_geom) != 2) {
+    if (subtype == 1 && GEOSGetNumCoordinates_r(context, original_geom) != 2) {
       original_geom = NULL;
     }
     if (original_geom) {
-      original_coord_seq = GEOSGeom_getCoordSeq(original_geom);
+      original_coord_seq = GEOSGeom_getCoordSeq_r(context, original_geom);
       if (original_coord_seq) {
-        coord_seq = GEOSCoordSeq_clone(original_coord_seq);
+        coord_seq = GEOSCoordSeq_clone_r(context, original_coord_seq);
         if (coord_seq) {
-          geom = subtype == 2 ? GEOSGeom_createLinearRing(coord_seq)
-                              : GEOSGeom_createLineString(coord_seq);
+          geom = subtype == 2 ? GEOSGeom_createLinearRing_r(context, coord_seq)
+                              : GEOSGeom_createLineString_r(context, coord_seq);
           if (geom) {
             result = rgeo_wrap_geos_geometry(factory, geom, klass);
           }
@@ -648,6 +801,10 @@ rgeo_init_geos_line_string()
                             "_copy_from",
                             cmethod_line_string_copy_from,
                             2);
+  rb_define_module_function(rgeo_geos_line_string_class,
+                            "_create_from_coords",
+                            cmethod_create_line_string_from_coords,
+                            3);
 
   // Class methods for CAPILinearRingImpl
   rb_define_module_function(
@@ -656,6 +813,10 @@ rgeo_init_geos_line_string()
                             "_copy_from",
                             cmethod_linear_ring_copy_from,
                             2);
+  rb_define_module_function(rgeo_geos_linear_ring_class,
+                            "_create_from_coords",
+                            cmethod_create_linear_ring_from_coords,
+                            3);
 
   // Class methods for CAPILineImpl
   rb_define_module_function(
@@ -723,20 +884,21 @@ rgeo_init_geos_line_string()
 VALUE
 rgeo_is_geos_line_string_closed(const GEOSGeometry* geom)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   unsigned int n;
   double x1, x2, y1, y2;
   const GEOSCoordSequence* coord_seq;
 
   result = Qnil;
-  n = GEOSGetNumCoordinates(geom);
+  n = GEOSGetNumCoordinates_r(context, geom);
   if (n > 0) {
-    coord_seq = GEOSGeom_getCoordSeq(geom);
-    if (GEOSCoordSeq_getX(coord_seq, 0, &x1)) {
-      if (GEOSCoordSeq_getX(coord_seq, n - 1, &x2)) {
+    coord_seq = GEOSGeom_getCoordSeq_r(context, geom);
+    if (GEOSCoordSeq_getX_r(context, coord_seq, 0, &x1)) {
+      if (GEOSCoordSeq_getX_r(context, coord_seq, n - 1, &x2)) {
         if (x1 == x2) {
-          if (GEOSCoordSeq_getY(coord_seq, 0, &y1)) {
-            if (GEOSCoordSeq_getY(coord_seq, n - 1, &y2)) {
+          if (GEOSCoordSeq_getY_r(context, coord_seq, 0, &y1)) {
+            if (GEOSCoordSeq_getY_r(context, coord_seq, n - 1, &y2)) {
               result = y1 == y2 ? Qtrue : Qfalse;
             }
           }
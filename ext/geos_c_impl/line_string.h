@@ -24,6 +24,18 @@ rgeo_init_geos_line_string();
 VALUE
 rgeo_is_geos_line_string_closed(const GEOSGeometry* geom);
 
+/*
+  Creates a GEOS coordinate sequence for the given factory from flat
+  coordinates, given either as an array of numbers or as a binary string
+  of native doubles (as given by pack("d*")), with dims (2 or 3) numbers
+  per point. The third number is Z, or M for factories with M but no Z,
+  and is ignored by 2D factories. If close is set, the first point is
+  appended when it differs from the last one. Raises on invalid input;
+  returns NULL if GEOS fails to create the sequence.
+*/
+GEOSCoordSequence*
+rgeo_coord_seq_from_coords(VALUE factory, VALUE coords, int dims, char close);
+
 RGEO_END_C
 
 #endif
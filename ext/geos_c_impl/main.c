@@ -12,6 +12,7 @@
 #include "analysis.h"
 #include "errors.h"
 #include "factory.h"
+#include "geojson.h"
 #include "geometry.h"
 #include "geometry_collection.h"
 #include "globals.h"
@@ -19,6 +20,8 @@
 #include "point.h"
 #include "polygon.h"
 #include "ruby_more.h"
+#include "strtree.h"
+#include "twkb.h"
 
 #endif
 
@@ -36,6 +39,9 @@ Init_geos_c_impl()
   rgeo_init_geos_polygon();
   rgeo_init_geos_geometry_collection();
   rgeo_init_geos_analysis();
+  rgeo_init_geos_strtree();
+  rgeo_init_geos_twkb();
+  rgeo_init_geos_geojson();
   rgeo_init_geos_errors();
 #endif
 }
@@ -0,0 +1,257 @@
+/*
+  Running GEOS operations without the GVL
+*/
+
+// clock_gettime is POSIX, which -std=c17 does not declare by default.
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "preface.h"
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+#include <math.h>
+#include <ruby.h>
+#include <ruby/thread.h>
+#include <string.h>
+#include <time.h>
+
+#include "errors.h"
+#include "nogvl.h"
+
+RGEO_BEGIN_C
+
+// Reasons for which GEOS is asked to stop a call, see nogvl_unblock and
+// rgeo_nogvl_interrupted.
+#define NOGVL_INTERRUPT_RUBY 1
+#define NOGVL_INTERRUPT_DEADLINE 2
+
+// Start of the error GEOS reports for an interrupted call.
+#define NOGVL_INTERRUPTED_ERROR "InterruptedException"
+
+typedef struct
+{
+  void* (*func)(void*);
+  void* data;
+  void* result;
+  // CLOCK_MONOTONIC time in seconds, or HUGE_VAL without a deadline.
+  double deadline;
+  volatile int interrupt;
+  char ran;
+  char error[RGEO_NOGVL_ERROR_SIZE];
+} RGeo_NogvlCall;
+
+static VALUE
+raise_nogvl_error(VALUE call)
+{
+  rgeo_raise_geos_error(((RGeo_NogvlCall*)call)->error);
+  return Qnil;
+}
+
+static VALUE
+raise_deadline_error(VALUE unused)
+{
+  rb_raise(rb_eGeosDeadlineExceeded, "GEOS operation exceeded its deadline");
+  return Qnil;
+}
+
+// Seconds left before the deadline set by RGeo::Geos.with_deadline for
+// the current fiber, or HUGE_VAL outside of it. The deadline comes from
+// Process.clock_gettime, which is only called inside with_deadline.
+static double
+deadline_remaining()
+{
+  VALUE deadline;
+  VALUE now;
+
+  deadline = rb_thread_local_aref(rb_thread_current(),
+                                  rb_intern("rgeo_geos_deadline"));
+  if (NIL_P(deadline)) {
+    return HUGE_VAL;
+  }
+  now = rb_funcall(rb_mProcess,
+                   rb_intern("clock_gettime"),
+                   1,
+                   rb_const_get(rb_mProcess, rb_intern("CLOCK_MONOTONIC")));
+  return NUM2DBL(deadline) - NUM2DBL(now);
+}
+
+#ifdef RGEO_GEOS_SUPPORTS_NOGVL
+
+// Call currently running without the GVL on this thread, or NULL if there
+// is none.
+static RB_THREAD_LOCAL_SPECIFIER RGeo_NogvlCall* nogvl_call;
+
+static void*
+nogvl_call_func(void* data)
+{
+  RGeo_NogvlCall* call;
+
+  call = (RGeo_NogvlCall*)data;
+  nogvl_call = call;
+  call->result = call->func(call->data);
+  nogvl_call = NULL;
+  call->ran = 1;
+  return NULL;
+}
+
+// Called by ruby, from another thread, when it needs the thread running
+// the call: for Thread#raise, Thread#kill or a signal. GEOS stops the
+// call at its next interrupt check.
+static void
+nogvl_unblock(void* data)
+{
+  RGeo_NogvlCall* call;
+
+  call = (RGeo_NogvlCall*)data;
+  if (!call->interrupt) {
+    call->interrupt = NOGVL_INTERRUPT_RUBY;
+  }
+}
+
+static double
+monotonic_now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static VALUE
+check_ints(VALUE unused)
+{
+  rb_thread_check_ints();
+  return Qnil;
+}
+
+void*
+rgeo_without_gvl(void* (*func)(void*), void* data, int* state)
+{
+  RGeo_NogvlCall call;
+  double remaining;
+
+  remaining = deadline_remaining();
+  if (remaining <= 0) {
+    rb_protect(raise_deadline_error, Qnil, state);
+    return NULL;
+  }
+  call.func = func;
+  call.data = data;
+  call.deadline =
+    remaining == HUGE_VAL ? HUGE_VAL : monotonic_now() + remaining;
+  call.ran = 0;
+
+  // RB_NOGVL_INTR_FAIL makes ruby skip the call if an interrupt is pending
+  // rather than handle interrupts once it returns, which could raise and
+  // leak whatever GEOS allocated. Pending interrupts are handled here
+  // before trying again. A call that GEOS stopped has freed what it
+  // allocated, and is handled the same way unless its deadline passed.
+  // Before GEOS 3.14 the call may also have been stopped by the interrupt
+  // request of another thread, in which case interrupt is not set.
+  while (!call.ran) {
+    call.result = NULL;
+    call.interrupt = 0;
+    call.error[0] = '\0';
+    rb_nogvl(
+      nogvl_call_func, &call, nogvl_unblock, &call, RB_NOGVL_INTR_FAIL);
+    if (call.ran && !strncmp(call.error,
+                             NOGVL_INTERRUPTED_ERROR,
+                             strlen(NOGVL_INTERRUPTED_ERROR))) {
+      if (call.interrupt == NOGVL_INTERRUPT_DEADLINE) {
+        rb_protect(raise_deadline_error, Qnil, state);
+        return NULL;
+      }
+      call.ran = 0;
+    }
+    if (!call.ran) {
+      rb_protect(check_ints, Qnil, state);
+      if (*state) {
+        return NULL;
+      }
+    }
+  }
+  if (call.error[0]) {
+    rb_protect(raise_nogvl_error, (VALUE)&call, state);
+  }
+  return call.result;
+}
+
+int
+rgeo_nogvl_capture_error(const char* message)
+{
+  if (!nogvl_call) {
+    return 0;
+  }
+  // Only keep the first error, that is the one that made GEOS give up.
+  if (!nogvl_call->error[0]) {
+    strncpy(nogvl_call->error, message, RGEO_NOGVL_ERROR_SIZE - 1);
+    nogvl_call->error[RGEO_NOGVL_ERROR_SIZE - 1] = '\0';
+  }
+  return 1;
+}
+
+int
+rgeo_nogvl_interrupted()
+{
+  RGeo_NogvlCall* call;
+
+  call = nogvl_call;
+  if (!call) {
+    return 0;
+  }
+  if (!call->interrupt && call->deadline < HUGE_VAL &&
+      monotonic_now() >= call->deadline) {
+    call->interrupt = NOGVL_INTERRUPT_DEADLINE;
+  }
+  return call->interrupt != 0;
+}
+
+#else
+
+static VALUE
+call_func(VALUE call_)
+{
+  RGeo_NogvlCall* call;
+
+  call = (RGeo_NogvlCall*)call_;
+  call->result = call->func(call->data);
+  return Qnil;
+}
+
+void*
+rgeo_without_gvl(void* (*func)(void*), void* data, int* state)
+{
+  RGeo_NogvlCall call;
+
+  // GEOS cannot be interrupted here, but a deadline that already passed
+  // is still reported.
+  if (deadline_remaining() <= 0) {
+    rb_protect(raise_deadline_error, Qnil, state);
+    return NULL;
+  }
+  call.func = func;
+  call.data = data;
+  call.result = NULL;
+  rb_protect(call_func, (VALUE)&call, state);
+  return call.result;
+}
+
+int
+rgeo_nogvl_capture_error(const char* message)
+{
+  return 0;
+}
+
+int
+rgeo_nogvl_interrupted()
+{
+  return 0;
+}
+
+#endif // RGEO_GEOS_SUPPORTS_NOGVL
+
+RGEO_END_C
+
+#endif
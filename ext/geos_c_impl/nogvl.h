@@ -0,0 +1,71 @@
+/*
+  Running GEOS operations without the GVL
+*/
+
+#ifndef RGEO_GEOS_NOGVL_INCLUDED
+#define RGEO_GEOS_NOGVL_INCLUDED
+
+#include <ruby.h>
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+#if defined(HAVE_RB_NOGVL) && defined(RB_THREAD_LOCAL_SPECIFIER) &&          \
+  defined(HAVE_PTHREAD_H)
+#define RGEO_GEOS_SUPPORTS_NOGVL
+#endif
+
+RGEO_BEGIN_C
+
+/*
+  Maximum length of a GEOS error message kept while the GVL is released.
+  Longer messages are truncated.
+*/
+#define RGEO_NOGVL_ERROR_SIZE 1024
+
+/*
+  Calls func with the given data while the GVL is released, so that other
+  ruby threads can run during long GEOS operations. func must not call any
+  ruby API nor touch ruby objects. When the GVL cannot be released, func is
+  called directly.
+
+  Errors reported by GEOS during the call are not raised right away, since
+  raising requires the GVL. The state parameter follows `rb_protect*` ruby
+  methods: if an error was reported, state is set to a non-zero value and
+  the error is available in `rb_errinfo()`. IT IS THE CALLER'S
+  RESPONSIBILITY TO PROPAGATE THE ERROR, with `rb_jump_tag(state)`, once
+  any resources held for the call are released. The value returned by func
+  is returned either way.
+
+  Inside RGeo::Geos.with_deadline, a call that is still running at the
+  deadline is interrupted by GEOS and RGeo::Error::DeadlineExceeded is
+  reported through state, as is a deadline that passed before the call.
+  A call interrupted because ruby needs the thread, for Thread#raise or
+  Thread#kill for instance, reports the pending exception through state,
+  or runs func again if there is none. func must therefore not change
+  data in a way that prevents running it again after a GEOS error.
+*/
+void*
+rgeo_without_gvl(void* (*func)(void*), void* data, int* state);
+
+/*
+  Called by the GEOS error handler. If the current thread is running a
+  GEOS call without the GVL, keeps the message so that it can be raised
+  once the GVL is acquired again, and returns 1. Returns 0 otherwise, in
+  which case the error may be raised right away.
+*/
+int
+rgeo_nogvl_capture_error(const char* message);
+
+/*
+  Called by the GEOS interrupt handlers. Returns 1 if the GEOS call
+  running without the GVL on the current thread must stop, because its
+  deadline passed or ruby asked for the thread, and 0 otherwise.
+*/
+int
+rgeo_nogvl_interrupted();
+
+RGEO_END_C
+
+#endif // RGEO_GEOS_SUPPORTED
+
+#endif // RGEO_GEOS_NOGVL_INCLUDED
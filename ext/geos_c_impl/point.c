@@ -24,8 +24,8 @@ method_point_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_point_module;
   }
   return result;
@@ -34,6 +34,7 @@ method_point_geometry_type(VALUE self)
 static VALUE
 method_point_coordinates(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result = Qnil;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -46,7 +47,7 @@ method_point_coordinates(VALUE self)
   if (self_geom) {
     zCoordinate = RGEO_FACTORY_DATA_PTR(self_data->factory)->flags &
                   RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M;
-    coord_sequence = GEOSGeom_getCoordSeq(self_geom);
+    coord_sequence = GEOSGeom_getCoordSeq_r(context, self_geom);
     if (coord_sequence) {
       result = rb_ary_pop(
         extract_points_from_coordinate_sequence(coord_sequence, zCoordinate));
@@ -58,6 +59,7 @@ method_point_coordinates(VALUE self)
 static VALUE
 method_point_x(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -68,9 +70,9 @@ method_point_x(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    coord_seq = GEOSGeom_getCoordSeq(self_geom);
+    coord_seq = GEOSGeom_getCoordSeq_r(context, self_geom);
     if (coord_seq) {
-      if (GEOSCoordSeq_getX(coord_seq, 0, &val)) {
+      if (GEOSCoordSeq_getX_r(context, coord_seq, 0, &val)) {
         result = rb_float_new(val);
       }
     }
@@ -81,6 +83,7 @@ method_point_x(VALUE self)
 static VALUE
 method_point_y(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -91,9 +94,9 @@ method_point_y(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    coord_seq = GEOSGeom_getCoordSeq(self_geom);
+    coord_seq = GEOSGeom_getCoordSeq_r(context, self_geom);
     if (coord_seq) {
-      if (GEOSCoordSeq_getY(coord_seq, 0, &val)) {
+      if (GEOSCoordSeq_getY_r(context, coord_seq, 0, &val)) {
         result = rb_float_new(val);
       }
     }
@@ -104,20 +107,30 @@ method_point_y(VALUE self)
 static VALUE
 get_3d_point(VALUE self, int flag)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
   const GEOSCoordSequence* coord_seq;
+  int flags;
+  unsigned int ordinate;
   double val;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    if (RGEO_FACTORY_DATA_PTR(self_data->factory)->flags & flag) {
-      coord_seq = GEOSGeom_getCoordSeq(self_geom);
+    flags = RGEO_FACTORY_DATA_PTR(self_data->factory)->flags;
+    if (flags & flag) {
+      // M is stored as Z, unless the factory has both.
+      ordinate = flag == RGEO_FACTORYFLAGS_SUPPORTS_M &&
+                     RGEO_FACTORY_DIMS(flags) == 4
+                   ? 3
+                   : 2;
+      coord_seq = GEOSGeom_getCoordSeq_r(context, self_geom);
       if (coord_seq) {
-        if (GEOSCoordSeq_getZ(coord_seq, 0, &val)) {
+        if (GEOSCoordSeq_getOrdinate_r(
+              context, coord_seq, 0, ordinate, &val)) {
           result = rb_float_new(val);
         }
       }
@@ -156,28 +169,26 @@ method_point_eql(VALUE self, VALUE rhs)
 static VALUE
 method_point_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
-
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(factory, rgeo_feature_point_module, hash);
-  hash = rgeo_geos_coordseq_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+  return rgeo_geometry_hash(
+    self, rgeo_feature_point_module, rgeo_geos_coordseq_hash);
 }
 
 static VALUE
-cmethod_create(VALUE module, VALUE factory, VALUE x, VALUE y, VALUE z)
+cmethod_create(VALUE module,
+               VALUE factory,
+               VALUE x,
+               VALUE y,
+               VALUE z,
+               VALUE m)
 {
+  int dims;
+
+  dims = RGEO_FACTORY_DIMS(RGEO_FACTORY_DATA_PTR(factory)->flags);
   return rgeo_create_geos_point(factory,
                                 rb_num2dbl(x),
                                 rb_num2dbl(y),
-                                RGEO_FACTORY_DATA_PTR(factory)->flags &
-                                    RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M
-                                  ? rb_num2dbl(z)
-                                  : 0);
+                                dims > 2 ? rb_num2dbl(z) : 0,
+                                dims > 3 ? rb_num2dbl(m) : 0);
 }
 
 void
@@ -186,7 +197,7 @@ rgeo_init_geos_point()
   VALUE geos_point_methods;
 
   // Class methods for CAPIPointImpl
-  rb_define_module_function(rgeo_geos_point_class, "create", cmethod_create, 4);
+  rb_define_module_function(rgeo_geos_point_class, "create", cmethod_create, 5);
 
   // CAPIPointMethods module
   geos_point_methods =
@@ -205,24 +216,26 @@ rgeo_init_geos_point()
 }
 
 VALUE
-rgeo_create_geos_point(VALUE factory, double x, double y, double z)
+rgeo_create_geos_point(VALUE factory, double x, double y, double z, double m)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
+  int dims;
   GEOSCoordSequence* coord_seq;
   GEOSGeometry* geom;
 
+  // The sequence has the ordinates of the factory, without a z for 2D.
   result = Qnil;
-  coord_seq = GEOSCoordSeq_create(1, 3);
+  dims = RGEO_FACTORY_DIMS(RGEO_FACTORY_DATA_PTR(factory)->flags);
+  coord_seq = GEOSCoordSeq_create_r(context, 1, dims);
   if (coord_seq) {
-    if (GEOSCoordSeq_setX(coord_seq, 0, x)) {
-      if (GEOSCoordSeq_setY(coord_seq, 0, y)) {
-        if (GEOSCoordSeq_setZ(coord_seq, 0, z)) {
-          geom = GEOSGeom_createPoint(coord_seq);
-          if (geom) {
-            result =
-              rgeo_wrap_geos_geometry(factory, geom, rgeo_geos_point_class);
-          }
-        }
+    if (GEOSCoordSeq_setX_r(context, coord_seq, 0, x) &&
+        GEOSCoordSeq_setY_r(context, coord_seq, 0, y) &&
+        (dims < 3 || GEOSCoordSeq_setZ_r(context, coord_seq, 0, z)) &&
+        (dims < 4 || GEOSCoordSeq_setOrdinate_r(context, coord_seq, 0, 3, m))) {
+      geom = GEOSGeom_createPoint_r(context, coord_seq);
+      if (geom) {
+        result = rgeo_wrap_geos_geometry(factory, geom, rgeo_geos_point_class);
       }
     }
   }
@@ -17,10 +17,12 @@ void
 rgeo_init_geos_point();
 
 /*
-  Creates a 3d point and returns the ruby object.
+  Creates a point and returns the ruby object. z is ignored unless the
+  factory supports Z or M, and holds M on factories with M but no Z. m is
+  ignored unless the factory supports both.
 */
 VALUE
-rgeo_create_geos_point(VALUE factory, double x, double y, double z);
+rgeo_create_geos_point(VALUE factory, double x, double y, double z, double m);
 
 RGEO_END_C
 
@@ -36,16 +36,8 @@ method_polygon_eql(VALUE self, VALUE rhs)
 static VALUE
 method_polygon_hash(VALUE self)
 {
-  st_index_t hash;
-  RGeo_GeometryData* self_data;
-  VALUE factory;
-
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  factory = self_data->factory;
-  hash = rb_hash_start(0);
-  hash = rgeo_geos_objbase_hash(factory, rgeo_feature_polygon_module, hash);
-  hash = rgeo_geos_polygon_hash(self_data->geom, hash);
-  return LONG2FIX(rb_hash_end(hash));
+  return rgeo_geometry_hash(
+    self, rgeo_feature_polygon_module, rgeo_geos_polygon_hash);
 }
 
 static VALUE
@@ -55,8 +47,8 @@ method_polygon_geometry_type(VALUE self)
   RGeo_GeometryData* self_data;
 
   result = Qnil;
-  self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  if (self_data->geom) {
+  self_data = RGEO_GEOMETRY_LAZY_DATA_PTR(self);
+  if (RGEO_GEOMETRY_INITIALIZED_P(self_data)) {
     result = rgeo_feature_polygon_module;
   }
   return result;
@@ -65,6 +57,7 @@ method_polygon_geometry_type(VALUE self)
 static VALUE
 method_polygon_area(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -74,7 +67,7 @@ method_polygon_area(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    if (GEOSArea(self_geom, &area)) {
+    if (GEOSArea_r(context, self_geom, &area)) {
       result = rb_float_new(area);
     }
   }
@@ -84,6 +77,7 @@ method_polygon_area(VALUE self)
 static VALUE
 method_polygon_centroid(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -92,8 +86,9 @@ method_polygon_centroid(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    result = rgeo_wrap_geos_geometry(
-      self_data->factory, GEOSGetCentroid(self_geom), rgeo_geos_point_class);
+    result = rgeo_wrap_geos_geometry(self_data->factory,
+                                     GEOSGetCentroid_r(context, self_geom),
+                                     rgeo_geos_point_class);
   }
   return result;
 }
@@ -101,6 +96,7 @@ method_polygon_centroid(VALUE self)
 static VALUE
 method_polygon_point_on_surface(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -109,8 +105,9 @@ method_polygon_point_on_surface(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    result = rgeo_wrap_geos_geometry(
-      self_data->factory, GEOSPointOnSurface(self_geom), rgeo_geos_point_class);
+    result = rgeo_wrap_geos_geometry(self_data->factory,
+                                     GEOSPointOnSurface_r(context, self_geom),
+                                     rgeo_geos_point_class);
   }
   return result;
 }
@@ -138,6 +135,7 @@ method_polygon_coordinates(VALUE self)
 static VALUE
 method_polygon_exterior_ring(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -146,9 +144,10 @@ method_polygon_exterior_ring(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    result = rgeo_wrap_geos_geometry_clone(self_data->factory,
-                                           GEOSGetExteriorRing(self_geom),
-                                           rgeo_geos_linear_ring_class);
+    result = rgeo_wrap_geos_geometry_view(
+      self,
+      GEOSGetExteriorRing_r(context, self_geom),
+      rgeo_geos_linear_ring_class);
   }
   return result;
 }
@@ -156,6 +155,7 @@ method_polygon_exterior_ring(VALUE self)
 static VALUE
 method_polygon_num_interior_rings(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -165,7 +165,7 @@ method_polygon_num_interior_rings(VALUE self)
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    num = GEOSGetNumInteriorRings(self_geom);
+    num = GEOSGetNumInteriorRings_r(context, self_geom);
     if (num >= 0) {
       result = INT2NUM(num);
     }
@@ -176,6 +176,7 @@ method_polygon_num_interior_rings(VALUE self)
 static VALUE
 method_polygon_interior_ring_n(VALUE self, VALUE n)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
@@ -188,12 +189,12 @@ method_polygon_interior_ring_n(VALUE self, VALUE n)
   if (self_geom) {
     i = RB_NUM2INT(n);
     if (i >= 0) {
-      num = GEOSGetNumInteriorRings(self_geom);
+      num = GEOSGetNumInteriorRings_r(context, self_geom);
       if (i < num) {
-        result =
-          rgeo_wrap_geos_geometry_clone(self_data->factory,
-                                        GEOSGetInteriorRingN(self_geom, i),
-                                        rgeo_geos_linear_ring_class);
+        result = rgeo_wrap_geos_geometry_view(
+          self,
+          GEOSGetInteriorRingN_r(context, self_geom, i),
+          rgeo_geos_linear_ring_class);
       }
     }
   }
@@ -203,28 +204,27 @@ method_polygon_interior_ring_n(VALUE self, VALUE n)
 static VALUE
 method_polygon_interior_rings(VALUE self)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE result;
   RGeo_GeometryData* self_data;
   const GEOSGeometry* self_geom;
   int count;
-  VALUE factory;
   int i;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
   self_geom = self_data->geom;
   if (self_geom) {
-    count = GEOSGetNumInteriorRings(self_geom);
+    count = GEOSGetNumInteriorRings_r(context, self_geom);
     if (count >= 0) {
       result = rb_ary_new2(count);
-      factory = self_data->factory;
       for (i = 0; i < count; ++i) {
-        rb_ary_store(
-          result,
-          i,
-          rgeo_wrap_geos_geometry_clone(factory,
-                                        GEOSGetInteriorRingN(self_geom, i),
-                                        rgeo_geos_linear_ring_class));
+        rb_ary_store(result,
+                     i,
+                     rgeo_wrap_geos_geometry_view(
+                       self,
+                       GEOSGetInteriorRingN_r(context, self_geom, i),
+                       rgeo_geos_linear_ring_class));
       }
     }
   }
@@ -232,6 +232,22 @@ method_polygon_interior_rings(VALUE self)
 }
 
 #ifdef RGEO_GEOS_SUPPORTS_POLYGON_HULL_SIMPLIFY
+typedef struct
+{
+  const GEOSGeometry* geom;
+  unsigned int is_outer;
+  double vertex_fraction;
+} RGeo_PolygonHullArgs;
+
+static void*
+polygon_hull_simplify_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_PolygonHullArgs* args = (RGeo_PolygonHullArgs*)data;
+  return GEOSPolygonHullSimplify_r(
+    context, args->geom, args->is_outer, args->vertex_fraction);
+}
+
 static VALUE
 method_polygon_simplify_polygon_hull(VALUE self,
                                      VALUE vertex_fraction,
@@ -239,21 +255,17 @@ method_polygon_simplify_polygon_hull(VALUE self,
 {
   VALUE result;
   RGeo_GeometryData* self_data;
-  const GEOSGeometry* self_geom;
-  VALUE factory;
-
-  unsigned int is_outer_uint = RTEST(is_outer) ? 1 : 0;
+  RGeo_PolygonHullArgs args;
 
   result = Qnil;
   self_data = RGEO_GEOMETRY_DATA_PTR(self);
-  self_geom = self_data->geom;
-  if (self_geom) {
-    factory = self_data->factory;
-    result = rgeo_wrap_geos_geometry(
-      factory,
-      GEOSPolygonHullSimplify(
-        self_geom, is_outer_uint, rb_num2dbl(vertex_fraction)),
-      Qnil);
+  args.geom = self_data->geom;
+  if (args.geom) {
+    args.is_outer = RTEST(is_outer) ? 1 : 0;
+    args.vertex_fraction = rb_num2dbl(vertex_fraction);
+    result = rgeo_wrap_geos_geometry_nogvl(
+      self_data->factory, polygon_hull_simplify_nogvl, &args, Qnil);
+    RB_GC_GUARD(self);
   }
   return result;
 }
@@ -265,6 +277,7 @@ cmethod_create(VALUE module,
                VALUE exterior,
                VALUE interior_array)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   VALUE linear_ring_type;
   GEOSGeometry* exterior_geom;
   unsigned int len;
@@ -297,17 +310,17 @@ cmethod_create(VALUE module,
                                                &state);
       if (state) {
         for (j = 0; j < i; j++) {
-          GEOSGeom_destroy(interior_geoms[j]);
+          GEOSGeom_destroy_r(context, interior_geoms[j]);
         }
-        GEOSGeom_destroy(exterior_geom);
+        GEOSGeom_destroy_r(context, exterior_geom);
         FREE(interior_geoms);
         rb_jump_tag(state);
       }
       interior_geoms[actual_len++] = interior_geom;
     }
     if (len == actual_len) {
-      polygon =
-        GEOSGeom_createPolygon(exterior_geom, interior_geoms, actual_len);
+      polygon = GEOSGeom_createPolygon_r(
+        context, exterior_geom, interior_geoms, actual_len);
       if (polygon) {
         FREE(interior_geoms);
         // NOTE: we can return safely here, state cannot be other than 0.
@@ -316,11 +329,84 @@ cmethod_create(VALUE module,
       }
     }
     for (i = 0; i < actual_len; ++i) {
-      GEOSGeom_destroy(interior_geoms[i]);
+      GEOSGeom_destroy_r(context, interior_geoms[i]);
     }
     FREE(interior_geoms);
   }
-  GEOSGeom_destroy(exterior_geom);
+  GEOSGeom_destroy_r(context, exterior_geom);
+  if (state) {
+    rb_jump_tag(state);
+  }
+  return Qnil;
+}
+
+typedef struct
+{
+  VALUE factory;
+  VALUE coords;
+  int dims;
+  GEOSCoordSequence* coord_seq;
+} RGeo_RingCoordsArgs;
+
+static VALUE
+ring_coord_seq_from_coords(VALUE args_)
+{
+  RGeo_RingCoordsArgs* args = (RGeo_RingCoordsArgs*)args_;
+
+  args->coord_seq =
+    rgeo_coord_seq_from_coords(args->factory, args->coords, args->dims, 1);
+  return Qnil;
+}
+
+static VALUE
+cmethod_create_from_coords(VALUE module,
+                           VALUE factory,
+                           VALUE rings,
+                           VALUE dims)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_RingCoordsArgs args;
+  GEOSGeometry** ring_geoms;
+  unsigned int len;
+  unsigned int actual_len;
+  unsigned int i;
+  GEOSGeometry* polygon;
+  int state = 0;
+
+  Check_Type(rings, T_ARRAY);
+  len = (unsigned int)RARRAY_LEN(rings);
+  if (len == 0) {
+    rb_raise(rb_eArgError, "A polygon needs an exterior ring");
+  }
+  args.factory = factory;
+  args.dims = NUM2INT(dims);
+  ring_geoms = ALLOC_N(GEOSGeometry*, len);
+  actual_len = 0;
+  for (i = 0; i < len; ++i) {
+    args.coords = rb_ary_entry(rings, i);
+    args.coord_seq = NULL;
+    rb_protect(ring_coord_seq_from_coords, (VALUE)&args, &state);
+    if (state || !args.coord_seq) {
+      break;
+    }
+    ring_geoms[i] = GEOSGeom_createLinearRing_r(context, args.coord_seq);
+    if (!ring_geoms[i]) {
+      break;
+    }
+    ++actual_len;
+  }
+  if (actual_len == len) {
+    polygon = GEOSGeom_createPolygon_r(
+      context, ring_geoms[0], ring_geoms + 1, actual_len - 1);
+    if (polygon) {
+      FREE(ring_geoms);
+      return rgeo_wrap_geos_geometry(factory, polygon, rgeo_geos_polygon_class);
+    }
+  }
+  for (i = 0; i < actual_len; ++i) {
+    GEOSGeom_destroy_r(context, ring_geoms[i]);
+  }
+  FREE(ring_geoms);
   if (state) {
     rb_jump_tag(state);
   }
@@ -335,6 +421,10 @@ rgeo_init_geos_polygon()
   // Class methods for CAPIPolygonImpl
   rb_define_module_function(
     rgeo_geos_polygon_class, "create", cmethod_create, 3);
+  rb_define_module_function(rgeo_geos_polygon_class,
+                            "_create_from_coords",
+                            cmethod_create_from_coords,
+                            3);
 
   // CAPIPolygonMethods module
   geos_polygon_methods =
@@ -375,14 +465,16 @@ rgeo_init_geos_polygon()
 st_index_t
 rgeo_geos_polygon_hash(const GEOSGeometry* geom, st_index_t hash)
 {
+  GEOSContextHandle_t context = rgeo_geos_context();
   unsigned int len;
   unsigned int i;
 
   if (geom) {
-    hash = rgeo_geos_coordseq_hash(GEOSGetExteriorRing(geom), hash);
-    len = GEOSGetNumInteriorRings(geom);
+    hash = rgeo_geos_coordseq_hash(GEOSGetExteriorRing_r(context, geom), hash);
+    len = GEOSGetNumInteriorRings_r(context, geom);
     for (i = 0; i < len; ++i) {
-      hash = rgeo_geos_coordseq_hash(GEOSGetInteriorRingN(geom, i), hash);
+      hash = rgeo_geos_coordseq_hash(
+        GEOSGetInteriorRingN_r(context, geom, i), hash);
     }
   }
   return hash;
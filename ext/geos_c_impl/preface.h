@@ -17,6 +17,9 @@
 #ifdef HAVE_GEOSWKTWWRITER_SETOUTPUTDIMENSION_R
 #define RGEO_GEOS_SUPPORTS_SETOUTPUTDIMENSION
 #endif
+#ifdef HAVE_GEOSPREPAREDCONTAINSXY_R
+#define RGEO_GEOS_SUPPORTS_PREPARED_XY
+#endif
 #ifdef HAVE_GEOSUNARYUNION_R
 #define RGEO_GEOS_SUPPORTS_UNARYUNION
 #endif
@@ -29,6 +32,24 @@
 #ifdef HAVE_GEOSPOLYGONHULLSIMPLIFY
 #define RGEO_GEOS_SUPPORTS_POLYGON_HULL_SIMPLIFY
 #endif
+#ifdef HAVE_GEOSCOORDSEQ_COPYFROMBUFFER_R
+#define RGEO_GEOS_SUPPORTS_COORDSEQ_BUFFER
+#endif
+#ifdef HAVE_GEOSWKBWRITER_SETFLAVOR_R
+#define RGEO_GEOS_SUPPORTS_WKB_FLAVOR
+#endif
+#ifdef HAVE_GEOSGEOJSONREADER_READGEOMETRY_R
+#define RGEO_GEOS_SUPPORTS_GEOJSON
+#endif
+#ifdef HAVE_GEOSSTRTREE_BUILD_R
+#define RGEO_GEOS_SUPPORTS_STRTREE_BUILD
+#endif
+#ifdef HAVE_GEOSHASM_R
+#define RGEO_GEOS_SUPPORTS_XYZM
+#endif
+#ifdef HAVE_GEOSCONTEXT_SETINTERRUPTCALLBACK_R
+#define RGEO_GEOS_SUPPORTS_CONTEXT_INTERRUPT
+#endif
 #ifdef HAVE_RB_GC_MARK_MOVABLE
 #define mark rb_gc_mark_movable
 #else
@@ -0,0 +1,1090 @@
+/*
+  STRtree spatial index for GEOS wrapper
+*/
+
+#include "preface.h"
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+#include <float.h>
+#include <geos_c.h>
+#include <math.h>
+#include <ruby.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+#include "factory.h"
+#include "globals.h"
+#include "strtree.h"
+
+RGEO_BEGIN_C
+
+#define RGEO_STRTREE_DEFAULT_NODE_CAPACITY 10
+
+// Rough size of the GEOS tree, which GEOS does not report: a node with an
+// envelope and two pointers per item, and per group of node_capacity
+// children. Before GEOS 3.10, a bounding box also holds a line string.
+#define RGEO_STRTREE_NODE_SIZE (4 * sizeof(double) + 2 * sizeof(void*))
+#define RGEO_STRTREE_BBOX_SIZE 160
+
+// GEOS items are entry indexes offset by one, so that no item is NULL,
+// which is what GEOS returns when there is no nearest item.
+#define RGEO_STRTREE_ITEM(index) ((void*)(uintptr_t)((index) + 1))
+#define RGEO_STRTREE_INDEX(item) ((size_t)(uintptr_t)(item) - 1)
+
+// Item given to GEOS for the geometry of a nearest query, which is not in
+// the tree.
+#define RGEO_STRTREE_QUERY_ITEM ((void*)UINTPTR_MAX)
+
+/**** RUBY AND GEOS CALLBACKS ****/
+
+static void
+destroy_strtree_func(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_STRtreeData* strtree_data;
+#ifdef RGEO_STRTREE_KEEPS_BBOXES
+  size_t i;
+#endif
+
+  strtree_data = (RGeo_STRtreeData*)data;
+  if (strtree_data->tree) {
+    GEOSSTRtree_destroy_r(context, strtree_data->tree);
+  }
+  if (strtree_data->entries) {
+#ifdef RGEO_STRTREE_KEEPS_BBOXES
+    for (i = 0; i < strtree_data->size; ++i) {
+      if (strtree_data->entries[i].bbox) {
+        GEOSGeom_destroy_r(context, strtree_data->entries[i].bbox);
+      }
+    }
+#endif
+    FREE(strtree_data->entries);
+  }
+  if (strtree_data->bounds) {
+    FREE(strtree_data->bounds);
+  }
+  FREE(strtree_data);
+}
+
+static void
+mark_strtree_func(void* data)
+{
+  RGeo_STRtreeData* strtree_data;
+  RGeo_STRtreeEntry* entry;
+  size_t i;
+
+  strtree_data = (RGeo_STRtreeData*)data;
+  for (i = 0; i < strtree_data->size; ++i) {
+    entry = &strtree_data->entries[i];
+    mark(entry->geometry);
+    if (entry->payload != entry->geometry) {
+      mark(entry->payload);
+    }
+  }
+}
+
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+static void
+compact_strtree_func(void* data)
+{
+  RGeo_STRtreeData* strtree_data;
+  RGeo_STRtreeEntry* entry;
+  size_t i;
+
+  strtree_data = (RGeo_STRtreeData*)data;
+  for (i = 0; i < strtree_data->size; ++i) {
+    entry = &strtree_data->entries[i];
+    entry->geometry = rb_gc_location(entry->geometry);
+    entry->payload = rb_gc_location(entry->payload);
+  }
+}
+#endif
+
+static size_t
+strtree_memsize(const void* data)
+{
+  const RGeo_STRtreeData* strtree_data;
+
+  size_t size;
+
+  strtree_data = (const RGeo_STRtreeData*)data;
+  size = sizeof(RGeo_STRtreeData) +
+         strtree_data->capacity * sizeof(RGeo_STRtreeEntry);
+  if (strtree_data->bounds) {
+    size += strtree_data->capacity * 4 * sizeof(double);
+#ifdef RGEO_STRTREE_KEEPS_BBOXES
+    // Entries inserted as geometries are not told apart here.
+    size += strtree_data->size * RGEO_STRTREE_BBOX_SIZE;
+#endif
+  }
+  size += (strtree_data->size +
+           strtree_data->size / (strtree_data->node_capacity - 1) + 1) *
+          RGEO_STRTREE_NODE_SIZE;
+  return size;
+}
+
+static const rb_data_type_t rgeo_strtree_type = {
+  .wrap_struct_name = "RGeo/STRtree",
+  .function = {
+    .dmark = mark_strtree_func,
+    .dfree = destroy_strtree_func,
+    .dsize = strtree_memsize,
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+    .dcompact = compact_strtree_func,
+#endif
+  }
+};
+
+// Indexes of the entries matching a query. This is filled from GEOS
+// callbacks, which must not raise: allocation failures are recorded and
+// reported once GEOS returns.
+
+typedef struct
+{
+  size_t* indexes;
+  size_t size;
+  size_t capacity;
+  char failed;
+} RGeo_STRtreeMatches;
+
+static void
+collect_match(void* item, void* userdata)
+{
+  RGeo_STRtreeMatches* matches;
+  size_t* indexes;
+  size_t capacity;
+
+  matches = (RGeo_STRtreeMatches*)userdata;
+  if (matches->failed) {
+    return;
+  }
+  if (matches->size == matches->capacity) {
+    capacity = matches->capacity ? matches->capacity * 2 : 16;
+    indexes = realloc(matches->indexes, capacity * sizeof(size_t));
+    if (!indexes) {
+      matches->failed = 1;
+      return;
+    }
+    matches->indexes = indexes;
+    matches->capacity = capacity;
+  }
+  matches->indexes[matches->size++] = RGEO_STRTREE_INDEX(item);
+}
+
+static void
+ignore_match(void* item, void* userdata)
+{
+}
+
+/**** INTERNAL UTILITY FUNCTIONS ****/
+
+static RGeo_STRtreeData*
+get_strtree_data(VALUE self)
+{
+  RGeo_STRtreeData* data;
+
+  TypedData_Get_Struct(self, RGeo_STRtreeData, &rgeo_strtree_type, data);
+  if (!data->tree) {
+    rb_raise(rb_eRGeoError, "STRtree is not initialized");
+  }
+  return data;
+}
+
+static void
+check_not_built(RGeo_STRtreeData* data)
+{
+  if (data->built) {
+    rb_raise(rb_eRGeoUnsupportedOperation,
+             "Cannot insert into an STRtree that has already been queried");
+  }
+}
+
+static void
+reserve_entries(RGeo_STRtreeData* data, size_t count)
+{
+  size_t capacity;
+
+  if (data->size + count <= data->capacity) {
+    return;
+  }
+  capacity = data->capacity ? data->capacity : 16;
+  while (capacity < data->size + count) {
+    capacity *= 2;
+  }
+  REALLOC_N(data->entries, RGeo_STRtreeEntry, capacity);
+  if (data->bounds) {
+    REALLOC_N(data->bounds, double, capacity * 4);
+  }
+  data->capacity = capacity;
+}
+
+static size_t
+append_entry(RGeo_STRtreeData* data, VALUE geometry, VALUE payload)
+{
+  size_t index;
+
+  reserve_entries(data, 1);
+  index = data->size++;
+  data->entries[index].geometry = geometry;
+  data->entries[index].payload = payload;
+#ifdef RGEO_STRTREE_KEEPS_BBOXES
+  data->entries[index].bbox = NULL;
+#endif
+  return index;
+}
+
+// Returns a geometry covering the given bounds. A line across the box has
+// the same envelope as the box itself and is cheaper to build.
+
+static GEOSGeometry*
+create_bbox_geometry(GEOSContextHandle_t context,
+                     double min_x,
+                     double min_y,
+                     double max_x,
+                     double max_y)
+{
+  GEOSCoordSequence* coord_seq;
+
+  if (min_x > max_x || min_y > max_y) {
+    rb_raise(rb_eArgError, "Bounding box minimum is greater than maximum");
+  }
+  coord_seq = GEOSCoordSeq_create_r(context, 2, 2);
+  if (!coord_seq) {
+    rb_raise(rb_eGeosError, "Unable to create a bounding box");
+  }
+  GEOSCoordSeq_setX_r(context, coord_seq, 0, min_x);
+  GEOSCoordSeq_setY_r(context, coord_seq, 0, min_y);
+  GEOSCoordSeq_setX_r(context, coord_seq, 1, max_x);
+  GEOSCoordSeq_setY_r(context, coord_seq, 1, max_y);
+  return GEOSGeom_createLineString_r(context, coord_seq);
+}
+
+static const GEOSGeometry*
+get_inserted_geometry(VALUE geometry)
+{
+  const GEOSGeometry* geom;
+
+  rgeo_check_geos_object(geometry);
+  geom = RGEO_GEOMETRY_DATA_PTR(geometry)->geom;
+  if (!geom) {
+    rb_raise(rb_eRGeoError, "Geometry is not initialized");
+  }
+  return geom;
+}
+
+static void
+insert_geometry(RGeo_STRtreeData* data, VALUE geometry, VALUE payload)
+{
+  const GEOSGeometry* geom;
+  size_t index;
+
+  geom = get_inserted_geometry(geometry);
+  index = append_entry(data, geometry, payload);
+  GEOSSTRtree_insert_r(
+    rgeo_geos_context(), data->tree, geom, RGEO_STRTREE_ITEM(index));
+}
+
+static void
+insert_bbox(RGeo_STRtreeData* data,
+            double min_x,
+            double min_y,
+            double max_x,
+            double max_y,
+            VALUE payload)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSGeometry* bbox;
+  size_t index;
+
+  // Allocate first so that nothing raises while bbox is held. Before GEOS
+  // 3.10 the entry then owns bbox, see RGEO_STRTREE_KEEPS_BBOXES.
+  reserve_entries(data, 1);
+  if (!data->bounds) {
+    data->bounds = ALLOC_N(double, data->capacity * 4);
+  }
+  bbox = create_bbox_geometry(context, min_x, min_y, max_x, max_y);
+  if (!bbox) {
+    rb_raise(rb_eGeosError, "Unable to create a bounding box");
+  }
+  index = append_entry(data, Qnil, payload);
+  data->bounds[index * 4] = min_x;
+  data->bounds[index * 4 + 1] = min_y;
+  data->bounds[index * 4 + 2] = max_x;
+  data->bounds[index * 4 + 3] = max_y;
+  GEOSSTRtree_insert_r(context, data->tree, bbox, RGEO_STRTREE_ITEM(index));
+#ifdef RGEO_STRTREE_KEEPS_BBOXES
+  data->entries[index].bbox = bbox;
+#else
+  GEOSGeom_destroy_r(context, bbox);
+#endif
+}
+
+// Collects the indexes of the entries whose envelope intersects the one
+// of geom. The caller owns the indexes of the matches.
+
+static void
+collect_matches(GEOSContextHandle_t context,
+                RGeo_STRtreeData* data,
+                const GEOSGeometry* geom,
+                RGeo_STRtreeMatches* matches)
+{
+  matches->indexes = NULL;
+  matches->size = 0;
+  matches->capacity = 0;
+  matches->failed = 0;
+  GEOSSTRtree_query_r(context, data->tree, geom, collect_match, matches);
+  data->built = 1;
+}
+
+// Runs a query for the given envelope, which is either a GEOS geometry
+// or an array of bounds [min_x, min_y, max_x, max_y].
+
+static void
+query_matches(RGeo_STRtreeData* data,
+              VALUE envelope,
+              RGeo_STRtreeMatches* matches)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSGeometry* bbox;
+
+  if (RB_TYPE_P(envelope, T_ARRAY)) {
+    if (RARRAY_LEN(envelope) != 4) {
+      rb_raise(rb_eArgError,
+               "Bounds must be [min_x, min_y, max_x, max_y], got %ld elements",
+               RARRAY_LEN(envelope));
+    }
+    bbox = create_bbox_geometry(context,
+                                rb_num2dbl(rb_ary_entry(envelope, 0)),
+                                rb_num2dbl(rb_ary_entry(envelope, 1)),
+                                rb_num2dbl(rb_ary_entry(envelope, 2)),
+                                rb_num2dbl(rb_ary_entry(envelope, 3)));
+    collect_matches(context, data, bbox, matches);
+    GEOSGeom_destroy_r(context, bbox);
+  } else {
+    collect_matches(
+      context, data, get_inserted_geometry(envelope), matches);
+  }
+  if (matches->failed) {
+    free(matches->indexes);
+    rb_memerror();
+  }
+}
+
+// State of a nearest query. found holds the sorted indexes of the
+// found_count entries already found, which the distance callback puts out
+// of reach.
+
+typedef struct
+{
+  GEOSContextHandle_t context;
+  RGeo_STRtreeData* data;
+  const GEOSGeometry* geom;
+  char is_point;
+  double x;
+  double y;
+  size_t* found;
+  size_t found_count;
+} RGeo_STRtreeNearestArgs;
+
+typedef struct
+{
+  size_t index;
+  double distance;
+} RGeo_STRtreeNeighbor;
+
+static void
+init_nearest_args(RGeo_STRtreeNearestArgs* args,
+                  RGeo_STRtreeData* data,
+                  const GEOSGeometry* geom)
+{
+  args->context = rgeo_geos_context();
+  args->data = data;
+  args->geom = geom;
+  args->is_point = GEOSGeomTypeId_r(args->context, geom) == GEOS_POINT;
+  if (args->is_point) {
+    GEOSGeomGetX_r(args->context, geom, &args->x);
+    GEOSGeomGetY_r(args->context, geom, &args->y);
+  }
+  args->found = NULL;
+  args->found_count = 0;
+}
+
+static GEOSGeometry*
+create_box_polygon(GEOSContextHandle_t context, const double* bounds)
+{
+  GEOSCoordSequence* coord_seq;
+  GEOSGeometry* ring;
+
+  coord_seq = GEOSCoordSeq_create_r(context, 5, 2);
+  if (!coord_seq) {
+    return NULL;
+  }
+  GEOSCoordSeq_setX_r(context, coord_seq, 0, bounds[0]);
+  GEOSCoordSeq_setY_r(context, coord_seq, 0, bounds[1]);
+  GEOSCoordSeq_setX_r(context, coord_seq, 1, bounds[2]);
+  GEOSCoordSeq_setY_r(context, coord_seq, 1, bounds[1]);
+  GEOSCoordSeq_setX_r(context, coord_seq, 2, bounds[2]);
+  GEOSCoordSeq_setY_r(context, coord_seq, 2, bounds[3]);
+  GEOSCoordSeq_setX_r(context, coord_seq, 3, bounds[0]);
+  GEOSCoordSeq_setY_r(context, coord_seq, 3, bounds[3]);
+  GEOSCoordSeq_setX_r(context, coord_seq, 4, bounds[0]);
+  GEOSCoordSeq_setY_r(context, coord_seq, 4, bounds[1]);
+  ring = GEOSGeom_createLinearRing_r(context, coord_seq);
+  if (!ring) {
+    return NULL;
+  }
+  return GEOSGeom_createPolygon_r(context, ring, NULL, 0);
+}
+
+// Computes the exact distance between the query geometry and an entry.
+// Returns 0 on failure, like GEOS distance functions. This runs from GEOS
+// callbacks: it neither raises nor allocates ruby objects.
+
+static int
+entry_distance(RGeo_STRtreeNearestArgs* args, size_t index, double* distance)
+{
+  VALUE geometry;
+  const double* bounds;
+  GEOSGeometry* box;
+  int result;
+
+  geometry = args->data->entries[index].geometry;
+  if (!NIL_P(geometry)) {
+    return GEOSDistance_r(args->context,
+                          args->geom,
+                          RGEO_GEOMETRY_LAZY_DATA_PTR(geometry)->geom,
+                          distance);
+  }
+  bounds = &args->data->bounds[index * 4];
+  if (args->is_point) {
+    *distance =
+      hypot(fmax(fmax(bounds[0] - args->x, args->x - bounds[2]), 0),
+            fmax(fmax(bounds[1] - args->y, args->y - bounds[3]), 0));
+    return 1;
+  }
+  box = create_box_polygon(args->context, bounds);
+  if (!box) {
+    return 0;
+  }
+  result = GEOSDistance_r(args->context, args->geom, box, distance);
+  GEOSGeom_destroy_r(args->context, box);
+  return result;
+}
+
+// Returns the position of index in the found entries, or of the first
+// found entry after it.
+
+static size_t
+find_found(RGeo_STRtreeNearestArgs* args, size_t index)
+{
+  size_t low;
+  size_t high;
+  size_t middle;
+
+  low = 0;
+  high = args->found_count;
+  while (low < high) {
+    middle = low + (high - low) / 2;
+    if (args->found[middle] < index) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+static char
+is_excluded(RGeo_STRtreeNearestArgs* args, size_t index)
+{
+  size_t position;
+
+  position = find_found(args, index);
+  return position < args->found_count && args->found[position] == index;
+}
+
+static void
+add_found(RGeo_STRtreeNearestArgs* args, size_t index)
+{
+  size_t position;
+
+  position = find_found(args, index);
+  memmove(&args->found[position + 1],
+          &args->found[position],
+          (args->found_count - position) * sizeof(size_t));
+  args->found[position] = index;
+  ++args->found_count;
+}
+
+static int
+nearest_distance(const void* item1,
+                 const void* item2,
+                 double* distance,
+                 void* userdata)
+{
+  RGeo_STRtreeNearestArgs* args;
+  size_t index;
+
+  args = (RGeo_STRtreeNearestArgs*)userdata;
+  index = RGEO_STRTREE_INDEX(item1 == RGEO_STRTREE_QUERY_ITEM ? item2 : item1);
+  if (is_excluded(args, index)) {
+    *distance = DBL_MAX;
+    return 1;
+  }
+  return entry_distance(args, index, distance);
+}
+
+static int
+compare_neighbors(const void* neighbor1, const void* neighbor2)
+{
+  double distance1 = ((const RGeo_STRtreeNeighbor*)neighbor1)->distance;
+  double distance2 = ((const RGeo_STRtreeNeighbor*)neighbor2)->distance;
+
+  return (distance1 > distance2) - (distance1 < distance2);
+}
+
+// Returns [[geometry, payload, distance], ...] for the given neighbors.
+// geometry is nil for entries inserted as bounding boxes.
+
+static VALUE
+neighbors_to_array(RGeo_STRtreeData* data,
+                   const RGeo_STRtreeNeighbor* neighbors,
+                   size_t count)
+{
+  VALUE result;
+  RGeo_STRtreeEntry* entry;
+  size_t i;
+
+  result = rb_ary_new_capa((long)count);
+  for (i = 0; i < count; ++i) {
+    entry = &data->entries[neighbors[i].index];
+    rb_ary_push(result,
+                rb_ary_new_from_args(3,
+                                     entry->geometry,
+                                     entry->payload,
+                                     DBL2NUM(neighbors[i].distance)));
+  }
+  return result;
+}
+
+typedef struct
+{
+  RGeo_STRtreeNearestArgs* args;
+  RGeo_STRtreeMatches* matches;
+  double radius;
+  long limit;
+} RGeo_STRtreeWithinArgs;
+
+static VALUE
+within_neighbors(VALUE within_)
+{
+  RGeo_STRtreeWithinArgs* within;
+  RGeo_STRtreeNeighbor* neighbors;
+  VALUE neighbors_buffer;
+  VALUE result;
+  size_t count;
+  size_t i;
+  double distance;
+
+  within = (RGeo_STRtreeWithinArgs*)within_;
+  neighbors = ALLOCV_N(
+    RGeo_STRtreeNeighbor, neighbors_buffer, within->matches->size + 1);
+  count = 0;
+  for (i = 0; i < within->matches->size; ++i) {
+    if (!entry_distance(
+          within->args, within->matches->indexes[i], &distance)) {
+      rb_raise(rb_eGeosError, "Unable to compute a distance");
+    }
+    if (distance <= within->radius) {
+      neighbors[count].index = within->matches->indexes[i];
+      neighbors[count].distance = distance;
+      ++count;
+    }
+  }
+  qsort(neighbors, count, sizeof(RGeo_STRtreeNeighbor), compare_neighbors);
+  if (within->limit >= 0 && count > (size_t)within->limit) {
+    count = (size_t)within->limit;
+  }
+  result = neighbors_to_array(within->args->data, neighbors, count);
+  ALLOCV_END(neighbors_buffer);
+  return result;
+}
+
+typedef struct
+{
+  RGeo_STRtreeData* data;
+  RGeo_STRtreeMatches* matches;
+} RGeo_STRtreeYieldArgs;
+
+static VALUE
+yield_matches(VALUE args_)
+{
+  RGeo_STRtreeYieldArgs* args;
+  size_t i;
+
+  args = (RGeo_STRtreeYieldArgs*)args_;
+  for (i = 0; i < args->matches->size; ++i) {
+    rb_yield(args->data->entries[args->matches->indexes[i]].payload);
+  }
+  return Qnil;
+}
+
+static VALUE
+free_matches(VALUE matches)
+{
+  free(((RGeo_STRtreeMatches*)matches)->indexes);
+  return Qnil;
+}
+
+/**** RUBY METHOD DEFINITIONS ****/
+
+static VALUE
+alloc_strtree(VALUE klass)
+{
+  RGeo_STRtreeData* data;
+
+  data = ALLOC(RGeo_STRtreeData);
+  data->tree = NULL;
+  data->entries = NULL;
+  data->bounds = NULL;
+  data->size = 0;
+  data->capacity = 0;
+  data->node_capacity = RGEO_STRTREE_DEFAULT_NODE_CAPACITY;
+  data->built = 0;
+  return TypedData_Wrap_Struct(klass, &rgeo_strtree_type, data);
+}
+
+/*
+ * call-seq:
+ *   RGeo::Geos::STRtree.new(node_capacity = 10) -> tree
+ *
+ * Creates an empty tree. node_capacity is the maximum number of children
+ * of each node of the tree.
+ */
+static VALUE
+method_strtree_initialize(int argc, VALUE* argv, VALUE self)
+{
+  RGeo_STRtreeData* data;
+  VALUE node_capacity;
+  long capacity;
+
+  TypedData_Get_Struct(self, RGeo_STRtreeData, &rgeo_strtree_type, data);
+  if (data->tree) {
+    rb_raise(rb_eRGeoError, "STRtree is already initialized");
+  }
+  rb_scan_args(argc, argv, "01", &node_capacity);
+  if (!NIL_P(node_capacity)) {
+    capacity = NUM2LONG(node_capacity);
+    if (capacity < 2) {
+      rb_raise(rb_eArgError, "Node capacity must be at least 2");
+    }
+    data->node_capacity = (size_t)capacity;
+  }
+  data->tree = GEOSSTRtree_create_r(rgeo_geos_context(), data->node_capacity);
+  if (!data->tree) {
+    rb_raise(rb_eGeosError, "Unable to create an STRtree");
+  }
+  return self;
+}
+
+/*
+ * call-seq:
+ *   tree.insert(geometry, payload = geometry) -> tree
+ *
+ * Inserts a CAPI geometry, indexed by its envelope. Queries return the
+ * payload, which defaults to the geometry itself.
+ */
+static VALUE
+method_strtree_insert(int argc, VALUE* argv, VALUE self)
+{
+  RGeo_STRtreeData* data;
+  VALUE geometry;
+  VALUE payload;
+
+  data = get_strtree_data(self);
+  check_not_built(data);
+  if (rb_scan_args(argc, argv, "11", &geometry, &payload) == 1) {
+    payload = geometry;
+  }
+  insert_geometry(data, geometry, payload);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   tree.insert_bbox(min_x, min_y, max_x, max_y, payload) -> tree
+ *
+ * Inserts a bounding box with an arbitrary payload.
+ */
+static VALUE
+method_strtree_insert_bbox(VALUE self,
+                           VALUE min_x,
+                           VALUE min_y,
+                           VALUE max_x,
+                           VALUE max_y,
+                           VALUE payload)
+{
+  RGeo_STRtreeData* data;
+
+  data = get_strtree_data(self);
+  check_not_built(data);
+  insert_bbox(data,
+              rb_num2dbl(min_x),
+              rb_num2dbl(min_y),
+              rb_num2dbl(max_x),
+              rb_num2dbl(max_y),
+              payload);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   tree.load(geometries, payloads = geometries) -> tree
+ *
+ * Bulk inserts an array of CAPI geometries. If given, payloads must be an
+ * array of the same length.
+ */
+static VALUE
+method_strtree_load(int argc, VALUE* argv, VALUE self)
+{
+  RGeo_STRtreeData* data;
+  VALUE geometries;
+  VALUE payloads;
+  VALUE geometry;
+  long len;
+  long i;
+
+  data = get_strtree_data(self);
+  check_not_built(data);
+  rb_scan_args(argc, argv, "11", &geometries, &payloads);
+  Check_Type(geometries, T_ARRAY);
+  len = RARRAY_LEN(geometries);
+  if (!NIL_P(payloads)) {
+    Check_Type(payloads, T_ARRAY);
+    if (RARRAY_LEN(payloads) != len) {
+      rb_raise(rb_eArgError,
+               "Expected %ld payloads, got %ld",
+               len,
+               RARRAY_LEN(payloads));
+    }
+  }
+  reserve_entries(data, (size_t)len);
+  for (i = 0; i < len; ++i) {
+    geometry = rb_ary_entry(geometries, i);
+    insert_geometry(data,
+                    geometry,
+                    NIL_P(payloads) ? geometry : rb_ary_entry(payloads, i));
+  }
+  return self;
+}
+
+/*
+ * call-seq:
+ *   tree.load_bboxes(bounds, payloads) -> tree
+ *
+ * Bulk inserts bounding boxes. bounds is either a flat array of numbers,
+ * or a string of native doubles as built by <tt>pack("d*")</tt>, holding
+ * min_x, min_y, max_x and max_y for each box in turn. payloads is an
+ * array with one payload per box.
+ */
+static VALUE
+method_strtree_load_bboxes(VALUE self, VALUE bounds, VALUE payloads)
+{
+  RGeo_STRtreeData* data;
+  double box[4];
+  long count;
+  long i;
+
+  data = get_strtree_data(self);
+  check_not_built(data);
+  Check_Type(payloads, T_ARRAY);
+  count = RARRAY_LEN(payloads);
+  if (RB_TYPE_P(bounds, T_STRING)) {
+    if (RSTRING_LEN(bounds) != count * 4 * (long)sizeof(double)) {
+      rb_raise(rb_eArgError,
+               "Expected %ld bytes of bounds, got %ld",
+               count * 4 * (long)sizeof(double),
+               RSTRING_LEN(bounds));
+    }
+    reserve_entries(data, (size_t)count);
+    for (i = 0; i < count; ++i) {
+      // The string buffer may not be aligned for doubles.
+      memcpy(box, RSTRING_PTR(bounds) + i * sizeof(box), sizeof(box));
+      insert_bbox(
+        data, box[0], box[1], box[2], box[3], rb_ary_entry(payloads, i));
+    }
+  } else {
+    Check_Type(bounds, T_ARRAY);
+    if (RARRAY_LEN(bounds) != count * 4) {
+      rb_raise(rb_eArgError,
+               "Expected %ld bounds, got %ld",
+               count * 4,
+               RARRAY_LEN(bounds));
+    }
+    reserve_entries(data, (size_t)count);
+    for (i = 0; i < count; ++i) {
+      insert_bbox(data,
+                  rb_num2dbl(rb_ary_entry(bounds, i * 4)),
+                  rb_num2dbl(rb_ary_entry(bounds, i * 4 + 1)),
+                  rb_num2dbl(rb_ary_entry(bounds, i * 4 + 2)),
+                  rb_num2dbl(rb_ary_entry(bounds, i * 4 + 3)),
+                  rb_ary_entry(payloads, i));
+    }
+  }
+  return self;
+}
+
+/*
+ * call-seq:
+ *   tree.build -> tree
+ *
+ * Builds the tree. This is otherwise done by the first query. No entry
+ * can be inserted once the tree is built.
+ */
+static VALUE
+method_strtree_build(VALUE self)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_STRtreeData* data;
+
+  data = get_strtree_data(self);
+  if (!data->built) {
+#ifdef RGEO_GEOS_SUPPORTS_STRTREE_BUILD
+    GEOSSTRtree_build_r(context, data->tree);
+#else
+    GEOSGeometry* bbox = create_bbox_geometry(context, 0, 0, 0, 0);
+    GEOSSTRtree_query_r(context, data->tree, bbox, ignore_match, NULL);
+    GEOSGeom_destroy_r(context, bbox);
+#endif
+    data->built = 1;
+  }
+  return self;
+}
+
+static VALUE
+method_strtree_built_p(VALUE self)
+{
+  return get_strtree_data(self)->built ? Qtrue : Qfalse;
+}
+
+static VALUE
+method_strtree_size(VALUE self)
+{
+  return SIZET2NUM(get_strtree_data(self)->size);
+}
+
+/*
+ * call-seq:
+ *   tree.query(envelope) -> array
+ *
+ * Returns the payloads of the entries whose envelope intersects the given
+ * envelope, which is a CAPI geometry or an array of bounds
+ * [min_x, min_y, max_x, max_y]. The order of the results is unspecified.
+ */
+static VALUE
+method_strtree_query(VALUE self, VALUE envelope)
+{
+  RGeo_STRtreeData* data;
+  RGeo_STRtreeMatches matches;
+  VALUE result;
+  size_t i;
+
+  data = get_strtree_data(self);
+  query_matches(data, envelope, &matches);
+  result = rb_ary_new_capa((long)matches.size);
+  for (i = 0; i < matches.size; ++i) {
+    rb_ary_push(result, data->entries[matches.indexes[i]].payload);
+  }
+  free(matches.indexes);
+  return result;
+}
+
+/*
+ * call-seq:
+ *   tree.query_each(envelope) { |payload| ... } -> tree
+ *
+ * Same as #query, but yields each payload instead of building an array.
+ */
+static VALUE
+method_strtree_query_each(VALUE self, VALUE envelope)
+{
+  RGeo_STRtreeData* data;
+  RGeo_STRtreeMatches matches;
+  RGeo_STRtreeYieldArgs args;
+
+  RETURN_ENUMERATOR(self, 1, &envelope);
+  data = get_strtree_data(self);
+  query_matches(data, envelope, &matches);
+  args.data = data;
+  args.matches = &matches;
+  rb_ensure(yield_matches, (VALUE)&args, free_matches, (VALUE)&matches);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   tree.nearest(geometry, k = 1) -> array
+ *
+ * Returns the k entries nearest to the given CAPI geometry, as
+ * [geometry, payload, distance] triples sorted by distance. geometry is
+ * nil for entries inserted as bounding boxes. Distances are exact
+ * distances to the entry geometries, or to the boxes.
+ *
+ * Each neighbor requires a search of the tree, in which the entries
+ * already found are still visited and skipped, so the cost grows with k
+ * times the cost of a single nearest search, independently of the size
+ * of the tree: this is meant for small values of k. See #nearest_within
+ * for larger sets.
+ */
+static VALUE
+method_strtree_nearest(int argc, VALUE* argv, VALUE self)
+{
+  RGeo_STRtreeData* data;
+  RGeo_STRtreeNearestArgs args;
+  RGeo_STRtreeNeighbor* neighbors;
+  VALUE geometry;
+  VALUE k;
+  VALUE result;
+  VALUE neighbors_buffer;
+  VALUE found_buffer;
+  const GEOSGeometry* geom;
+  const void* item;
+  size_t count;
+  size_t max_count;
+  size_t index;
+  long k_value;
+
+  data = get_strtree_data(self);
+  rb_scan_args(argc, argv, "11", &geometry, &k);
+  geom = get_inserted_geometry(geometry);
+  k_value = NIL_P(k) ? 1 : NUM2LONG(k);
+  if (k_value < 0) {
+    rb_raise(rb_eArgError, "k must not be negative");
+  }
+  max_count = (size_t)k_value < data->size ? (size_t)k_value : data->size;
+  init_nearest_args(&args, data, geom);
+  if (max_count == 0 || GEOSisEmpty_r(args.context, geom)) {
+    return rb_ary_new();
+  }
+
+  neighbors =
+    ALLOCV_N(RGeo_STRtreeNeighbor, neighbors_buffer, max_count);
+  args.found = ALLOCV_N(size_t, found_buffer, max_count);
+  for (count = 0; count < max_count; ++count) {
+    item = GEOSSTRtree_nearest_generic_r(args.context,
+                                         data->tree,
+                                         RGEO_STRTREE_QUERY_ITEM,
+                                         geom,
+                                         nearest_distance,
+                                         &args);
+    data->built = 1;
+    if (!item) {
+      break;
+    }
+    index = RGEO_STRTREE_INDEX(item);
+    if (is_excluded(&args, index)) {
+      break;
+    }
+    neighbors[count].index = index;
+    if (!entry_distance(&args, index, &neighbors[count].distance)) {
+      rb_raise(rb_eGeosError, "Unable to compute a distance");
+    }
+    add_found(&args, index);
+  }
+  result = neighbors_to_array(data, neighbors, count);
+  ALLOCV_END(neighbors_buffer);
+  ALLOCV_END(found_buffer);
+  RB_GC_GUARD(geometry);
+  return result;
+}
+
+/*
+ * call-seq:
+ *   tree.nearest_within(geometry, radius, limit = nil) -> array
+ *
+ * Returns the entries within radius of the given CAPI geometry, as
+ * [geometry, payload, distance] triples sorted by distance, up to limit
+ * entries if given. See #nearest.
+ */
+static VALUE
+method_strtree_nearest_within(int argc, VALUE* argv, VALUE self)
+{
+  RGeo_STRtreeData* data;
+  RGeo_STRtreeNearestArgs args;
+  RGeo_STRtreeMatches matches;
+  RGeo_STRtreeWithinArgs within;
+  VALUE geometry;
+  VALUE radius;
+  VALUE limit;
+  VALUE result;
+  const GEOSGeometry* geom;
+  GEOSGeometry* bbox;
+  double bounds[4];
+
+  data = get_strtree_data(self);
+  rb_scan_args(argc, argv, "21", &geometry, &radius, &limit);
+  geom = get_inserted_geometry(geometry);
+  within.radius = rb_num2dbl(radius);
+  if (within.radius < 0) {
+    rb_raise(rb_eArgError, "Radius must not be negative");
+  }
+  within.limit = NIL_P(limit) ? -1 : NUM2LONG(limit);
+  init_nearest_args(&args, data, geom);
+  if (within.limit == 0 || GEOSisEmpty_r(args.context, geom)) {
+    return rb_ary_new();
+  }
+
+  GEOSGeom_getXMin_r(args.context, geom, &bounds[0]);
+  GEOSGeom_getYMin_r(args.context, geom, &bounds[1]);
+  GEOSGeom_getXMax_r(args.context, geom, &bounds[2]);
+  GEOSGeom_getYMax_r(args.context, geom, &bounds[3]);
+  bbox = create_bbox_geometry(args.context,
+                              bounds[0] - within.radius,
+                              bounds[1] - within.radius,
+                              bounds[2] + within.radius,
+                              bounds[3] + within.radius);
+  collect_matches(args.context, data, bbox, &matches);
+  GEOSGeom_destroy_r(args.context, bbox);
+  if (matches.failed) {
+    free(matches.indexes);
+    rb_memerror();
+  }
+  within.args = &args;
+  within.matches = &matches;
+  result = rb_ensure(
+    within_neighbors, (VALUE)&within, free_matches, (VALUE)&matches);
+  RB_GC_GUARD(geometry);
+  return result;
+}
+
+void
+rgeo_init_geos_strtree()
+{
+  VALUE strtree_class;
+
+  strtree_class =
+    rb_define_class_under(rgeo_geos_module, "STRtree", rb_cObject);
+  rb_define_alloc_func(strtree_class, alloc_strtree);
+  rb_undef_method(strtree_class, "initialize_copy");
+  rb_define_method(strtree_class, "initialize", method_strtree_initialize, -1);
+  rb_define_method(strtree_class, "insert", method_strtree_insert, -1);
+  rb_define_method(strtree_class, "insert_bbox", method_strtree_insert_bbox, 5);
+  rb_define_method(strtree_class, "load", method_strtree_load, -1);
+  rb_define_method(
+    strtree_class, "load_bboxes", method_strtree_load_bboxes, 2);
+  rb_define_method(strtree_class, "build", method_strtree_build, 0);
+  rb_define_method(strtree_class, "built?", method_strtree_built_p, 0);
+  rb_define_method(strtree_class, "size", method_strtree_size, 0);
+  rb_define_method(strtree_class, "query", method_strtree_query, 1);
+  rb_define_method(strtree_class, "query_each", method_strtree_query_each, 1);
+  rb_define_method(strtree_class, "nearest", method_strtree_nearest, -1);
+  rb_define_method(
+    strtree_class, "nearest_within", method_strtree_nearest_within, -1);
+}
+
+RGEO_END_C
+
+#endif
@@ -0,0 +1,69 @@
+/*
+  STRtree spatial index for GEOS wrapper
+*/
+
+#ifndef RGEO_GEOS_STRTREE_INCLUDED
+#define RGEO_GEOS_STRTREE_INCLUDED
+
+#include <geos_c.h>
+#include <ruby.h>
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+RGEO_BEGIN_C
+
+/*
+  Before GEOS 3.10, the tree keeps a pointer to the envelope of the
+  inserted geometries instead of a copy, so the geometries inserted for
+  bounding boxes live as long as the tree.
+*/
+#if GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR < 10
+#define RGEO_STRTREE_KEEPS_BBOXES
+#endif
+
+/*
+  An entry of the tree. geometry is the ruby Geometry object that was
+  inserted, or Qnil if the entry was inserted as a bounding box. bbox is
+  the GEOS geometry inserted for a bounding box, owned by the tree, or
+  NULL.
+*/
+typedef struct
+{
+  VALUE geometry;
+  VALUE payload;
+#ifdef RGEO_STRTREE_KEEPS_BBOXES
+  GEOSGeometry* bbox;
+#endif
+} RGeo_STRtreeEntry;
+
+/*
+  Wrapped structure for STRtree objects.
+  GEOS items identify entries by their index in the entries array. The
+  bounds array, allocated once a bounding box is inserted, holds min_x,
+  min_y, max_x and max_y for each entry inserted as a bounding box. GEOS
+  builds the tree on the first query, after which no entry can be
+  inserted.
+*/
+typedef struct
+{
+  GEOSSTRtree* tree;
+  RGeo_STRtreeEntry* entries;
+  double* bounds;
+  size_t size;
+  size_t capacity;
+  size_t node_capacity;
+  char built;
+} RGeo_STRtreeData;
+
+/*
+  Initializes the STRtree module. This should be called after
+  the geometry module is initialized.
+*/
+void
+rgeo_init_geos_strtree();
+
+RGEO_END_C
+
+#endif // RGEO_GEOS_SUPPORTED
+
+#endif // RGEO_GEOS_STRTREE_INCLUDED
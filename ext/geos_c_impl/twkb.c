@@ -0,0 +1,790 @@
+/*
+  TWKB (Tiny Well-Known Binary) serialization for GEOS wrapper
+
+  Each geometry starts with a type and precision byte and a metadata byte,
+  followed by an extended dimensions byte for Z and M data. Coordinates are
+  rounded to integers with the given precision and written as differences
+  from the previous coordinate, as zigzag encoded varints. See
+  https://github.com/TWKB/Specification.
+*/
+
+#include "preface.h"
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+#include <geos_c.h>
+#include <math.h>
+#include <ruby.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+#include "factory.h"
+#include "globals.h"
+#include "nogvl.h"
+#include "twkb.h"
+
+RGEO_BEGIN_C
+
+#define RGEO_TWKB_BBOX 0x01
+#define RGEO_TWKB_SIZE 0x02
+#define RGEO_TWKB_ID_LIST 0x04
+#define RGEO_TWKB_EXTENDED_DIMS 0x08
+#define RGEO_TWKB_EMPTY 0x10
+
+// Rounded coordinates stay far enough from the int64_t limits that their
+// differences cannot overflow.
+#define RGEO_TWKB_MAX_VALUE 4.0e18
+
+// Nesting depth up to which collections are read. The reader recurses
+// into nested collections without the GVL, on the stack of the thread.
+#define RGEO_TWKB_MAX_DEPTH 64
+
+/*
+  Both the writer and the reader run without the GVL, so they use malloc
+  rather than ruby allocation functions, and report their own errors in
+  the error field.
+*/
+typedef struct
+{
+  const GEOSGeometry* geom;
+  unsigned char* data;
+  size_t size;
+  size_t capacity;
+  int dims;
+  unsigned char type_precision;
+  unsigned char extended_dims;
+  double scale[4];
+  int64_t last[4];
+  const char* error;
+} RGeo_TWKBWriter;
+
+typedef struct
+{
+  const unsigned char* data;
+  size_t size;
+  size_t pos;
+  int flags;
+  int dims;
+  int data_dims;
+  int ordinates[4];
+  double scale[4];
+  int64_t last[4];
+  const char* error;
+} RGeo_TWKBReader;
+
+static uint64_t
+zigzag_encode(int64_t value)
+{
+  return value < 0 ? ~((uint64_t)value << 1) : (uint64_t)value << 1;
+}
+
+static int64_t
+zigzag_decode(uint64_t value)
+{
+  return (value & 1) ? (int64_t)~(value >> 1) : (int64_t)(value >> 1);
+}
+
+/**** WRITER ****/
+
+static int
+twkb_reserve(RGeo_TWKBWriter* writer, size_t size)
+{
+  unsigned char* data;
+  size_t capacity;
+
+  if (writer->size + size <= writer->capacity) {
+    return 1;
+  }
+  capacity = writer->capacity ? writer->capacity * 2 : 64;
+  while (capacity < writer->size + size) {
+    capacity *= 2;
+  }
+  data = (unsigned char*)realloc(writer->data, capacity);
+  if (!data) {
+    writer->error = "Out of memory";
+    return 0;
+  }
+  writer->data = data;
+  writer->capacity = capacity;
+  return 1;
+}
+
+static int
+twkb_put_byte(RGeo_TWKBWriter* writer, unsigned char byte)
+{
+  if (!twkb_reserve(writer, 1)) {
+    return 0;
+  }
+  writer->data[writer->size++] = byte;
+  return 1;
+}
+
+static int
+twkb_put_varint(RGeo_TWKBWriter* writer, uint64_t value)
+{
+  if (!twkb_reserve(writer, 10)) {
+    return 0;
+  }
+  while (value >= 0x80) {
+    writer->data[writer->size++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  writer->data[writer->size++] = (unsigned char)value;
+  return 1;
+}
+
+// Writes the coordinates of coord_seq, preceded by their count unless
+// the sequence is the one of a point.
+
+static int
+twkb_put_coordinates(RGeo_TWKBWriter* writer,
+                     const GEOSCoordSequence* coord_seq,
+                     char with_count)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  unsigned int size;
+  unsigned int i;
+  int d;
+  double value;
+  double scaled;
+  int64_t rounded;
+
+  if (!coord_seq || !GEOSCoordSeq_getSize_r(context, coord_seq, &size)) {
+    return 0;
+  }
+  if (with_count && !twkb_put_varint(writer, size)) {
+    return 0;
+  }
+  for (i = 0; i < size; ++i) {
+    for (d = 0; d < writer->dims; ++d) {
+      if (!GEOSCoordSeq_getOrdinate_r(context, coord_seq, i, d, &value)) {
+        return 0;
+      }
+      // 2D geometries of a 3D factory have no Z or M values.
+      if (d >= 2 && isnan(value)) {
+        value = 0;
+      }
+      scaled = value * writer->scale[d];
+      if (!(fabs(scaled) < RGEO_TWKB_MAX_VALUE)) {
+        writer->error = "Coordinate cannot be written with this TWKB precision";
+        return 0;
+      }
+      rounded = llround(scaled);
+      if (!twkb_put_varint(writer, zigzag_encode(rounded - writer->last[d]))) {
+        return 0;
+      }
+      writer->last[d] = rounded;
+    }
+  }
+  return 1;
+}
+
+static int
+twkb_put_polygon(RGeo_TWKBWriter* writer, const GEOSGeometry* geom)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  const GEOSGeometry* ring;
+  int count;
+  int i;
+
+  if (GEOSisEmpty_r(context, geom)) {
+    return twkb_put_varint(writer, 0);
+  }
+  count = GEOSGetNumInteriorRings_r(context, geom);
+  ring = GEOSGetExteriorRing_r(context, geom);
+  if (count < 0 || !ring || !twkb_put_varint(writer, (uint64_t)count + 1) ||
+      !twkb_put_coordinates(
+        writer, GEOSGeom_getCoordSeq_r(context, ring), 1)) {
+    return 0;
+  }
+  for (i = 0; i < count; ++i) {
+    ring = GEOSGetInteriorRingN_r(context, geom, i);
+    if (!ring || !twkb_put_coordinates(
+                   writer, GEOSGeom_getCoordSeq_r(context, ring), 1)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int
+twkb_put_geometry(RGeo_TWKBWriter* writer, const GEOSGeometry* geom)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  const GEOSGeometry* part;
+  unsigned char type;
+  char empty;
+  int count;
+  int i;
+
+  switch (GEOSGeomTypeId_r(context, geom)) {
+    case GEOS_POINT:
+      type = 1;
+      break;
+    case GEOS_LINESTRING:
+    case GEOS_LINEARRING:
+      type = 2;
+      break;
+    case GEOS_POLYGON:
+      type = 3;
+      break;
+    case GEOS_MULTIPOINT:
+      type = 4;
+      break;
+    case GEOS_MULTILINESTRING:
+      type = 5;
+      break;
+    case GEOS_MULTIPOLYGON:
+      type = 6;
+      break;
+    case GEOS_GEOMETRYCOLLECTION:
+      type = 7;
+      break;
+    default:
+      return 0;
+  }
+  empty = GEOSisEmpty_r(context, geom);
+  if (empty == 2 || !twkb_put_byte(writer, type | writer->type_precision) ||
+      !twkb_put_byte(
+        writer,
+        (writer->extended_dims ? RGEO_TWKB_EXTENDED_DIMS : 0) |
+          (empty ? RGEO_TWKB_EMPTY : 0)) ||
+      (writer->extended_dims &&
+       !twkb_put_byte(writer, writer->extended_dims))) {
+    return 0;
+  }
+  if (empty) {
+    return 1;
+  }
+
+  memset(writer->last, 0, sizeof(writer->last));
+  switch (type) {
+    case 1:
+      return twkb_put_coordinates(
+        writer, GEOSGeom_getCoordSeq_r(context, geom), 0);
+    case 2:
+      return twkb_put_coordinates(
+        writer, GEOSGeom_getCoordSeq_r(context, geom), 1);
+    case 3:
+      return twkb_put_polygon(writer, geom);
+  }
+
+  // Parts of multi geometries continue from the coordinates of the
+  // previous part, while those of collections are whole TWKB geometries.
+  count = GEOSGetNumGeometries_r(context, geom);
+  if (count < 0 || !twkb_put_varint(writer, (uint64_t)count)) {
+    return 0;
+  }
+  for (i = 0; i < count; ++i) {
+    part = GEOSGetGeometryN_r(context, geom, i);
+    if (!part) {
+      return 0;
+    }
+    switch (type) {
+      case 4:
+        if (GEOSisEmpty_r(context, part)) {
+          writer->error = "TWKB cannot hold empty points in multi points";
+          return 0;
+        }
+        if (!twkb_put_coordinates(
+              writer, GEOSGeom_getCoordSeq_r(context, part), 0)) {
+          return 0;
+        }
+        break;
+      case 5:
+        if (!twkb_put_coordinates(
+              writer, GEOSGeom_getCoordSeq_r(context, part), 1)) {
+          return 0;
+        }
+        break;
+      case 6:
+        if (!twkb_put_polygon(writer, part)) {
+          return 0;
+        }
+        break;
+      default:
+        if (!twkb_put_geometry(writer, part)) {
+          return 0;
+        }
+    }
+  }
+  return 1;
+}
+
+static void*
+write_twkb_nogvl(void* data)
+{
+  RGeo_TWKBWriter* writer = (RGeo_TWKBWriter*)data;
+
+  return twkb_put_geometry(writer, writer->geom) ? writer : NULL;
+}
+
+VALUE
+rgeo_write_twkb(const GEOSGeometry* geom,
+                int flags,
+                int precision,
+                int z_precision)
+{
+  RGeo_TWKBWriter writer;
+  void* written;
+  VALUE result;
+  int state = 0;
+
+  if (precision < -8 || precision > 7) {
+    rb_raise(rb_eArgError, "TWKB precision must be between -8 and 7");
+  }
+  if (z_precision < 0 || z_precision > 7) {
+    rb_raise(rb_eArgError, "TWKB Z precision must be between 0 and 7");
+  }
+  memset(&writer, 0, sizeof(RGeo_TWKBWriter));
+  writer.geom = geom;
+  writer.dims = 2;
+  writer.type_precision = (unsigned char)(zigzag_encode(precision) << 4);
+  writer.scale[0] = writer.scale[1] = pow(10, precision);
+  if (RGEO_FACTORY_DIMS(flags) == 4) {
+    writer.dims = 4;
+    writer.scale[2] = writer.scale[3] = pow(10, z_precision);
+    writer.extended_dims =
+      (unsigned char)(0x03 | z_precision << 2 | z_precision << 5);
+  } else if (flags & RGEO_FACTORYFLAGS_SUPPORTS_Z_OR_M) {
+    writer.dims = 3;
+    writer.scale[2] = pow(10, z_precision);
+    writer.extended_dims = (flags & RGEO_FACTORYFLAGS_SUPPORTS_Z)
+                             ? (unsigned char)(0x01 | z_precision << 2)
+                             : (unsigned char)(0x02 | z_precision << 5);
+  }
+
+  written = rgeo_without_gvl(write_twkb_nogvl, &writer, &state);
+  result = Qnil;
+  if (written && !state) {
+    result = rb_str_new((const char*)writer.data, (long)writer.size);
+  }
+  free(writer.data);
+  if (state) {
+    rb_jump_tag(state);
+  }
+  if (!written) {
+    rb_raise(rb_eRGeoUnsupportedOperation,
+             "%s",
+             writer.error ? writer.error : "Cannot write TWKB");
+  }
+  return result;
+}
+
+/**** READER ****/
+
+static int
+twkb_get_byte(RGeo_TWKBReader* reader, unsigned char* byte)
+{
+  if (reader->pos >= reader->size) {
+    reader->error = "Unexpected end of TWKB data";
+    return 0;
+  }
+  *byte = reader->data[reader->pos++];
+  return 1;
+}
+
+static int
+twkb_get_varint(RGeo_TWKBReader* reader, uint64_t* value)
+{
+  unsigned char byte;
+  int shift;
+
+  *value = 0;
+  for (shift = 0; shift < 64; shift += 7) {
+    if (!twkb_get_byte(reader, &byte)) {
+      return 0;
+    }
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return 1;
+    }
+  }
+  reader->error = "Bad varint in TWKB data";
+  return 0;
+}
+
+// Reads a number of items, each of which takes at least item_size bytes.
+// This bounds what is allocated for bad data.
+
+static int
+twkb_get_count(RGeo_TWKBReader* reader,
+               unsigned int* count,
+               size_t item_size)
+{
+  uint64_t value;
+
+  if (!twkb_get_varint(reader, &value)) {
+    return 0;
+  }
+  if (value > (reader->size - reader->pos) / item_size) {
+    reader->error = "Bad count in TWKB data";
+    return 0;
+  }
+  *count = (unsigned int)value;
+  return 1;
+}
+
+static GEOSCoordSequence*
+twkb_get_coordinates(RGeo_TWKBReader* reader, unsigned int size)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSCoordSequence* coord_seq;
+  unsigned int i;
+  int d;
+  uint64_t delta;
+
+  coord_seq = GEOSCoordSeq_create_r(context, size, reader->dims);
+  if (!coord_seq) {
+    return NULL;
+  }
+  for (i = 0; i < size; ++i) {
+    for (d = 2; d < reader->dims; ++d) {
+      GEOSCoordSeq_setOrdinate_r(context, coord_seq, i, d, 0);
+    }
+    for (d = 0; d < reader->data_dims; ++d) {
+      if (!twkb_get_varint(reader, &delta)) {
+        GEOSCoordSeq_destroy_r(context, coord_seq);
+        return NULL;
+      }
+      reader->last[d] =
+        (int64_t)((uint64_t)reader->last[d] + (uint64_t)zigzag_decode(delta));
+      GEOSCoordSeq_setOrdinate_r(context,
+                                 coord_seq,
+                                 i,
+                                 reader->ordinates[d],
+                                 (double)reader->last[d] / reader->scale[d]);
+    }
+  }
+  return coord_seq;
+}
+
+static GEOSGeometry*
+twkb_get_line(RGeo_TWKBReader* reader, char ring)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSCoordSequence* coord_seq;
+  unsigned int size;
+
+  if (!twkb_get_count(reader, &size, reader->data_dims)) {
+    return NULL;
+  }
+  coord_seq = twkb_get_coordinates(reader, size);
+  if (!coord_seq) {
+    return NULL;
+  }
+  return ring ? GEOSGeom_createLinearRing_r(context, coord_seq)
+              : GEOSGeom_createLineString_r(context, coord_seq);
+}
+
+static GEOSGeometry*
+twkb_get_polygon(RGeo_TWKBReader* reader)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSGeometry** rings;
+  GEOSGeometry* result;
+  unsigned int count;
+  unsigned int i;
+
+  if (!twkb_get_count(reader, &count, 1)) {
+    return NULL;
+  }
+  if (!count) {
+    return GEOSGeom_createEmptyPolygon_r(context);
+  }
+  rings = (GEOSGeometry**)malloc(count * sizeof(GEOSGeometry*));
+  if (!rings) {
+    reader->error = "Out of memory";
+    return NULL;
+  }
+  for (i = 0; i < count; ++i) {
+    rings[i] = twkb_get_line(reader, 1);
+    if (!rings[i]) {
+      break;
+    }
+  }
+  result = NULL;
+  if (i == count) {
+    // The polygon takes ownership of the rings.
+    result = GEOSGeom_createPolygon_r(context, rings[0], rings + 1, count - 1);
+  } else {
+    while (i > 0) {
+      GEOSGeom_destroy_r(context, rings[--i]);
+    }
+  }
+  free(rings);
+  return result;
+}
+
+static GEOSGeometry*
+twkb_get_geometry(RGeo_TWKBReader* reader, int depth);
+
+static GEOSGeometry*
+twkb_get_parts(RGeo_TWKBReader* reader, int type, char id_list, int depth)
+{
+  static const int geos_types[] = { GEOS_MULTIPOINT,
+                                    GEOS_MULTILINESTRING,
+                                    GEOS_MULTIPOLYGON,
+                                    GEOS_GEOMETRYCOLLECTION };
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSCoordSequence* coord_seq;
+  GEOSGeometry** parts;
+  GEOSGeometry* result;
+  unsigned int count;
+  unsigned int i;
+  uint64_t id;
+
+  if (!twkb_get_count(reader, &count, type == 4 ? reader->data_dims : 1)) {
+    return NULL;
+  }
+  if (id_list) {
+    for (i = 0; i < count; ++i) {
+      if (!twkb_get_varint(reader, &id)) {
+        return NULL;
+      }
+    }
+  }
+  parts = (GEOSGeometry**)malloc((count ? count : 1) * sizeof(GEOSGeometry*));
+  if (!parts) {
+    reader->error = "Out of memory";
+    return NULL;
+  }
+  for (i = 0; i < count; ++i) {
+    switch (type) {
+      case 4:
+        coord_seq = twkb_get_coordinates(reader, 1);
+        parts[i] =
+          coord_seq ? GEOSGeom_createPoint_r(context, coord_seq) : NULL;
+        break;
+      case 5:
+        parts[i] = twkb_get_line(reader, 0);
+        break;
+      case 6:
+        parts[i] = twkb_get_polygon(reader);
+        break;
+      default:
+        parts[i] = twkb_get_geometry(reader, depth + 1);
+    }
+    if (!parts[i]) {
+      break;
+    }
+  }
+  result = NULL;
+  if (i == count) {
+    result = GEOSGeom_createCollection_r(
+      context, geos_types[type - 4], parts, count);
+  } else {
+    while (i > 0) {
+      GEOSGeom_destroy_r(context, parts[--i]);
+    }
+  }
+  free(parts);
+  return result;
+}
+
+static GEOSGeometry*
+twkb_get_geometry(RGeo_TWKBReader* reader, int depth)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  GEOSCoordSequence* coord_seq;
+  unsigned char type_precision;
+  unsigned char metadata;
+  unsigned char extended_dims;
+  uint64_t value;
+  int type;
+  int i;
+
+  if (depth > RGEO_TWKB_MAX_DEPTH) {
+    reader->error = "TWKB collections are nested too deeply";
+    return NULL;
+  }
+  if (!twkb_get_byte(reader, &type_precision) ||
+      !twkb_get_byte(reader, &metadata)) {
+    return NULL;
+  }
+  type = type_precision & 0x0f;
+  reader->scale[0] = reader->scale[1] =
+    pow(10, (double)zigzag_decode(type_precision >> 4));
+  reader->data_dims = 2;
+  for (i = 0; i < 4; ++i) {
+    reader->ordinates[i] = i;
+  }
+  if (metadata & RGEO_TWKB_EXTENDED_DIMS) {
+    if (!twkb_get_byte(reader, &extended_dims)) {
+      return NULL;
+    }
+    if ((extended_dims & 0x01) &&
+        !(reader->flags & RGEO_FACTORYFLAGS_SUPPORTS_Z)) {
+      reader->error =
+        "Data has Z coordinates but the factory doesn't have Z coordinates";
+      return NULL;
+    }
+    if ((extended_dims & 0x02) &&
+        !(reader->flags & RGEO_FACTORYFLAGS_SUPPORTS_M)) {
+      reader->error =
+        "Data has M coordinates but the factory doesn't have M coordinates";
+      return NULL;
+    }
+    if ((extended_dims & 0x03) == 0x03) {
+      reader->data_dims = 4;
+      reader->scale[2] = pow(10, (extended_dims >> 2) & 7);
+      reader->scale[3] = pow(10, (extended_dims >> 5) & 7);
+    } else if (extended_dims & 0x03) {
+      reader->data_dims = 3;
+      reader->scale[2] = pow(10,
+                             (extended_dims & 0x01) ? (extended_dims >> 2) & 7
+                                                    : (extended_dims >> 5) & 7);
+      // Factories with both Z and M keep M apart from Z.
+      if ((extended_dims & 0x02) && reader->dims == 4) {
+        reader->ordinates[2] = 3;
+      }
+    }
+  }
+  if (metadata & RGEO_TWKB_SIZE) {
+    if (!twkb_get_varint(reader, &value)) {
+      return NULL;
+    }
+  }
+  if (metadata & RGEO_TWKB_BBOX) {
+    for (i = 0; i < reader->data_dims * 2; ++i) {
+      if (!twkb_get_varint(reader, &value)) {
+        return NULL;
+      }
+    }
+  }
+
+  if (metadata & RGEO_TWKB_EMPTY) {
+    switch (type) {
+      case 1:
+        return GEOSGeom_createEmptyPoint_r(context);
+      case 2:
+        return GEOSGeom_createEmptyLineString_r(context);
+      case 3:
+        return GEOSGeom_createEmptyPolygon_r(context);
+      case 4:
+        return GEOSGeom_createEmptyCollection_r(context, GEOS_MULTIPOINT);
+      case 5:
+        return GEOSGeom_createEmptyCollection_r(context,
+                                                GEOS_MULTILINESTRING);
+      case 6:
+        return GEOSGeom_createEmptyCollection_r(context, GEOS_MULTIPOLYGON);
+      case 7:
+        return GEOSGeom_createEmptyCollection_r(context,
+                                                GEOS_GEOMETRYCOLLECTION);
+    }
+  }
+
+  memset(reader->last, 0, sizeof(reader->last));
+  switch (type) {
+    case 1:
+      coord_seq = twkb_get_coordinates(reader, 1);
+      return coord_seq ? GEOSGeom_createPoint_r(context, coord_seq) : NULL;
+    case 2:
+      return twkb_get_line(reader, 0);
+    case 3:
+      return twkb_get_polygon(reader);
+    case 4:
+    case 5:
+    case 6:
+    case 7:
+      return twkb_get_parts(
+        reader, type, (metadata & RGEO_TWKB_ID_LIST) != 0, depth);
+  }
+  reader->error = "Unknown TWKB geometry type";
+  return NULL;
+}
+
+static void*
+read_twkb_nogvl(void* data)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_TWKBReader* reader = (RGeo_TWKBReader*)data;
+  GEOSGeometry* geom;
+
+  geom = twkb_get_geometry(reader, 0);
+  if (geom && reader->pos != reader->size) {
+    reader->error = "Found extra bytes at the end of the TWKB data";
+    GEOSGeom_destroy_r(context, geom);
+    geom = NULL;
+  }
+  return geom;
+}
+
+VALUE
+rgeo_read_twkb(VALUE factory, VALUE str)
+{
+  GEOSContextHandle_t context = rgeo_geos_context();
+  RGeo_TWKBReader reader;
+  GEOSGeometry* geom;
+  int state = 0;
+
+  Check_Type(str, T_STRING);
+  str = rb_str_new_frozen(str);
+  memset(&reader, 0, sizeof(RGeo_TWKBReader));
+  reader.data = (const unsigned char*)RSTRING_PTR(str);
+  reader.size = (size_t)RSTRING_LEN(str);
+  reader.flags = RGEO_FACTORY_DATA_PTR(factory)->flags;
+  reader.dims = RGEO_FACTORY_DIMS(reader.flags);
+  geom = (GEOSGeometry*)rgeo_without_gvl(read_twkb_nogvl, &reader, &state);
+  RB_GC_GUARD(str);
+  if (state) {
+    if (geom) {
+      GEOSGeom_destroy_r(context, geom);
+    }
+    rb_jump_tag(state);
+  }
+  if (!geom) {
+    rb_raise(rb_eRGeoParseError,
+             "%s",
+             reader.error ? reader.error : "Cannot read TWKB data");
+  }
+  return rgeo_wrap_geos_geometry(factory, geom, Qnil);
+}
+
+/**** RUBY METHOD DEFINITIONS ****/
+
+static VALUE
+method_geometry_as_twkb(VALUE self, VALUE precision, VALUE z_precision)
+{
+  RGeo_GeometryData* self_data;
+  VALUE result;
+
+  self_data = RGEO_GEOMETRY_DATA_PTR(self);
+  if (!self_data->geom) {
+    return Qnil;
+  }
+  result = rgeo_write_twkb(self_data->geom,
+                           RGEO_FACTORY_DATA_PTR(self_data->factory)->flags,
+                           NUM2INT(precision),
+                           NUM2INT(z_precision));
+  RB_GC_GUARD(self);
+  return result;
+}
+
+static VALUE
+method_factory_parse_twkb(VALUE self, VALUE str)
+{
+  return rgeo_read_twkb(self, str);
+}
+
+void
+rgeo_init_geos_twkb()
+{
+  VALUE geos_geometry_methods;
+  VALUE geos_factory_class;
+
+  geos_geometry_methods =
+    rb_define_module_under(rgeo_geos_module, "CAPIGeometryMethods");
+  geos_factory_class =
+    rb_const_get_at(rgeo_geos_module, rb_intern("CAPIFactory"));
+  rb_define_method(
+    geos_geometry_methods, "_as_twkb", method_geometry_as_twkb, 2);
+  rb_define_method(
+    geos_factory_class, "_parse_twkb", method_factory_parse_twkb, 1);
+}
+
+RGEO_END_C
+
+#endif
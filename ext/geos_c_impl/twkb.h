@@ -0,0 +1,53 @@
+/*
+  TWKB (Tiny Well-Known Binary) serialization for GEOS wrapper
+*/
+
+#ifndef RGEO_GEOS_TWKB_INCLUDED
+#define RGEO_GEOS_TWKB_INCLUDED
+
+#include <geos_c.h>
+#include <ruby.h>
+
+#ifdef RGEO_GEOS_SUPPORTED
+
+RGEO_BEGIN_C
+
+/*
+  Default number of decimal digits kept for X and Y.
+*/
+#define RGEO_TWKB_DEFAULT_PRECISION 7
+
+/*
+  Returns the TWKB of the given GEOS geometry as a binary string.
+  Coordinates are rounded to precision decimal digits for X and Y, which
+  may be negative (-8 to 7), and to z_precision digits (0 to 7) for the
+  Z or M coordinates of factories with the given flags. Raises
+  RGeo::Error::UnsupportedOperation for coordinates that cannot be
+  written with that precision.
+*/
+VALUE
+rgeo_write_twkb(const GEOSGeometry* geom,
+                int flags,
+                int precision,
+                int z_precision);
+
+/*
+  Reads TWKB data from the given string and returns a geometry of the
+  given factory. Z or M coordinates are read as those of the factory,
+  and given a value of 0 for 2D data. Raises RGeo::Error::ParseError.
+*/
+VALUE
+rgeo_read_twkb(VALUE factory, VALUE str);
+
+/*
+  Initializes the TWKB module. This should be called after
+  the geometry module is initialized.
+*/
+void
+rgeo_init_geos_twkb();
+
+RGEO_END_C
+
+#endif // RGEO_GEOS_SUPPORTED
+
+#endif // RGEO_GEOS_TWKB_INCLUDED
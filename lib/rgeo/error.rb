@@ -18,6 +18,11 @@ module RGeo
     class GeosError < RGeoError
     end
 
+    # A GEOS operation was interrupted at the deadline set by
+    # RGeo::Geos.with_deadline
+    class DeadlineExceeded < GeosError
+    end
+
     # The specified geometry is invalid
     class InvalidGeometry < RGeoError
     end
@@ -28,11 +28,12 @@ module RGeo
           flags |= 2 if opts[:has_z_coordinate]
           flags |= 4 if opts[:has_m_coordinate]
 
-          if flags & 6 == 6
-            raise Error::UnsupportedOperation, "GEOS cannot support both Z and M coordinates at the same time."
+          if flags & 6 == 6 && !_supports_xyzm?
+            raise Error::UnsupportedOperation, "GEOS cannot support both Z and M coordinates at the same time before 3.12."
           end
 
           flags |= 8 unless opts[:auto_prepare] == :disabled
+          flags |= 16 if opts[:cache_output]
 
           # Buffer resolution
           buffer_resolution = opts[:buffer_resolution].to_i
@@ -82,6 +83,21 @@ module RGeo
             end
           result._set_wkrep_parsers(wkt_parser, wkb_parser)
 
+          # Preparation policy
+          result._set_prepare_policy(
+            opts[:prepare_after] || (opts[:auto_prepare] == :always ? 1 : 2),
+            opts[:prepare_min_coordinates].to_i,
+            opts[:prepare_memory_budget].to_i
+          )
+
+          # Marshal format
+          if opts[:marshal_format] || opts[:twkb_precision]
+            result._set_marshal_format(
+              (opts[:marshal_format] || :wkb).to_sym,
+              opts[:twkb_precision] || result.twkb_precision
+            )
+          end
+
           # Return the result
           result
         end
@@ -121,7 +137,10 @@ module RGeo
           "wkbg" => _wkb_generator ? _wkb_generator.properties : {},
           "wktp" => _wkt_parser ? _wkt_parser.properties : {},
           "wkbp" => _wkb_parser ? _wkb_parser.properties : {},
-          "apre" => auto_prepare
+          "apre" => auto_prepare,
+          "prep" => _prepare_policy,
+          "mfmt" => _marshal_format,
+          "outc" => cache_output?
         }
         if (coord_sys_ = _coord_sys)
           hash_["cs"] = coord_sys_.to_wkt
@@ -144,6 +163,9 @@ module RGeo
             wkt_parser: symbolize_hash(data_["wktp"]),
             wkb_parser: symbolize_hash(data_["wkbp"]),
             auto_prepare: data_["apre"],
+            **prepare_policy_options(data_["prep"]),
+            **marshal_format_options(data_["mfmt"]),
+            cache_output: data_["outc"],
             coord_sys: coord_sys_
           )
         )
@@ -161,6 +183,9 @@ module RGeo
         coder_["wkt_parser"] = _wkt_parser ? _wkt_parser.properties : {}
         coder_["wkb_parser"] = _wkb_parser ? _wkb_parser.properties : {}
         coder_["auto_prepare"] = auto_prepare
+        coder_["prepare_policy"] = _prepare_policy
+        coder_["marshal_format"] = _marshal_format.then { |format, precision| [format.to_s, precision] }
+        coder_["cache_output"] = cache_output?
 
         return unless (coord_sys_ = _coord_sys)
 
@@ -181,7 +206,10 @@ module RGeo
             wkb_generator: symbolize_hash(coder_["wkb_generator"]),
             wkt_parser: symbolize_hash(coder_["wkt_parser"]),
             wkb_parser: symbolize_hash(coder_["wkb_parser"]),
-            auto_prepare: coder_["auto_prepare"] == "disabled" ? :disabled : :simple,
+            auto_prepare: coder_["auto_prepare"]&.to_sym,
+            **prepare_policy_options(coder_["prepare_policy"]),
+            **marshal_format_options(coder_["marshal_format"]),
+            cache_output: coder_["cache_output"],
             coord_sys: coord_sys_
           )
         )
@@ -212,36 +240,179 @@ module RGeo
         when :buffer_resolution
           _buffer_resolution
         when :auto_prepare
-          prepare_heuristic? ? :simple : :disabled
+          auto_prepare
         end
       end
 
+      # Returns statistics about the prepared geometries of this factory,
+      # as a hash with the following keys:
+      #
+      # [<tt>:hits</tt>]
+      #   Predicate calls that used an existing prepared geometry.
+      # [<tt>:misses</tt>]
+      #   Predicate calls on a geometry that was not prepared yet.
+      # [<tt>:evictions</tt>]
+      #   Prepared geometries released to honor the memory budget.
+      # [<tt>:prepared</tt>]
+      #   Number of geometries currently prepared.
+      # [<tt>:bytes</tt>]
+      #   Estimated memory used by those prepared geometries.
+
+      def prepare_stats
+        _prepare_stats
+      end
+
+      # Returns true if the geometries of this factory keep the strings
+      # returned by as_text and as_binary, see the <tt>:cache_output</tt>
+      # option of RGeo::Geos.factory.
+
+      def cache_output?
+        _flags & FLAG_CACHE_OUTPUT != 0
+      end
+
+      # Returns statistics about the as_text and as_binary strings kept by
+      # the geometries of this factory, as a hash with the keys
+      # <tt>:strings</tt>, their number, and <tt>:bytes</tt>, their total
+      # size. Returns nil if the factory does not keep them.
+
+      def output_cache_stats
+        _output_cache_stats
+      end
+
       # See RGeo::Feature::Factory#parse_wkt
+      #
+      # Input that GEOS reads the same way as the configured WKT parser,
+      # including the EWKT SRID prefix, does not go through the parser.
 
       def parse_wkt(str_)
         if (wkt_parser_ = _wkt_parser)
-          wkt_parser_.parse(str_)
+          _parse_wkt_native(str_) || wkt_parser_.parse(str_)
         else
           _parse_wkt_impl(str_)
         end
       end
 
       # See RGeo::Feature::Factory#parse_wkb
-
-      def parse_wkb(str_)
-        if (wkb_parser_ = _wkb_parser)
-          wkb_parser_.parse(str_)
+      #
+      # EWKB and hex input that GEOS reads the same way as the configured
+      # WKB parser does not go through the parser.
+      #
+      # With <tt>lazy: true</tt>, the structure of the WKB is only checked,
+      # and the geometry keeps the string: it is read on its first use,
+      # other than its type, SRID, factory, bounds and as_binary. The
+      # original string is returned by as_binary, without copying it,
+      # when it has the format the factory writes. Input read differently
+      # by GEOS and the WKB parser, or with M coordinates, is not read
+      # lazily.
+
+      def parse_wkb(str_, lazy: false)
+        if lazy && (geometry_ = _parse_wkb_lazy(str_))
+          geometry_
+        elsif (wkb_parser_ = _wkb_parser)
+          _parse_wkb_native(str_) || wkb_parser_.parse(str_)
         else
           _parse_wkb_impl(str_)
         end
       end
 
+      # Reads newline delimited hex WKB records from the given IO, and
+      # yields the geometries one at a time. Returns an Enumerator if no
+      # block is given. Records are parsed as by #parse_wkb.
+      #
+      # The IO is read in chunks into a buffer that is reused, and records
+      # are parsed in place from that buffer. Blank lines are skipped.
+      #
+      # Options:
+      #
+      # [<tt>:chunk_size</tt>]
+      #   Number of bytes read from the IO at once. Default is 1 MiB.
+      # [<tt>:on_error</tt>]
+      #   A callable that receives the RGeo::Error and the text of each
+      #   record that cannot be parsed, which is then skipped. By default
+      #   the error is raised. RGeo::Error::DeadlineExceeded is always
+      #   raised.
+      #
+      # Once done, returns a hash with the number of <tt>:records</tt>
+      # yielded, <tt>:errors</tt> skipped, <tt>:bytes</tt> read and
+      # <tt>:seconds</tt> spent, and the resulting
+      # <tt>:records_per_second</tt> and <tt>:bytes_per_second</tt>.
+
+      def each_wkb(io, chunk_size: 1 << 20, on_error: nil, &block)
+        return enum_for(:each_wkb, io, chunk_size: chunk_size, on_error: on_error) unless block
+
+        each_record(io, false, chunk_size, on_error, &block)
+      end
+
+      # Writes the WKB of each geometry of the given enumerable to the IO,
+      # as #as_binary would write it, and returns the number of records
+      # written. Geometries from other factories are cast to this one.
+      #
+      # Records are appended to a single buffer, which is written to the
+      # IO and reused once it holds <tt>flush_size</tt> bytes (1 MiB by
+      # default). The <tt>format</tt> may be:
+      #
+      # [<tt>:binary</tt>]
+      #   Records one after the other. This is the default.
+      # [<tt>:hex</tt>]
+      #   One hex record per line, as read by #each_wkb.
+      # [<tt>:length_prefixed</tt>]
+      #   Each record preceded by its length, as a big endian 32 bit
+      #   unsigned integer.
+
+      def write_wkb(io, geometries, format: :binary, flush_size: 1 << 20)
+        _write_wkb(io, geometries, format, flush_size)
+      end
+
+      # Same as #each_wkb for newline delimited WKT records, parsed as by
+      # #parse_wkt.
+
+      def each_wkt(io, chunk_size: 1 << 20, on_error: nil, &block)
+        return enum_for(:each_wkt, io, chunk_size: chunk_size, on_error: on_error) unless block
+
+        each_record(io, true, chunk_size, on_error, &block)
+      end
+
+      # Parses TWKB (Tiny WKB) data, as written by
+      # CAPIGeometryMethods#as_twkb. Z or M coordinates of the data are
+      # those of this factory.
+
+      def parse_twkb(str)
+        _parse_twkb(str)
+      end
+
+      # Parses a GeoJSON geometry object with the GEOS GeoJSON reader,
+      # without building Ruby objects for the JSON document. Requires
+      # GEOS 3.10 or later, and raises RGeo::Error::UnsupportedOperation
+      # otherwise. Only the geometries of features are read; use the
+      # rgeo-geojson gem for their properties. Raises
+      # RGeo::Error::ParseError for Z values if this factory has no Z
+      # coordinates.
+
+      def parse_geojson(str)
+        _parse_geojson(str)
+      end
+
+      # Returns <tt>:wkb</tt> or <tt>:twkb</tt>, the format in which
+      # geometries of this factory are marshaled.
+
+      def marshal_format
+        _marshal_format[0]
+      end
+
+      # Returns the number of decimal digits kept for X and Y in TWKB.
+
+      def twkb_precision
+        _marshal_format[1]
+      end
+
       # See RGeo::Feature::Factory#point
 
       def point(x, y, *extra)
-        raise(RGeo::Error::InvalidGeometry, "Parse error") if extra.length > (supports_z_or_m? ? 1 : 0)
+        max_extra = supports_z_or_m? ? 1 : 0
+        max_extra = 2 if supports_z? && supports_m?
+        raise(RGeo::Error::InvalidGeometry, "Parse error") if extra.length > max_extra
 
-        CAPIPointImpl.create(self, x, y, extra[0].to_f)
+        CAPIPointImpl.create(self, x, y, extra[0].to_f, extra[1].to_f)
       end
 
       # See RGeo::Feature::Factory#line_string
@@ -272,6 +443,35 @@ module RGeo
         CAPIPolygonImpl.create(self, outer_ring_, inner_rings_)
       end
 
+      # Creates a line string from flat coordinates, without creating
+      # point objects. The coordinates are given either as an array of
+      # numbers or as a binary string of native doubles, as packed by
+      # <tt>pack("d*")</tt>, with +dims+ (2 or 3) numbers per point. The
+      # third number is Z, or M for factories with M but no Z, and is
+      # ignored by 2D factories. Factories with both Z and M also accept 4
+      # numbers per point, the fourth being M.
+
+      def line_string_from_coords(coords, dims: 2)
+        CAPILineStringImpl._create_from_coords(self, coords, dims) ||
+          raise(RGeo::Error::InvalidGeometry, "Parse error")
+      end
+
+      # Creates a linear ring from flat coordinates, closing it if needed.
+      # See #line_string_from_coords.
+
+      def linear_ring_from_coords(coords, dims: 2)
+        CAPILinearRingImpl._create_from_coords(self, coords, dims) ||
+          raise(RGeo::Error::InvalidGeometry, "Parse error")
+      end
+
+      # Creates a polygon from the flat coordinates of its rings, the
+      # exterior ring first. See #line_string_from_coords.
+
+      def polygon_from_coords(rings, dims: 2)
+        CAPIPolygonImpl._create_from_coords(self, rings, dims) ||
+          raise(RGeo::Error::InvalidGeometry, "Parse error")
+      end
+
       # See RGeo::Feature::Factory#collection
 
       def collection(elems_)
@@ -349,7 +549,9 @@ module RGeo
       end
 
       def auto_prepare # :nodoc:
-        prepare_heuristic? ? :simple : :disabled
+        return :disabled unless prepare_heuristic?
+
+        _prepare_policy.first == 1 ? :always : :simple
       end
 
       # :stopdoc:
@@ -365,6 +567,58 @@ module RGeo
         Feature::MultiPolygon => CAPIMultiPolygonImpl
       }.freeze
 
+      private
+
+      def prepare_policy_options(policy)
+        return {} unless policy
+
+        after, min_coordinates, budget = policy
+        { prepare_after: after, prepare_min_coordinates: min_coordinates, prepare_memory_budget: budget }
+      end
+
+      def marshal_format_options(format)
+        return {} unless format
+
+        marshal_format, twkb_precision = format
+        { marshal_format: marshal_format.to_sym, twkb_precision: twkb_precision }
+      end
+
+      def each_record(io, wkt, chunk_size, on_error)
+        stats = { records: 0, errors: 0, bytes: 0 }
+        started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        if on_error
+          handler = lambda do |error, record|
+            stats[:errors] += 1
+            on_error.call(error, record)
+          end
+        end
+        buffer = String.new(capacity: chunk_size)
+        chunk = String.new(capacity: chunk_size)
+        loop do
+          if io.read(chunk_size, chunk)
+            stats[:bytes] += chunk.bytesize
+            buffer << chunk
+          else
+            # A last record may not end with a newline.
+            break if buffer.empty?
+
+            buffer << "\n"
+            chunk = nil
+          end
+          consumed = _read_records(buffer, wkt, handler) do |geom|
+            stats[:records] += 1
+            yield geom
+          end
+          buffer.slice!(0, consumed)
+          break unless chunk
+        end
+        seconds = Process.clock_gettime(Process::CLOCK_MONOTONIC) - started
+        stats[:seconds] = seconds
+        stats[:records_per_second] = seconds > 0 ? stats[:records] / seconds : 0.0
+        stats[:bytes_per_second] = seconds > 0 ? stats[:bytes] / seconds : 0.0
+        stats
+      end
+
       # :startdoc:
     end
   end
@@ -63,12 +63,89 @@ module RGeo
         _steal(obj)
       end
 
+      # Returns the TWKB (Tiny WKB) of the geometry as a binary string.
+      # Coordinates are rounded to <tt>precision</tt> decimal digits, from
+      # -8 to 7, and Z or M coordinates to <tt>z_precision</tt> digits,
+      # from 0 to 7. Both default to the <tt>:twkb_precision</tt> of the
+      # factory.
+
+      def as_twkb(precision: factory.twkb_precision, z_precision: precision.clamp(0, 7))
+        _as_twkb(precision, z_precision)
+      end
+
+      # Returns the GeoJSON geometry object of this geometry, as a string
+      # written in one pass by the C extension. Coordinates are rounded to
+      # the given number of decimal digits (0 to 17), or written in full
+      # by default. Z coordinates are written for factories that support
+      # them, M coordinates never are.
+
+      def as_geojson(precision: nil)
+        _as_geojson(precision)
+      end
+
       def as_text
         str = _as_text
-        str.force_encoding("US-ASCII") if str.respond_to?(:force_encoding)
+        # Strings kept by factories with :cache_output are frozen, and
+        # already US-ASCII.
+        str.force_encoding("US-ASCII") unless str.frozen?
         str
       end
       alias to_s as_text
+
+      # Tests whether this geometry contains each geometry of the given
+      # array, looping in C with the prepared geometry. Returns the indexes
+      # of the contained geometries, or with <tt>format: :bitmap</tt> a
+      # binary string whose bit i, as given by <tt>unpack1("b*")</tt>, is
+      # set if the geometry at index i is contained. Only this geometry is
+      # checked for validity.
+      def contains_each(geometries, format: :indexes)
+        check_validity!
+        _contains_each(geometries, batch_bitmap?(format))
+      end
+
+      # Same as #contains_each for the intersects? predicate.
+      def intersects_each(geometries, format: :indexes)
+        check_validity!
+        _intersects_each(geometries, batch_bitmap?(format))
+      end
+
+      # Tests whether this geometry contains the point (x, y), without
+      # creating a point object.
+      def contains_xy?(x, y)
+        check_validity!
+        _contains_xy?(x, y)
+      end
+
+      # Tests whether this geometry intersects the point (x, y), without
+      # creating a point object.
+      def intersects_xy?(x, y)
+        check_validity!
+        _intersects_xy?(x, y)
+      end
+
+      # Batch form of #contains_xy?. The coordinates are x, y pairs given
+      # either as a flat array of numbers or as a string of native doubles,
+      # as packed by <tt>pack("d*")</tt>. See #contains_each for the result.
+      def contains_xy_each(coordinates, format: :indexes)
+        check_validity!
+        _contains_xy_each(coordinates, batch_bitmap?(format))
+      end
+
+      # Batch form of #intersects_xy?. See #contains_xy_each.
+      def intersects_xy_each(coordinates, format: :indexes)
+        check_validity!
+        _intersects_xy_each(coordinates, batch_bitmap?(format))
+      end
+
+      private
+
+      def batch_bitmap?(format)
+        case format
+        when :indexes then false
+        when :bitmap then true
+        else raise ArgumentError, "Unknown format: #{format.inspect}"
+        end
+      end
     end
 
     module CAPIGeometryCollectionMethods # :nodoc:
@@ -15,6 +15,13 @@ module RGeo
         CAPI_SUPPORTED
       end
 
+      # Returns true if the CAPI GEOS implementation supports factories
+      # with both Z and M coordinates natively, which requires GEOS 3.12.
+
+      def capi_supports_xyzm?
+        CAPI_SUPPORTED && CAPIFactory._supports_xyzm?
+      end
+
       # Returns true if the FFI GEOS implementation is supported.
 
       def ffi_supported?
@@ -84,15 +91,42 @@ module RGeo
 
       attr_accessor :preferred_native_interface
 
+      # Runs the given block with a deadline, the given number of seconds
+      # from now, and returns its result. The GEOS operations of CAPI
+      # geometries that release the GVL, such as buffer, union or
+      # make_valid, raise RGeo::Error::DeadlineExceeded if they start
+      # after the deadline, and are interrupted by GEOS if they are still
+      # running at the deadline. GEOS frees what the interrupted operation
+      # allocated. The deadline applies to the current fiber, and nested
+      # deadlines never extend an outer one.
+      #
+      # While the GVL is released, such operations are also interrupted by
+      # Thread#raise and Thread#kill, with or without a deadline.
+      #
+      # Before GEOS 3.14, interrupt requests are global to the process: an
+      # operation of another thread may very rarely be interrupted instead.
+      # Operations that release the GVL are then run again, while others,
+      # such as predicates or distances, raise RGeo::Error::GeosError.
+
+      def with_deadline(seconds)
+        previous = Thread.current[:rgeo_geos_deadline]
+        deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + seconds
+        Thread.current[:rgeo_geos_deadline] = previous && previous < deadline ? previous : deadline
+        yield
+      ensure
+        Thread.current[:rgeo_geos_deadline] = previous
+      end
+
       # Returns a factory for the GEOS implementation.
       # Returns nil if the GEOS implementation is not supported.
       #
-      # Note that GEOS does not natively support 4-dimensional data
-      # (i.e. both z and m values). However, RGeo's GEOS wrapper does
-      # provide a 4-dimensional factory that utilizes an extra native
-      # GEOS object to handle the extra coordinate. Hence, a factory
-      # configured with both Z and M support will work, but will be
-      # slower than a 2-dimensional or 3-dimensional factory.
+      # Note that GEOS only supports 4-dimensional data (i.e. both z and
+      # m values) natively since version 3.12. RGeo's GEOS wrapper
+      # provides a 4-dimensional factory, ZMFactory, that utilizes an
+      # extra native GEOS object to handle the extra coordinate. Hence, a
+      # factory configured with both Z and M support will work, but will
+      # be slower than a 2-dimensional or 3-dimensional factory, unless
+      # <tt>:native_zm</tt> is set.
       #
       # Options include:
       #
@@ -123,6 +157,12 @@ module RGeo
       #   Support <tt>z_coordinate</tt>. Default is false.
       # [<tt>:has_m_coordinate</tt>]
       #   Support <tt>m_coordinate</tt>. Default is false.
+      # [<tt>:native_zm</tt>]
+      #   If true, a factory with both Z and M support is a CAPI factory
+      #   whose geometries hold a single GEOS geometry with XYZM
+      #   coordinates, instead of a ZMFactory. Requires GEOS 3.12 or
+      #   later, and falls back to a ZMFactory otherwise. Default is
+      #   false.
       # [<tt>:wkt_parser</tt>]
       #   Configure the parser for WKT. You may either pass a hash of
       #   configuration parameters for WKRep::WKTParser.new, or the
@@ -156,17 +196,47 @@ module RGeo
       #   ZM factories, since GEOS currently can't handle ZM natively.
       # [<tt>:auto_prepare</tt>]
       #   Request an auto-prepare strategy. Supported values are
-      #   <tt>:simple</tt> and <tt>:disabled</tt>. The former (which is
-      #   the default) generates a prepared geometry the second time an
-      #   operation that would benefit from it is called. The latter
+      #   <tt>:simple</tt>, <tt>:always</tt> and <tt>:disabled</tt>.
+      #   <tt>:simple</tt> (the default) generates a prepared geometry the
+      #   second time an operation that would benefit from it is called.
+      #   <tt>:always</tt> generates it the first time. <tt>:disabled</tt>
       #   never automatically generates a prepared geometry (unless you
       #   generate one explicitly using the <tt>prepare!</tt> method).
+      # [<tt>:prepare_after</tt>]
+      #   Number of calls after which a geometry is automatically
+      #   prepared. Overrides the count implied by <tt>:auto_prepare</tt>.
+      #   Supported only by the CAPI implementation.
+      # [<tt>:prepare_min_coordinates</tt>]
+      #   Geometries with fewer coordinates are never automatically
+      #   prepared. Default is 0. Supported only by the CAPI
+      #   implementation.
+      # [<tt>:prepare_memory_budget</tt>]
+      #   Approximate number of bytes that the prepared geometries of the
+      #   factory may use. Once exceeded, the least recently used prepared
+      #   geometries are released. Default is 0, meaning no limit.
+      #   Supported only by the CAPI implementation. See
+      #   CAPIFactory#prepare_stats.
+      # [<tt>:marshal_format</tt>]
+      #   Format of marshaled geometries: <tt>:wkb</tt> (the default), or
+      #   <tt>:twkb</tt> for the much smaller Tiny WKB, which rounds
+      #   coordinates to <tt>:twkb_precision</tt> decimal digits.
+      #   Supported only by the CAPI implementation.
+      # [<tt>:twkb_precision</tt>]
+      #   Number of decimal digits kept for X and Y in TWKB, from -8 to
+      #   7. Z and M keep as many digits, up to 7. Default is 7.
+      #   Supported only by the CAPI implementation.
+      # [<tt>:cache_output</tt>]
+      #   If true, each geometry keeps the frozen strings returned by
+      #   as_text and as_binary, so that later calls return them without
+      #   writing the geometry again. Default is false. Supported only by
+      #   the CAPI implementation. See CAPIFactory#output_cache_stats.
       def factory(opts = {})
         return unless supported?
 
         native_interface = opts[:native_interface] || Geos.preferred_native_interface
 
-        if opts[:has_z_coordinate] && opts[:has_m_coordinate]
+        if opts[:has_z_coordinate] && opts[:has_m_coordinate] &&
+            !(opts[:native_zm] && native_interface != :ffi && capi_supports_xyzm?)
           ZMFactory.new(opts)
         elsif native_interface == :ffi
           FFIFactory.new(opts)
@@ -45,6 +45,8 @@ module RGeo
         srid ||= coord_sys.authority_code if coord_sys
         config = {
           buffer_resolution: opts[:buffer_resolution], auto_prepare: opts[:auto_prepare],
+          prepare_after: opts[:prepare_after], prepare_min_coordinates: opts[:prepare_min_coordinates],
+          prepare_memory_budget: opts[:prepare_memory_budget],
           wkt_generator: opts[:wkt_generator], wkt_parser: opts[:wkt_parser],
           wkb_generator: opts[:wkb_generator], wkb_parser: opts[:wkb_parser],
           srid: srid.to_i, coord_sys:
@@ -23,4 +23,43 @@ class GeosFactoryTest < Minitest::Test # :nodoc:
     assert_equal(true, RGeo::Geos.capi_geos?(@factory))
     assert_equal(false, RGeo::Geos.ffi_geos?(@factory))
   end
+
+  def test_line_string_from_coords
+    line_string = @factory.line_string_from_coords([0, 0, 1, 1, 2, 0])
+    assert_equal(@factory.parse_wkt("LINESTRING (0 0, 1 1, 2 0)"), line_string)
+    assert_equal(1000, line_string.srid)
+
+    packed = @factory.line_string_from_coords([0, 0, 1, 1, 2, 0].pack("d*"))
+    assert_equal(line_string, packed)
+  end
+
+  def test_line_string_from_coords_3d
+    factory = RGeo::Geos.factory(has_z_coordinate: true)
+    line_string = factory.line_string_from_coords([0, 0, 5, 1, 1, 6].pack("d*"), dims: 3)
+    assert_equal([5.0, 6.0], line_string.points.map(&:z))
+
+    flat = @factory.line_string_from_coords([0, 0, 5, 1, 1, 6], dims: 3)
+    assert_equal(@factory.parse_wkt("LINESTRING (0 0, 1 1)"), flat)
+  end
+
+  def test_linear_ring_and_polygon_from_coords
+    ring = @factory.linear_ring_from_coords([0, 0, 10, 0, 10, 10, 0, 10])
+    assert(ring.closed?)
+    assert_equal(5, ring.num_points)
+
+    polygon = @factory.polygon_from_coords(
+      [[0, 0, 10, 0, 10, 10, 0, 10, 0, 0], [2, 2, 4, 2, 4, 4, 2, 4].pack("d*")]
+    )
+    expected = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 4 2, 4 4, 2 4, 2 2))")
+    assert_equal(expected, polygon)
+  end
+
+  def test_from_coords_invalid_arguments
+    assert_raises(ArgumentError) { @factory.line_string_from_coords([0, 0, 1]) }
+    assert_raises(ArgumentError) { @factory.line_string_from_coords([0, 0], dims: 4) }
+    assert_raises(ArgumentError) { @factory.line_string_from_coords("abc") }
+    assert_raises(TypeError) { @factory.line_string_from_coords([0, 0, 1, "a"]) }
+    assert_raises(TypeError) { @factory.polygon_from_coords([[0, 0, 1, 0, 1, 1], [0, "a"]]) }
+    assert_raises(ArgumentError) { @factory.polygon_from_coords([]) }
+  end
 end
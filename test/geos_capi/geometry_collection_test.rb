@@ -47,4 +47,22 @@ class GeosGeometryCollectionTest < Minitest::Test # :nodoc:
 
     assert_equal expected, input.polygonize
   end
+
+  def test_elements_outlive_collection
+    elements = Array.new(3) do
+      collection = @factory.parse_wkt(
+        "GEOMETRYCOLLECTION (POINT (1 2), MULTIPOLYGON (((0 0, 1 0, 1 1, 0 0))), POINT EMPTY)"
+      )
+      [collection[0], collection.geometry_n(1).geometry_n(0).exterior_ring, collection.to_a]
+    end
+    GC.start
+    GC.compact if GC.respond_to?(:compact)
+
+    elements.each do |point, ring, all|
+      assert_equal(@factory.point(1, 2), point)
+      assert_equal(4, ring.num_points)
+      assert_equal(3, all.size)
+      assert_equal(RGeo::Feature::GeometryCollection, all.last.geometry_type)
+    end
+  end
 end
@@ -6,6 +6,7 @@
 #
 # -----------------------------------------------------------------------------
 
+require "objspace"
 require "ostruct"
 require_relative "../test_helper"
 require_relative "../common/validity_tests"
@@ -89,6 +90,101 @@ class GeosMiscTest < Minitest::Test # :nodoc:
     assert_equal(false, polygon2.prepared?)
   end
 
+  def test_prepare_policy
+    factory = RGeo::Geos.factory(prepare_after: 3)
+    point = factory.point(1, 1)
+    polygon = factory.parse_wkt("POLYGON ((0 0, 0 4, 4 4, 4 0, 0 0))")
+    2.times { polygon.intersects?(point) }
+    assert_equal(false, polygon.prepared?)
+    polygon.intersects?(point)
+    assert_equal(true, polygon.prepared?)
+    polygon.intersects?(point)
+    assert_equal({ hits: 1, misses: 3, evictions: 0, prepared: 1 }, factory.prepare_stats.except(:bytes))
+
+    factory = RGeo::Geos.factory(auto_prepare: :always)
+    assert_equal(:always, factory.property(:auto_prepare))
+    polygon = factory.parse_wkt("POLYGON ((0 0, 0 4, 4 4, 4 0, 0 0))")
+    polygon.intersects?(point)
+    assert_equal(true, polygon.prepared?)
+
+    factory = RGeo::Geos.factory(auto_prepare: :always, prepare_min_coordinates: 6)
+    polygon = factory.parse_wkt("POLYGON ((0 0, 0 4, 4 4, 4 0, 0 0))")
+    polygon.intersects?(point)
+    assert_equal(false, polygon.prepared?)
+  end
+
+  def test_prepare_memory_budget
+    factory = RGeo::Geos.factory(auto_prepare: :always, prepare_memory_budget: 1)
+    point = factory.point(1, 1)
+    polygon1 = factory.parse_wkt("POLYGON ((0 0, 0 4, 4 4, 4 0, 0 0))")
+    polygon2 = factory.parse_wkt("POLYGON ((0 0, 0 2, 2 2, 2 0, 0 0))")
+    polygon1.intersects?(point)
+    assert_equal(true, polygon1.prepared?)
+    polygon2.intersects?(point)
+    assert_equal(false, polygon1.prepared?)
+    assert_equal(true, polygon2.prepared?)
+
+    stats = factory.prepare_stats
+    assert_equal(1, stats[:evictions])
+    assert_equal(1, stats[:prepared])
+    assert_operator(stats[:bytes], :>, 0)
+  end
+
+  def test_bounds
+    polygon = @factory.parse_wkt("POLYGON ((0 1, 4 1, 4 5, 0 5, 0 1))")
+    assert_equal([0.0, 1.0, 4.0, 5.0], polygon.bounds)
+    assert_equal([2.0, 3.0, 2.0, 3.0], @factory.point(2, 3).bounds)
+    assert_nil(@factory.parse_wkt("LINESTRING EMPTY").bounds)
+
+    polygon.send(:initialize_copy, @factory.point(7, 8))
+    assert_equal([7.0, 8.0, 7.0, 8.0], polygon.bounds)
+  end
+
+  def test_bbox_fast_reject
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 4 0, 4 4, 0 4, 0 0))")
+    far = @factory.parse_wkt("LINESTRING (10 10, 11 11)")
+    crossing = @factory.parse_wkt("LINESTRING (2 2, 6 2)")
+    empty = @factory.parse_wkt("POINT EMPTY")
+
+    refute(polygon.intersects?(far))
+    assert(polygon.disjoint?(far))
+    refute(polygon.contains?(crossing))
+    refute(crossing.within?(polygon))
+    assert(polygon.intersects?(crossing))
+    assert(polygon.contains?(@factory.point(1, 1)))
+    assert(@factory.point(1, 1).within?(polygon))
+    refute(polygon.intersects?(empty))
+    assert(polygon.disjoint?(empty))
+    refute(polygon.contains?(empty))
+    refute(polygon.intersects?(RGeo::Cartesian.simple_factory.point(5, 5)))
+  end
+
+  def test_cached_hash
+    wkt = "MULTIPOLYGON (((0 0, 4 0, 4 4, 0 4, 0 0), (1 1, 2 1, 2 2, 1 1)), ((5 5, 6 5, 6 6, 5 5)))"
+    geom = @factory.parse_wkt(wkt)
+    hash = geom.hash
+    assert_equal(hash, geom.hash)
+    assert_equal(hash, @factory.parse_wkt(wkt).hash)
+    assert_equal(hash, geom.dup.hash)
+
+    line = @factory.parse_wkt("LINESTRING (0 0, 1 1)")
+    line_hash = line.hash
+    line.send(:initialize_copy, @factory.parse_wkt("LINESTRING (0 0, 2 2)"))
+    refute_equal(line_hash, line.hash)
+    assert_equal(@factory.parse_wkt("LINESTRING (0 0, 2 2)").hash, line.hash)
+  end
+
+  def test_memsize_includes_geos_geometry
+    coords = Array.new(10_000) { |i| [i, i % 2] }.flatten
+    line = @factory.line_string_from_coords(coords)
+    size = ObjectSpace.memsize_of(line)
+    assert_operator(size, :>=, 10_000 * 16)
+
+    line.prepare!
+    assert_operator(ObjectSpace.memsize_of(line), :>, size)
+    assert_operator(ObjectSpace.memsize_of(line.point_n(0)), :<, 1000)
+  end
+
   def test_gh21
     # Test for GH-21 (seg fault in rgeo_convert_to_geos_geometry)
     # This seemed to fail under Ruby 1.8.7 only.
@@ -191,6 +287,156 @@ class GeosMiscTest < Minitest::Test # :nodoc:
       fac.polygon(shell, [shell, hole])
     end
   end
+
+  def test_operations_in_threads
+    geoms = Array.new(8) { |i| @factory.point(i, i).buffer(1.5) }
+    expected = geoms.each_cons(2).map { |a, b| a.union(b).buffer(0.5).as_text }
+    threads = geoms.each_cons(2).map do |a, b|
+      Thread.new { a.union(b).buffer(0.5).as_text }
+    end
+    assert_equal(expected, threads.map(&:value))
+  end
+
+  def test_errors_in_threads
+    threads = Array.new(4) do
+      Thread.new do
+        Thread.current.report_on_exception = false
+        @factory.parse_wkt("POINT (1 1")
+      end
+    end
+    threads.each do |thread|
+      assert_raises(RGeo::Error::ParseError) { thread.join }
+    end
+  end
+
+  def test_contexts_per_thread
+    expected = @factory.point(0, 0).buffer(1).union(@factory.point(1, 0).buffer(1)).as_text
+    # Each thread gets its own GEOS context, destroyed when it exits.
+    results = Array.new(3) do
+      Array.new(8) do |i|
+        Thread.new do
+          Array.new(20) do |j|
+            if (i + j).even?
+              @factory.point(0, 0).buffer(1).union(@factory.point(1, 0).buffer(1)).as_text
+            else
+              begin
+                @factory.parse_wkt("LINESTRING (0 0, 1")
+              rescue RGeo::Error::RGeoError => e
+                e.class
+              end
+            end
+          end
+        end
+      end.flat_map(&:value)
+    end.flatten
+
+    assert_equal([expected, RGeo::Error::ParseError].sort_by(&:to_s), results.uniq.sort_by(&:to_s))
+    assert_equal(expected, @factory.point(0, 0).buffer(1).union(@factory.point(1, 0).buffer(1)).as_text)
+  end
+
+  def test_coordinates_packed
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 4 0, 4 4, 0 0), (1 1, 2 1, 2 2, 1 1))")
+    data, sequence_offsets, part_offsets = polygon.coordinates_packed
+
+    assert_equal(Encoding::BINARY, data.encoding)
+    assert_equal(polygon.coordinates.flatten.map(&:to_f), data.unpack("d*"))
+    assert_equal([0, 4, 8], sequence_offsets)
+    assert_equal([0, 2], part_offsets)
+  end
+
+  def test_coordinates_packed_collection
+    collection = @factory.parse_wkt(
+      "GEOMETRYCOLLECTION (POINT (1 2), MULTILINESTRING ((0 0, 1 1), (2 2, 3 3, 4 4)), POINT EMPTY)"
+    )
+    data, sequence_offsets, part_offsets = collection.coordinates_packed
+
+    assert_equal([1, 2, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4], data.unpack("d*"))
+    assert_equal([0, 1, 3, 6, 6], sequence_offsets)
+    assert_equal([0, 1, 2, 3, 4], part_offsets)
+  end
+
+  def test_coordinates_packed_3d
+    factory = RGeo::Geos.factory(has_z_coordinate: true)
+    data, = factory.parse_wkt("LINESTRING Z (0 1 2, 3 4 5)").coordinates_packed
+
+    assert_equal([0, 1, 2, 3, 4, 5], data.unpack("d*"))
+  end
+
+  def test_2d_geometries_match_read_ones
+    line = @factory.line_string([@factory.point(1, 2), @factory.point(3, 4)])
+    read = @factory.parse_wkb(line.as_binary, lazy: true)
+
+    assert_equal(line.hash, read.hash)
+    assert_equal(line.hash, @factory.line_string_from_coords([1, 2, 3, 4]).hash)
+    assert_equal(@factory.point(1, 2).hash, read.start_point.hash)
+  end
+
+  def test_copies_share_prepared_geometry
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 4 0, 4 4, 0 4, 0 0))")
+    copy = polygon.dup
+    polygon.prepare!
+
+    assert(copy.prepared?)
+    assert(copy.contains?(@factory.point(1, 1)))
+    assert_equal(polygon, copy)
+  end
+
+  def test_replace_geometry_with_copies_and_views
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 4 0, 4 4, 0 4, 0 0))")
+    copy = polygon.dup
+    ring = polygon.exterior_ring
+    point = @factory.point(1, 2)
+    polygon.send(:initialize_copy, point)
+    GC.start
+
+    assert_equal(point, polygon)
+    assert_equal(@factory.parse_wkt("POLYGON ((0 0, 4 0, 4 4, 0 4, 0 0))"), copy)
+    assert_equal(5, ring.num_points)
+  end
+
+  def test_cast_to_factory_with_other_srid
+    opts = { type_format: :ewkb, emit_ewkb_srid: true, hex_format: true }
+    factory = RGeo::Geos::CAPIFactory.new(srid: 3857, wkb_generator: opts)
+    point = @factory.point(1, 2)
+    cast = RGeo::Feature.cast(point, factory)
+
+    assert_equal(3857, cast.srid)
+    assert_equal(4326, point.srid)
+    assert_equal(factory.point(1, 2).as_binary, cast.as_binary)
+  end
+
+  def test_with_deadline
+    point = @factory.point(1, 2)
+
+    assert_kind_of(RGeo::Geos::CAPIPolygonImpl, RGeo::Geos.with_deadline(10) { point.buffer(1) })
+    assert_raises(RGeo::Error::DeadlineExceeded) do
+      RGeo::Geos.with_deadline(0) { point.buffer(1) }
+    end
+    assert_raises(RGeo::Error::DeadlineExceeded) do
+      RGeo::Geos.with_deadline(-1) { RGeo::Geos.with_deadline(10) { point.buffer(1) } }
+    end
+    assert_nil(Thread.current[:rgeo_geos_deadline])
+    assert_kind_of(RGeo::Geos::CAPIPolygonImpl, point.buffer(1))
+  end
+
+  def test_with_deadline_in_other_thread
+    point = @factory.point(1, 2)
+    entered = Queue.new
+    resume = Queue.new
+    other = Thread.new do
+      Thread.current.report_on_exception = false
+      RGeo::Geos.with_deadline(0) do
+        entered << true
+        resume.pop
+        point.buffer(1)
+      end
+    end
+
+    entered.pop
+    assert_kind_of(RGeo::Geos::CAPIPolygonImpl, point.buffer(1))
+    resume << true
+    assert_raises(RGeo::Error::DeadlineExceeded) { other.join }
+  end
 end
 
 puts "WARNING: GEOS CAPI support not available. Related tests skipped." unless RGeo::Geos.capi_supported?
@@ -346,4 +346,94 @@ class GeosPolygonTest < Minitest::Test # :nodoc:
     assert_raises(TypeError, "no implicit conversion to float from nil") { input.segmentize(nil) }
     assert_raises(RGeo::Error::InvalidGeometry, "Tolerance must be positive") { input.segmentize(0) }
   end
+
+  def test_contains_each
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0))")
+    points = [[5, 5], [20, 5], [10, 5], [1, 9], [-1, -1]].map { |x, y| @factory.point(x, y) }
+
+    assert_equal([0, 3], polygon.contains_each(points))
+    assert_equal([0, 2, 3], polygon.intersects_each(points))
+    assert_equal("10010", polygon.contains_each(points, format: :bitmap).unpack1("b5"))
+    assert_equal([], polygon.contains_each([]))
+    assert_equal([0], polygon.contains_each([points.first]))
+    assert_raises(ArgumentError) { polygon.contains_each(points, format: :unknown) }
+    assert_raises(TypeError) { polygon.contains_each(points.first) }
+  end
+
+  def test_contains_each_bounds
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 2, 2 2, 2 10, 0 10, 0 0))")
+    candidates = [
+      @factory.parse_wkt("LINESTRING (1 1, 1 5)"),
+      @factory.parse_wkt("LINESTRING (5 5, 15 5)"),
+      @factory.parse_wkt("LINESTRING (-5 1, 15 1)"),
+      @factory.point(5, 5),
+      @factory.parse_wkt("POINT (1 1)").envelope,
+      @factory.collection([])
+    ]
+
+    assert_equal([0, 4], polygon.contains_each(candidates))
+    assert_equal([0, 2, 4], polygon.intersects_each(candidates))
+  end
+
+  def test_contains_xy
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0))")
+
+    assert(polygon.contains_xy?(5, 5))
+    refute(polygon.contains_xy?(10, 5))
+    assert(polygon.intersects_xy?(10, 5))
+    refute(polygon.intersects_xy?(11, 5))
+    3.times { assert(polygon.contains_xy?(1.5, 2)) }
+  end
+
+  def test_contains_xy_each
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0))")
+    coordinates = [5, 5, 20, 5, 10, 5, 1, 9]
+
+    assert_equal([0, 3], polygon.contains_xy_each(coordinates))
+    assert_equal([0, 2, 3], polygon.intersects_xy_each(coordinates.pack("d*")))
+    assert_equal("1001", polygon.contains_xy_each(coordinates.pack("d*"), format: :bitmap).unpack1("b4"))
+    assert_raises(ArgumentError) { polygon.contains_xy_each([1, 2, 3]) }
+    assert_raises(ArgumentError) { polygon.contains_xy_each([1.0].pack("d")) }
+  end
+
+  def test_prepared_rings_collected_with_polygon
+    points = [@factory.point(0, 0), @factory.point(5, 5)]
+    100.times do
+      polygon = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0))")
+      assert_equal([0], polygon.exterior_ring.intersects_each(points))
+    end
+    GC.start
+    GC.compact if GC.respond_to?(:compact)
+
+    ring = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0))").exterior_ring
+    assert_equal([0], ring.intersects_each(points))
+    GC.start
+    assert_equal([0], ring.intersects_each(points))
+  end
+
+  def test_rings_outlive_polygon
+    rings = Array.new(3) do
+      polygon = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0), (1 1, 2 1, 2 2, 1 1))")
+      [polygon.exterior_ring, polygon.interior_ring_n(0), polygon.interior_rings.first]
+    end
+    GC.start
+    GC.compact if GC.respond_to?(:compact)
+
+    rings.each do |exterior, interior, other_interior|
+      assert_equal(5, exterior.num_points)
+      assert_equal(interior, other_interior)
+      assert_equal(@factory.point(2, 1), interior.point_n(1))
+    end
+  end
+
+  def test_ring_views_can_be_reused
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0), (1 1, 2 1, 2 2, 1 1))")
+    exterior = polygon.exterior_ring
+
+    copy = @factory.polygon(exterior, [polygon.interior_ring_n(0)])
+    assert_equal(polygon, copy)
+    assert_equal(exterior, exterior.dup)
+    assert_equal(exterior, Marshal.load(Marshal.dump(exterior)))
+    assert_equal(polygon, Marshal.load(Marshal.dump(polygon)))
+  end
 end
@@ -0,0 +1,141 @@
+# frozen_string_literal: true
+
+# -----------------------------------------------------------------------------
+#
+# Tests for the GEOS STRtree spatial index
+#
+# -----------------------------------------------------------------------------
+
+require_relative "../test_helper"
+require_relative "skip_capi"
+
+class GeosSTRtreeTest < Minitest::Test # :nodoc:
+  prepend SkipCAPI
+
+  def setup
+    @factory = RGeo::Geos.factory
+    @points = Array.new(100) { |i| @factory.point(i % 10, i / 10) }
+  end
+
+  def test_query_geometries
+    tree = RGeo::Geos::STRtree.new
+    @points.each { |point| tree.insert(point) }
+    assert_equal(100, tree.size)
+
+    result = tree.query(@factory.parse_wkt("LINESTRING (1.5 1.5, 3.5 2.5)"))
+    assert_equal(
+      [[2, 2], [3, 2]],
+      result.map { |point| [point.x, point.y] }.sort
+    )
+  end
+
+  def test_query_with_payloads
+    tree = RGeo::Geos::STRtree.new(4)
+    tree.load(@points, Array.new(100) { |i| "point #{i}" })
+
+    assert_equal(["point 0", "point 1", "point 10", "point 11"], tree.query([0, 0, 1, 1]).sort)
+  end
+
+  def test_query_bboxes
+    tree = RGeo::Geos::STRtree.new
+    tree.insert_bbox(0, 0, 10, 10, :big)
+    tree.insert_bbox(20, 20, 21, 21, :far)
+    tree.load_bboxes([5, 5, 6, 6, 30, 30, 31, 31], %i[small other])
+
+    assert_equal(%i[big small], tree.query([5.5, 5.5, 7, 7]).sort)
+    assert_equal([:far], tree.query(@factory.point(20.5, 20.5)))
+    assert_equal([], tree.query([100, 100, 101, 101]))
+  end
+
+  def test_load_packed_bboxes
+    tree = RGeo::Geos::STRtree.new
+    tree.load_bboxes([0, 0, 1, 1, 2, 2, 3, 3].pack("d*"), %w[a b])
+
+    assert_equal(["b"], tree.query([2.5, 2.5, 2.5, 2.5]))
+  end
+
+  def test_query_each
+    tree = RGeo::Geos::STRtree.new
+    tree.load(@points)
+    yielded = []
+    assert_same(tree, tree.query_each([0, 0, 2, 0]) { |point| yielded << point.x })
+    assert_equal([0, 1, 2], yielded.sort)
+    assert_equal(3, tree.query_each([0, 0, 2, 0]).count)
+  end
+
+  def test_insert_after_build
+    tree = RGeo::Geos::STRtree.new
+    tree.insert(@points.first)
+    refute(tree.built?)
+    tree.build
+    assert(tree.built?)
+    assert_raises(RGeo::Error::UnsupportedOperation) { tree.insert(@points.last) }
+  end
+
+  def test_nearest
+    tree = RGeo::Geos::STRtree.new
+    tree.load(@points, Array.new(100) { |i| i })
+
+    result = tree.nearest(@factory.point(0.2, 0.1), 3)
+    assert_equal([0, 1, 10], result.map { |_, payload, _| payload })
+    assert_equal(@points[0], result[0][0])
+    assert_in_delta(Math.sqrt(0.05), result[0][2], 1e-12)
+    assert_equal(result.map(&:last).sort, result.map(&:last))
+    assert_equal(100, tree.nearest(@factory.point(0, 0), 1000).size)
+  end
+
+  def test_nearest_equal_distances
+    tree = RGeo::Geos::STRtree.new(2)
+    tree.load(@points, Array.new(100) { |i| i })
+
+    result = tree.nearest(@factory.point(5, 5), 7)
+    payloads = result.map { |_, payload, _| payload }
+    assert_equal(7, payloads.uniq.size)
+    assert_equal(55, payloads[0])
+    assert_equal([45, 54, 56, 65], payloads[1, 4].sort)
+    assert_equal([1.0] * 4, result[1, 4].map(&:last))
+    result[5, 2].each { |_, _, distance| assert_in_delta(Math.sqrt(2), distance, 1e-12) }
+    assert_empty(payloads[5, 2] - [44, 46, 64, 66])
+  end
+
+  def test_nearest_bboxes
+    tree = RGeo::Geos::STRtree.new
+    tree.load_bboxes([0, 0, 1, 1, 5, 0, 6, 1], %i[left right])
+
+    assert_equal([[nil, :right, 1.0]], tree.nearest(@factory.point(7, 0.5)))
+    line = @factory.parse_wkt("LINESTRING (3 3, 3 4)")
+    result = tree.nearest(line, 2)
+    assert_equal(%i[left right], result.map { |_, payload, _| payload })
+    assert_in_delta(Math.sqrt(8), result[0][2], 1e-12)
+  end
+
+  def test_nearest_within
+    tree = RGeo::Geos::STRtree.new
+    tree.load(@points, Array.new(100) { |i| i })
+
+    result = tree.nearest_within(@factory.point(5, 5), 1)
+    assert_equal(55, result.first[1])
+    assert_equal([0.0, 1.0, 1.0, 1.0, 1.0], result.map(&:last))
+    assert_equal([45, 54, 56, 65], result.drop(1).map { |_, payload, _| payload }.sort)
+    assert_equal(2, tree.nearest_within(@factory.point(5, 5), 1, 2).size)
+    assert_equal([], tree.nearest_within(@factory.point(50, 50), 1))
+  end
+
+  def test_nearest_empty
+    tree = RGeo::Geos::STRtree.new
+    assert_equal([], tree.nearest(@factory.point(0, 0)))
+    tree.insert(@points.first)
+    assert_equal([], tree.nearest(@factory.parse_wkt("POINT EMPTY")))
+    assert_equal([], tree.nearest(@factory.point(0, 0), 0))
+    assert_raises(ArgumentError) { tree.nearest(@factory.point(0, 0), -1) }
+    assert_raises(ArgumentError) { tree.nearest_within(@factory.point(0, 0), -1) }
+  end
+
+  def test_invalid_arguments
+    tree = RGeo::Geos::STRtree.new
+    assert_raises(ArgumentError) { RGeo::Geos::STRtree.new(1) }
+    assert_raises(ArgumentError) { tree.insert_bbox(1, 0, 0, 1, nil) }
+    assert_raises(ArgumentError) { tree.load(@points, []) }
+    assert_raises(RGeo::Error::RGeoError) { tree.insert(RGeo::Cartesian.simple_factory.point(1, 1)) }
+  end
+end
@@ -1,6 +1,8 @@
 # frozen_string_literal: true
 
 require_relative "../test_helper"
+require "json"
+require "stringio"
 
 class GeosWKREPTest < Minitest::Test
   def setup
@@ -26,6 +28,271 @@ class GeosWKREPTest < Minitest::Test
     assert_equal(RGeo::Feature::Point, obj.geometry_type)
   end
 
+  def test_parse_wkb_with_parser_options
+    [
+      [{ support_ewkb: true }, false, "0101000020e6100000000000000000f03f0000000000000040"],
+      [{ support_ewkb: true }, true, "01010000a0e6100000000000000000f03f00000000000000400000000000000840"],
+      [{ support_wkb12: true }, true, "01e9030000000000000000f03f00000000000000400000000000000840"],
+      [{ support_ewkb: true, ignore_extra_bytes: true }, false, "0101000000000000000000f03f0000000000000040ff"]
+    ].each do |opts, has_z, hex|
+      factory = RGeo::Geos::CAPIFactory.new(srid: 4326, has_z_coordinate: has_z, wkb_parser: opts)
+      expected = RGeo::WKRep::WKBParser.new(factory, opts).parse(hex)
+      assert_equal(expected, factory.parse_wkb(hex), opts.inspect)
+      assert_equal(expected, factory.parse_wkb([hex].pack("H*")), opts.inspect)
+      assert_equal(4326, factory.parse_wkb(hex).srid)
+    end
+  end
+
+  def test_parse_wkb_with_parser_options_raises
+    factory = RGeo::Geos::CAPIFactory.new(wkb_parser: { support_ewkb: true })
+    error = assert_raises(RGeo::Error::ParseError) do
+      factory.parse_wkb("0101000000000000000000f03f0000000000000040ff")
+    end
+    assert_equal("Found 1 extra bytes at the end of the stream.", error.message)
+    assert_raises(RGeo::Error::ParseError) do
+      factory.parse_wkb("01010000a0e6100000000000000000f03f00000000000000400000000000000840")
+    end
+  end
+
+  def test_parse_wkt_with_parser_options
+    factory = RGeo::Geos::CAPIFactory.new(srid: 4326, wkt_parser: { support_ewkt: true })
+    obj = factory.parse_wkt("SRID=1000;MULTIPOINT((1 2), (3 4))")
+    assert_equal(factory.multi_point([factory.point(1, 2), factory.point(3, 4)]), obj)
+    assert_equal(4326, obj.srid)
+    assert_equal(factory.multi_point([]), factory.parse_wkt("POINT EMPTY"))
+    assert_raises(RGeo::Error::ParseError) do
+      factory.parse_wkt("POINT(1 2 3)")
+    end
+
+    factory = RGeo::Geos::CAPIFactory.new(has_z_coordinate: true, wkt_parser: { support_wkt12: true })
+    assert_equal(factory.point(1, 2, 3), factory.parse_wkt("POINT Z (1 2 3)"))
+    assert_equal(0, factory.parse_wkt("POINT (1 2)").z)
+  end
+
+  def test_parse_wkb_lazy
+    line = @factory.parse_wkt("LINESTRING (1 2, 3 -4)")
+    wkb = line.as_binary
+    lazy = @factory.parse_wkb(wkb, lazy: true)
+    assert_equal(RGeo::Feature::LineString, lazy.geometry_type)
+    assert_equal([1.0, -4.0, 3.0, 2.0], lazy.bounds)
+    assert_equal(wkb, lazy.as_binary)
+    assert_equal(Encoding::BINARY, lazy.as_binary.encoding)
+    assert_equal(line, lazy)
+    assert_equal(line, lazy.dup)
+    assert_equal(3, lazy.end_point.x)
+    assert_equal(wkb, lazy.as_binary)
+
+    factory = RGeo::Geos::CAPIFactory.new(srid: 4326, wkb_parser: { support_ewkb: true },
+                                          wkb_generator: { type_format: :ewkb, emit_ewkb_srid: true, hex_format: true })
+    hex = factory.point(1, 2).as_binary
+    lazy = factory.parse_wkb(hex, lazy: true)
+    assert_equal(4326, lazy.srid)
+    assert_equal(hex, lazy.as_binary)
+    assert_equal(factory.point(1, 2), lazy)
+    assert_equal(factory.point(1, 2), factory.parse_wkb(hex.upcase, lazy: true))
+  end
+
+  def test_parse_wkb_lazy_falls_back
+    assert_equal(@factory.collection([]), @factory.parse_wkb("0101000000000000000000f87f000000000000f87f", lazy: true))
+    assert_raises(RGeo::Error::ParseError) do
+      @factory.parse_wkb("00000003e93ff00000000000004000000000000000", lazy: true)
+    end
+  end
+
+  def test_each_wkb
+    points = [@factory.point(1, 2), @factory.point(3, 4), @factory.point(5, 6)]
+    io = StringIO.new("#{points[0].as_binary.unpack1('H*')}\n\n#{points[1].as_binary.unpack1('H*')}\r\n" \
+                      "#{points[2].as_binary.unpack1('H*')}")
+    result = []
+    stats = @factory.each_wkb(io, chunk_size: 7) { |geom| result << geom }
+    assert_equal(points, result)
+    assert_equal(3, stats[:records])
+    assert_equal(0, stats[:errors])
+    assert_equal(io.string.bytesize, stats[:bytes])
+    assert(stats[:records_per_second] >= 0)
+  end
+
+  def test_each_wkt
+    io = StringIO.new("POINT (1 2)\nPOINT (1\nLINESTRING (0 0, 1 1)\n")
+    errors = []
+    enum = @factory.each_wkt(io, on_error: ->(error, record) { errors << [error.class, record] })
+    assert_equal([@factory.point(1, 2), @factory.line_string([@factory.point(0, 0), @factory.point(1, 1)])], enum.to_a)
+    assert_equal([[RGeo::Error::ParseError, "POINT (1"]], errors)
+
+    assert_raises(RGeo::Error::ParseError) do
+      @factory.each_wkt(StringIO.new("POINT (1\n")) { nil }
+    end
+    errors.clear
+    assert_raises(RGeo::Error::DeadlineExceeded) do
+      RGeo::Geos.with_deadline(0) do
+        @factory.each_wkt(StringIO.new("POINT (1 2)\nPOINT (3 4)\n"), on_error: ->(error, _) { errors << error }) { nil }
+      end
+    end
+    assert_empty(errors)
+  end
+
+  def test_write_wkb
+    points = [@factory.point(1, 2), @factory.point(3, 4)]
+    wkbs = points.map(&:as_binary)
+
+    io = StringIO.new(+"")
+    assert_equal(2, @factory.write_wkb(io, points))
+    assert_equal(wkbs.join, io.string)
+
+    io = StringIO.new(+"")
+    @factory.write_wkb(io, points.each, format: :hex, flush_size: 1)
+    assert_equal(points, @factory.each_wkb(StringIO.new(io.string)).to_a)
+
+    io = StringIO.new(+"")
+    @factory.write_wkb(io, points, format: :length_prefixed)
+    assert_equal(wkbs.map { |wkb| [wkb.bytesize].pack("N") + wkb }.join, io.string)
+
+    # An IO keeping the strings it is given shares the buffer.
+    records = []
+    io = Object.new
+    io.define_singleton_method(:write) { |str| records << str.dup }
+    @factory.write_wkb(io, points, flush_size: 1)
+    assert_equal(wkbs, records)
+
+    assert_raises(ArgumentError) do
+      @factory.write_wkb(StringIO.new(+""), points, format: :base64)
+    end
+  end
+
+  def test_write_wkb_with_generator
+    factory = RGeo::Geos::CAPIFactory.new(has_m_coordinate: true, wkb_generator: { type_format: :ewkb, hex_format: true })
+    point = factory.point(1, 2, 3)
+    io = StringIO.new(+"")
+    factory.write_wkb(io, [point])
+    assert_equal([point.as_binary].pack("H*"), io.string)
+  end
+
+  def test_as_twkb
+    assert_equal("\x01\x00\x02\x04".b, @factory.point(1, 2).as_twkb(precision: 0))
+    line = @factory.line_string([@factory.point(1, 2), @factory.point(3, 4)])
+    assert_equal("\x02\x00\x02\x02\x04\x04\x04".b, line.as_twkb(precision: 0))
+    # CAPI factories have no empty points, "POINT EMPTY" is an empty collection.
+    assert_equal("\x07\x10".b, @factory.collection([]).as_twkb(precision: 0))
+    assert_equal("\x04\x10".b, @factory.multi_point([]).as_twkb(precision: 0))
+    assert_raises(ArgumentError) { line.as_twkb(precision: 8) }
+  end
+
+  def test_twkb_round_trip
+    [
+      "POINT (1.25 -2.5)",
+      "LINESTRING (0 0, 10.125 10, -3 4)",
+      "POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 2 3, 3 3, 2 2))",
+      "MULTIPOINT ((1 2), (3 4))",
+      "MULTILINESTRING ((0 0, 1 1), (2 2, 3 3))",
+      "MULTIPOLYGON (((0 0, 1 0, 1 1, 0 0)), ((5 5, 6 5, 6 6, 5 5)))",
+      "GEOMETRYCOLLECTION (POINT (1 2), LINESTRING (0 0, 1 1))",
+      "LINESTRING EMPTY",
+      "MULTIPOLYGON EMPTY"
+    ].each do |wkt|
+      geom = @factory.parse_wkt(wkt)
+      assert_equal(geom, @factory.parse_twkb(geom.as_twkb), wkt)
+    end
+
+    factory = RGeo::Geos::CAPIFactory.new(has_z_coordinate: true)
+    point = factory.point(1.123456789, 2, 3.5)
+    result = factory.parse_twkb(point.as_twkb(precision: 3, z_precision: 1))
+    assert_equal([1.123, 2, 3.5], [result.x, result.y, result.z])
+    assert_equal(0, factory.parse_twkb(@factory.point(1, 2).as_twkb).z)
+  end
+
+  def test_parse_twkb_raises_on_wrong_data
+    factory = RGeo::Geos::CAPIFactory.new(has_z_coordinate: true)
+    twkb = factory.point(1, 2, 3).as_twkb
+    assert_raises(RGeo::Error::ParseError) { @factory.parse_twkb(twkb) }
+    assert_raises(RGeo::Error::ParseError) { factory.parse_twkb(twkb[0..-2]) }
+    assert_raises(RGeo::Error::ParseError) { factory.parse_twkb("#{twkb}\x00") }
+    assert_raises(RGeo::Error::ParseError) { @factory.parse_twkb("\x04\x00\xff\xff\xff\xff\x0f".b) }
+    assert_raises(RGeo::Error::ParseError) { @factory.parse_twkb(("\x07\x00\x01" * 100_000).b) }
+  end
+
+  def test_marshal_twkb
+    factory = RGeo::Geos::CAPIFactory.new(srid: 4326, marshal_format: :twkb, twkb_precision: 5)
+    assert_equal(:twkb, factory.marshal_format)
+    assert_equal(5, factory.twkb_precision)
+    line = factory.line_string([factory.point(-71.0634, 42.35808), factory.point(-71.06214, 42.36016)])
+    result = Marshal.load(Marshal.dump(line))
+    assert_equal(line, result)
+    assert_equal(:twkb, result.factory.marshal_format)
+    assert(factory.write_for_marshal(line).bytesize * 2 < @factory.write_for_marshal(line).bytesize)
+    assert_raises(ArgumentError) do
+      RGeo::Geos::CAPIFactory.new(marshal_format: :geojson)
+    end
+  end
+
+  def test_as_geojson
+    assert_equal('{"type":"Point","coordinates":[1.0,2.5]}', @factory.point(1, 2.5).as_geojson)
+    assert_equal('{"type":"GeometryCollection","geometries":[]}', @factory.collection([]).as_geojson)
+    assert_equal('{"type":"MultiPoint","coordinates":[]}', @factory.multi_point([]).as_geojson)
+    polygon = @factory.parse_wkt("POLYGON ((0 0, 1 0, 1 1, 0 0))")
+    assert_equal('{"type":"Polygon","coordinates":[[[0.0,0.0],[1.0,0.0],[1.0,1.0],[0.0,0.0]]]}', polygon.as_geojson)
+    collection = @factory.parse_wkt("GEOMETRYCOLLECTION (MULTIPOINT ((1 2)), LINESTRING (0 0, 1 1))")
+    assert_equal(
+      '{"type":"GeometryCollection","geometries":[{"type":"MultiPoint","coordinates":[[1.0,2.0]]},' \
+      '{"type":"LineString","coordinates":[[0.0,0.0],[1.0,1.0]]}]}',
+      collection.as_geojson
+    )
+    assert_equal(0.1, JSON.parse(@factory.point(0.1, 0).as_geojson)["coordinates"][0])
+  end
+
+  def test_as_geojson_with_precision
+    point = @factory.point(-71.0634123, 42.35)
+    assert_equal('{"type":"Point","coordinates":[-71.063,42.35]}', point.as_geojson(precision: 3))
+    assert_equal('{"type":"Point","coordinates":[-71.0,42.0]}', point.as_geojson(precision: 0))
+    factory = RGeo::Geos::CAPIFactory.new(has_z_coordinate: true)
+    assert_equal('{"type":"Point","coordinates":[1.0,2.0,3.5]}', factory.point(1, 2, 3.5).as_geojson(precision: 2))
+    assert_raises(ArgumentError) { point.as_geojson(precision: 18) }
+  end
+
+  def test_parse_geojson
+    [
+      "POINT (1.25 -2.5)",
+      "POLYGON ((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 2 3, 3 3, 2 2))",
+      "MULTILINESTRING ((0 0, 1 1), (2 2, 3 3))",
+      "GEOMETRYCOLLECTION (POINT (1 2), LINESTRING (0 0, 1 1))"
+    ].each do |wkt|
+      geom = @factory.parse_wkt(wkt)
+      assert_equal(geom, @factory.parse_geojson(geom.as_geojson), wkt)
+    end
+    assert_raises(TypeError) { @factory.parse_geojson(nil) }
+
+    json = '{"type":"Point","coordinates":[1,2,3]}'
+    point = RGeo::Geos::CAPIFactory.new(has_z_coordinate: true).parse_geojson(json)
+    # Older GEOS GeoJSON readers drop Z values.
+    assert_raises(RGeo::Error::ParseError) { @factory.parse_geojson(json) } if point.z == 3
+  rescue RGeo::Error::UnsupportedOperation
+    skip "Needs GEOS 3.10."
+  end
+
+  def test_cache_output
+    factory = RGeo::Geos::CAPIFactory.new(cache_output: true)
+    assert(factory.cache_output?)
+    point = factory.point(1, 2)
+    text = point.as_text
+    assert(text.frozen?)
+    assert_equal("POINT (1 2)", text)
+    assert_equal(Encoding::US_ASCII, text.encoding)
+    assert_same(text, point.as_text)
+    assert_same(point.as_binary, point.as_binary)
+    assert_equal({ strings: 2, bytes: text.bytesize + 21 }, factory.output_cache_stats)
+
+    copy = point.dup
+    refute_same(text, copy.as_text)
+    assert_equal(3, factory.output_cache_stats[:strings])
+    copy.send(:initialize_copy, factory.point(3, 4))
+    assert_equal(2, factory.output_cache_stats[:strings])
+    assert_equal("POINT (3 4)", copy.as_text)
+
+    assert(Marshal.load(Marshal.dump(factory)).cache_output?)
+    refute(@factory.cache_output?)
+    assert_nil(@factory.output_cache_stats)
+    refute(@factory.point(1, 2).as_text.frozen?)
+  end
+
   def test_parse_wkt_raises_on_wrong_data
     assert_raises(RGeo::Error::ParseError) do
       @factory.parse_wkt(
@@ -43,6 +310,29 @@ class GeosWKREPTest < Minitest::Test
     assert_equal(@factory.point(1, 2).as_binary.unpack1("H*"), "0101000000000000000000f03f0000000000000040")
   end
 
+  def test_generate_wkb_with_generator_options
+    wkt = "GEOMETRYCOLLECTION (POINT (1 2 3), MULTIPOLYGON (((0 0 1, 1 0 1, 1 1 1, 0 0 1))))"
+    [
+      { type_format: :ewkb, emit_ewkb_srid: true, hex_format: true },
+      { type_format: :ewkb, little_endian: true },
+      { type_format: :wkb11, hex_format: true, little_endian: true },
+      { type_format: :wkb12 }
+    ].each do |opts|
+      [false, true].each do |has_z|
+        factory = RGeo::Geos::CAPIFactory.new(srid: 4326, has_z_coordinate: has_z, wkb_generator: opts)
+        geom = factory.parse_wkt(wkt)
+        assert_equal(RGeo::WKRep::WKBGenerator.new(opts).generate(geom), geom.as_binary, opts.inspect)
+      end
+    end
+  end
+
+  def test_generate_wkb_with_m_coordinate_generator
+    opts = { type_format: :ewkb, hex_format: true }
+    factory = RGeo::Geos::CAPIFactory.new(has_m_coordinate: true, wkb_generator: opts)
+    point = factory.point(1, 2, 3)
+    assert_equal(RGeo::WKRep::WKBGenerator.new(opts).generate(point), point.as_binary)
+  end
+
   def test_generate_wkt
     assert_equal(@factory.point(1, 2).as_text, "POINT (1 2)")
   end
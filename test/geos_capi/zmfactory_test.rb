@@ -50,3 +50,49 @@ class GeosZMFactoryTest < Minitest::Test # :nodoc:
     assert_equal(4, point.m_geometry.m)
   end
 end
+
+class GeosNativeZMFactoryTest < Minitest::Test # :nodoc:
+  prepend SkipCAPI
+
+  def setup
+    skip "Needs GEOS 3.12 or later." unless RGeo::Geos.capi_supports_xyzm?
+    @factory = RGeo::Geos.factory(has_z_coordinate: true, has_m_coordinate: true, native_zm: true, srid: 1000)
+  end
+
+  def test_is_capi_factory
+    assert_kind_of(RGeo::Geos::CAPIFactory, @factory)
+    assert(@factory.property(:has_z_coordinate))
+    assert(@factory.property(:has_m_coordinate))
+  end
+
+  def test_4d_point
+    point = @factory.point(1, 2, 3, 4)
+    assert_kind_of(RGeo::Geos::CAPIPointImpl, point)
+    assert_equal(3, point.z)
+    assert_equal(4, point.m)
+  end
+
+  def test_wkt_round_trip
+    point = @factory.point(1, 2, 3, 4)
+    parsed = @factory.parse_wkt(point.as_text)
+    assert_equal(3, parsed.z)
+    assert_equal(4, parsed.m)
+  end
+
+  def test_wkb_round_trip
+    line = @factory.line_string([@factory.point(1, 2, 3, 4), @factory.point(5, 6, 7, 8)])
+    parsed = @factory.parse_wkb(line.as_binary)
+    assert_equal([7, 8], [parsed.point_n(1).z, parsed.point_n(1).m])
+  end
+
+  def test_marshal_round_trip
+    point = Marshal.load(Marshal.dump(@factory.point(1, 2, 3, 4)))
+    assert_equal(3, point.z)
+    assert_equal(4, point.m)
+  end
+
+  def test_line_string_from_coords
+    line = @factory.line_string_from_coords([1, 2, 3, 4, 5, 6, 7, 8].pack("d*"), dims: 4)
+    assert_equal([[1, 2, 3, 4], [5, 6, 7, 8]], line.coordinates)
+  end
+end